@@ -41,6 +41,7 @@
 #include <GLFW/glfw3.h>
 
 #include "FrustumCuller.hh"
+#include "helper/MemoryPool.hh"
 
 // in the implementation, we want to omit the glow:: prefix
 using namespace glow;
@@ -97,7 +98,9 @@ void Assignment07::update(float elapsedSeconds)
     mRuntime += elapsedSeconds;
 
     // generate chunks that might be visible
-    mWorld.notifyCameraPosition(getCamera()->getPosition(), mRenderDistance);
+    // (chunks in the view frustum are generated and meshed first)
+    FrustumCuller culler(*getCamera(), false);
+    mWorld.notifyCameraPosition(getCamera()->getPosition(), mRenderDistance, &culler);
 
     // update terrain
     mWorld.update(elapsedSeconds);
@@ -145,10 +148,26 @@ void Assignment07::render(float elapsedSeconds)
     {
         mStatsMeshesRendered[i] = 0;
         mStatsVerticesRendered[i] = 0;
+        mStatsDrawCalls[i] = 0;
     }
 
     // update camera
-    getCamera()->setFarPlane(mRenderDistance);
+    getCamera()->setFarPlane(getViewDistance());
+
+    // chunks reachable from the camera through non-solid blocks
+    // (for the camera passes only, the sun sees different chunks)
+    if (mEnableVisibilityCulling)
+        mWorld.updateVisibility(getCamera()->getPosition(), mRenderDistance);
+    else
+        mWorld.clearVisibility();
+
+    // occluders of the chunks around the camera (for the camera passes as well)
+    mStatsOcclusionTested = 0;
+    mStatsOcclusionCulled = 0;
+    if (mEnableOcclusionCulling)
+        buildOcclusionBuffer();
+    else
+        mOcclusionBuffer.clear();
 
     // build lights
     {
@@ -162,6 +181,10 @@ void Assignment07::render(float elapsedSeconds)
     // renormalize light dir (UI might have changed it)
     mLightDir = normalize(mLightDir);
 
+    // terrain meshes of all passes
+    updateShadowCascades();
+    cullViews();
+
     // rendering pipeline
     {
         // Shadow Pass
@@ -217,6 +240,14 @@ void Assignment07::onGui()
             ImGui::Checkbox("Show Wireframe (Lights)", &mShowDebugLights);
             ImGui::Checkbox("Highlight Wrong Z-Pre", &mShowWrongDepthPre);
 
+            auto greedyMeshing = mWorld.getMeshingMode() == MeshingMode::Greedy;
+            if (ImGui::Checkbox("Greedy Meshing", &greedyMeshing))
+                mWorld.setMeshingMode(greedyMeshing ? MeshingMode::Greedy : MeshingMode::Naive);
+
+            auto useChunkGrid = mWorld.getUseChunkGrid();
+            if (ImGui::Checkbox("Chunk Grid Lookup", &useChunkGrid))
+                mWorld.setUseChunkGrid(useChunkGrid);
+
             constexpr static int outputs = 16;
             const char* element_names[outputs]
                 = {"Final Rendering",        "Opaque Depth",     "Shaded Opaque",      "G-Buffer: Albedo",
@@ -280,6 +311,13 @@ void Assignment07::onGui()
             ImGui::SliderFloat("Render Distance", &mRenderDistance, 1.0f, 1000.0f);
             ImGui::Checkbox("Frustum Culling", &mEnableFrustumCulling);
             ImGui::Checkbox("Custom BFC", &mEnableCustomBFC);
+            ImGui::Checkbox("Visibility Culling", &mEnableVisibilityCulling);
+            ImGui::Checkbox("Occlusion Culling", &mEnableOcclusionCulling);
+            ImGui::SliderFloat("Occluder Distance", &mOccluderDistance, 16.0f, 512.0f);
+            ImGui::SliderInt("Chunk Budget", &mWorld.chunkBudget.maxChunks, 256, 65536);
+            ImGui::SliderInt("Chunk Memory Budget (MB)", &mWorld.chunkBudget.maxMemoryMB, 64, 8192);
+            ImGui::Checkbox("LOD", &mWorld.lodSettings.enabled);
+            ImGui::SliderFloat("LOD Distance", &mWorld.lodSettings.distance, 128.0f, 2048.0f);
         }
 
         if (ImGui::CollapsingHeader("Pipeline", ImGuiTreeNodeFlags_DefaultOpen))
@@ -290,6 +328,7 @@ void Assignment07::onGui()
             ImGui::Checkbox("Pass: Depth-Pre", &mPassDepthPre);
             ImGui::Checkbox("Pass: Opaque", &mPassOpaque);
             ImGui::Checkbox("Pass: Transparent", &mPassTransparent);
+            ImGui::Checkbox("Multi-Draw", &mEnableMultiDraw);
             ImGui::Checkbox("FXAA", &mUseFXAA);
             ImGui::Checkbox("Dithering", &mUseDithering);
         }
@@ -302,6 +341,45 @@ void Assignment07::onGui()
                 ImGui::Text("ms/frame: ");
 
             ImGui::Text("Chunks: %d", mStatsChunksGenerated);
+            ImGui::Text("Block Memory: %.1f MB", mWorld.getResidentBlockMemory() / (1024.0 * 1024.0));
+            ImGui::Text("Resident Memory: %.1f MB", mWorld.getResidentMemory() / (1024.0 * 1024.0));
+            ImGui::Text("Cached Columns: %d", mWorld.getCachedColumns());
+            if (auto store = mWorld.getRegionStore())
+                ImGui::Text("Region Store: %d loaded, %d saved", store->getChunksLoaded(), store->getChunksSaved());
+            if (mEnableVisibilityCulling)
+                ImGui::Text("Potentially Visible Chunks: %d", mWorld.getPotentiallyVisibleChunks());
+            ImGui::Text("Chunk Bounds: %d chunks, %d nodes, %d tests", mWorld.getChunkBounds().size(),
+                        mWorld.getChunkBounds().getNodeCount(), mStatsBoundsTests);
+            ImGui::Text("Culling: %d meshes in %d views, %.2f ms", (int)mVisibleMeshes.size(),
+                        mViewCuller.getViewCount(), mStatsCullMs);
+            if (mEnableOcclusionCulling)
+            {
+                auto const& occlusion = mOcclusionBuffer.getStats();
+                ImGui::Text("Occluders: %d (%d triangles, %.2f ms)", occlusion.occluders, occlusion.triangles, occlusion.rasterMs);
+                ImGui::Text("Occlusion: %d of %d culled, %d visible", mStatsOcclusionCulled, mStatsOcclusionTested,
+                            mStatsOcclusionTested - mStatsOcclusionCulled);
+            }
+            ImGui::Text("LOD Cells: %d", mWorld.getLod().getCellCount());
+            ImGui::Text("LOD Memory: %.1f MB", mWorld.getLod().getMeshMemory() / (1024.0 * 1024.0));
+            {
+                // heap allocations stop growing once streaming reached a steady state
+                auto pool = MemoryPool::global().getStats();
+                ImGui::Text("Pool: %.1f MB reserved, %d live", pool.reservedBytes / (1024.0 * 1024.0),
+                            int(pool.allocations - pool.deallocations));
+                ImGui::Text("Pool: %d heap allocations", int(pool.heapAllocations));
+            }
+            {
+                auto arena = mWorld.getTerrainArena().getStats();
+                auto mb = [](uint32_t quads) { return quads * 4 * sizeof(TerrainVertex) / (1024.0 * 1024.0); };
+                ImGui::Text("Arena: %.1f of %.1f MB used, end at %.1f MB", mb(arena.quads.usedUnits),
+                            mb(arena.quads.capacity), mb(arena.quads.end));
+                ImGui::Text("Arena: %d meshes, %d holes (largest %.1f MB)", int(arena.quads.allocations),
+                            int(arena.quads.freeBlocks), mb(arena.quads.largestFreeBlock));
+                ImGui::Text("Arena: %d grows, %.1f MB defragmented", arena.grows, arena.movedBytes / (1024.0 * 1024.0));
+            }
+            ImGui::Text("Draw Calls: %d Z-Pre, %d Opaque, %d Transparent, %d Shadow",
+                        mStatsDrawCalls[(int)RenderPass::DepthPre], mStatsDrawCalls[(int)RenderPass::Opaque],
+                        mStatsDrawCalls[(int)RenderPass::Transparent], mStatsDrawCalls[(int)RenderPass::Shadow]);
             ImGui::Text("Z-Pre: Meshes: %d", mStatsMeshesRendered[(int)RenderPass::DepthPre]);
             ImGui::Text("Z-Pre: Vertices: %d", mStatsVerticesRendered[(int)RenderPass::DepthPre]);
             ImGui::Text("Z-Pre: Vertices / Mesh: %f", mStatsVerticesPerMesh[(int)RenderPass::DepthPre]);
@@ -323,7 +401,7 @@ void Assignment07::onGui()
 }
 
 
-void Assignment07::renderShadowPass()
+void Assignment07::updateShadowCascades()
 {
     // ensure that sizes are correct
     updateShadowMapTexture();
@@ -390,6 +468,14 @@ void Assignment07::renderShadowPass()
         cascade.camera.setProjectionMatrix(sProj);
         cascade.camera.setViewportSize({mShadowMapSize, mShadowMapSize});
         mShadowViewProjs[cascIdx] = cascade.camera.getProjectionMatrix() * cascade.camera.getViewMatrix();
+    }
+}
+
+void Assignment07::renderShadowPass()
+{
+    for (auto cascIdx = 0; cascIdx < SHADOW_CASCADES; ++cascIdx)
+    {
+        auto& cascade = mShadowCascades[cascIdx];
 
         // render shadowmap
         {
@@ -407,7 +493,7 @@ void Assignment07::renderShadowPass()
 
             // render scene from light
             if (mEnableShadows)
-                renderScene(&cascade.camera, RenderPass::Shadow);
+                renderScene(&cascade.camera, RenderPass::Shadow, 1 + cascIdx);
         }
 
         // blur shadow map for soft shadows
@@ -460,7 +546,7 @@ void Assignment07::renderDepthPrePass()
 
     GLOW_SCOPED(depthFunc, GL_LESS);
 
-    if (mPassDepthPre) renderScene(getCamera().get(), RenderPass::DepthPre);
+    if (mPassDepthPre) renderScene(getCamera().get(), RenderPass::DepthPre, cameraView);
     /// ============= STUDENT CODE END =============
 }
 
@@ -490,7 +576,7 @@ void Assignment07::renderOpaquePass()
     GLOW_SCOPED(depthFunc, GL_LEQUAL);
     GLOW_SCOPED(enable, GL_FRAMEBUFFER_SRGB);
 
-    if (mPassOpaque) renderScene(getCamera().get(), RenderPass::Opaque);
+    if (mPassOpaque) renderScene(getCamera().get(), RenderPass::Opaque, cameraView);
     /// ============= STUDENT CODE END =============
 }
 
@@ -588,7 +674,7 @@ void Assignment07::renderTransparentPass()
     GLOW_SCOPED(disable, GL_CULL_FACE);
     GLOW_SCOPED(depthMask, GL_FALSE);
 
-    if (mPassTransparent) renderScene(getCamera().get(), RenderPass::Transparent);
+    if (mPassTransparent) renderScene(getCamera().get(), RenderPass::Transparent, cameraView);
 
     GLOW_SCOPED(depthMask, GL_TRUE);
     GLOW_SCOPED(enable, GL_CULL_FACE);
@@ -648,7 +734,7 @@ void Assignment07::renderOutputStage()
     mMeshQuad->bind().draw();
 }
 
-void Assignment07::renderScene(camera::CameraBase* cam, RenderPass pass)
+void Assignment07::renderScene(camera::CameraBase* cam, RenderPass pass, int view)
 {
     // set up general purpose shaders
     switch (pass)
@@ -663,110 +749,87 @@ void Assignment07::renderScene(camera::CameraBase* cam, RenderPass pass)
 
     // render terrain
     {
+        // (only needed for the custom BFC, the meshes were culled in cullViews)
         FrustumCuller culler(*cam, pass == RenderPass::Shadow);
 
-        struct RenderJob
-        {
-            Program* program;
-            RenderMaterial const* mat;
-            VertexArray* mesh;
-            float camDis;
-        };
-
-        // render jobs
-        std::vector<RenderJob> jobs;
+        // render jobs (the queue keeps its memory, shadow cascades share one)
+        auto& jobs = mRenderQueues[(int)pass];
+        jobs.clear();
 
         // collect meshes per material and shader
+        auto const viewBit = ViewMask(1 << view);
+        for (auto const& visible : mVisibleMeshes)
         {
-            for (auto const& chunkPair : mWorld.chunks)
-            {
-                auto const& chunk = chunkPair.second;
+            if (!(visible.views & viewBit))
+                continue; // culled in this view
 
-                // early out
-                if (chunk->isFullyAir())
-                    continue; // CAUTION: fully solid is wrong here -> top layer may have faces!
-
-                // view-frustum culling
-                if (mEnableFrustumCulling && !culler.isAabbVisible(chunk->getAabbMin(), chunk->getAabbMax()))
-                    continue; // skip culled chunks
+            // check correct render pass
+            auto const& mesh = *visible.mesh;
+            auto mat = mesh.mat.get();
+            if (!mat->opaque && pass != RenderPass::Transparent)
+                continue;
+            if (mat->opaque && (pass != RenderPass::Opaque && pass != RenderPass::Shadow && pass != RenderPass::DepthPre))
+                continue;
 
-                // render distance
-                if (pass != RenderPass::Shadow && !culler.isAabbInRange(chunk->getAabbMin(), chunk->getAabbMax(), mRenderDistance))
-                    continue; // not in range
+            // custom BFC
+            if (mEnableCustomBFC && mat->opaque && !culler.isFaceVisible(mesh.dir, mesh.aabbMin, mesh.aabbMax))
+                continue;
 
-                for (auto const& mesh : chunk->queryMeshes())
-                {
-                    // check correct render pass
-                    auto mat = mesh.mat.get();
-                    if (!mat->opaque && pass != RenderPass::Transparent)
-                        continue;
-                    if (mat->opaque && (pass != RenderPass::Opaque && pass != RenderPass::Shadow && pass != RenderPass::DepthPre))
-                        continue;
-
-                    // view-frustum culling (pt. 2)
-                    if (mEnableFrustumCulling && !culler.isAabbVisible(mesh.aabbMin, mesh.aabbMax))
-                        continue; // skip culled meshes
-
-                    // custom BFC
-                    if (mEnableCustomBFC && mat->opaque && !culler.isFaceVisible(mesh.dir, mesh.aabbMin, mesh.aabbMax))
-                        continue;
-
-                    // render distance
-                    if (pass != RenderPass::Shadow && !culler.isAabbInRange(mesh.aabbMin, mesh.aabbMax, mRenderDistance))
-                        continue; // not in range
-
-                    // create a render job for every material/mesh pair
-                    Program* shader = nullptr;
-                    VertexArray* vao = nullptr;
-                    switch (pass)
-                    {
-                    case RenderPass::Shadow:
-                        vao = mesh.vaoPosOnly.get();
-                        shader = mShaderTerrainShadow.get();
-                        break;
-
-                    case RenderPass::DepthPre:
-                        vao = mesh.vaoPosOnly.get();
-                        shader = mShaderTerrainDepthPre.get();
-                        break;
-
-                    case RenderPass::Transparent:
-                    case RenderPass::Opaque:
-                        vao = mesh.vaoFull.get();
-                        shader = mShadersTerrain[mat->shader].get();
-                        break;
-
-                    default:
-                        assert(0 && "not supported");
-                        break;
-                    }
-
-                    auto camDis = distance(cam->getPosition(), (mesh.aabbMin + mesh.aabbMax) / 2.0);
-
-                    // add render job
-                    jobs.push_back({shader, mat, vao, camDis});
-                }
+            // create a render job for every material/mesh pair
+            Program* shader = nullptr;
+            switch (pass)
+            {
+            case RenderPass::Shadow:
+                shader = mShaderTerrainShadow.get();
+                break;
+
+            case RenderPass::DepthPre:
+                shader = mShaderTerrainDepthPre.get();
+                break;
+
+            case RenderPass::Transparent:
+            case RenderPass::Opaque:
+                if (mat->id >= (int)mShaderOfMaterial.size())
+                    mShaderOfMaterial.resize(mat->id + 1, nullptr);
+                if (!mShaderOfMaterial[mat->id])
+                    mShaderOfMaterial[mat->id] = mShadersTerrain[mat->shader].get();
+                shader = mShaderOfMaterial[mat->id];
+                break;
+
+            default:
+                assert(0 && "not supported");
+                break;
             }
+
+            auto camDis = distance(cam->getPosition(), (mesh.aabbMin + mesh.aabbMax) / 2.0);
+
+            // add render job
+            jobs.add({shader, mat, mesh.vertices->getFirstVertex(), mesh.indexCount, visible.pos, visible.voxelSize},
+                     mat->id, camDis);
         }
 
         // .. sort renderjobs
+        // by shader, material, front-to-back (see RenderQueue)
+        jobs.sort();
+
+        // .. draw commands and per-draw data (chunk position, voxel size) in sorted order
+        auto& arena = mWorld.getTerrainArena();
+        arena.clearDraws();
+        for (auto i = 0; i < jobs.size(); ++i)
         {
-            // sort by
-            // .. shader
-            // .. material
-            // .. front-to-back
-            std::sort(jobs.begin(), jobs.end(), [](RenderJob const& a, RenderJob const& b) {
-                if (a.program != b.program)
-                    return a.program < b.program;
-                if (a.mat != b.mat)
-                    return a.mat < b.mat;
-                return a.camDis < b.camDis;
-            });
+            auto const& job = jobs[i];
+            arena.addDraw(job.firstVertex, job.indexCount, job.chunkPos, job.voxelSize);
+
+            // keep stats (4 vertices per 6 indices)
+            mStatsMeshesRendered[(int)pass]++;
+            mStatsVerticesRendered[(int)pass] += job.indexCount / 6 * 4;
         }
+        arena.uploadDraws();
 
         // .. render per shader
         {
-            auto idxShader = 0u;
+            auto vao = arena.bind();
+            auto idxShader = 0;
             while (idxShader < jobs.size())
             {
                 // set up shader
@@ -791,21 +854,13 @@ void Assignment07::renderScene(camera::CameraBase* cam, RenderPass pass)
                     shader.setTexture("uTexHeight", mat->texHeight);
                     shader.setTexture("uTexRoughness", mat->texRoughness);
 
-                    // .. per mesh
+                    // .. all meshes of the material
                     auto idxMesh = idxMaterial;
                     while (idxMesh < jobs.size() && jobs[idxMesh].mat == mat)
-                    {
-                        auto mesh = jobs[idxMesh].mesh;
-
-                        // keep stats
-                        mStatsMeshesRendered[(int)pass]++;
-                        mStatsVerticesRendered[(int)pass] += mesh->getVertexCount();
-
-                        mesh->bind().draw(); // render
-
-                        // advance idx
                         ++idxMesh;
-                    }
+
+                    arena.draw(vao, idxMaterial, idxMesh - idxMaterial, mEnableMultiDraw); // render
+                    mStatsDrawCalls[(int)pass] += mEnableMultiDraw ? 1 : idxMesh - idxMaterial;
 
                     // advance idx
                     idxMaterial = idxMesh;
@@ -881,7 +936,7 @@ void Assignment07::setUpShader(glow::Program* program, camera::CameraBase* cam,
     shader.setUniform("uShowWrongDepthPre", mShowWrongDepthPre);
 
     shader.setTexture("uTexOpaqueDepth", mTexOpaqueDepth);
-    shader.setUniform("uRenderDistance", mRenderDistance);
+    shader.setUniform("uRenderDistance", getViewDistance());
 
     if (pass == RenderPass::Transparent)
     {
@@ -896,6 +951,7 @@ void Assignment07::setUpShader(glow::Program* program, camera::CameraBase* cam,
         shader.setUniform("uShadowViewProjs[0]", mShadowViewProjs);
         shader.setUniform("uShadowPos", mShadowPos);
         shader.setUniform("uShadowRange", mShadowRange);
+        shader.setUniform("uShadowDistance", mRenderDistance);
     }
 
     if (pass == RenderPass::Shadow)
@@ -925,7 +981,7 @@ void Assignment07::setUpLightShader(glow::Program* program, glow::camera::Camera
     shader.setUniform("uLightDir", normalize(mLightDir));
     shader.setUniform("uAmbientLight", mAmbientLight);
     shader.setUniform("uLightColor", mLightColor);
-    shader.setUniform("uRenderDistance", mRenderDistance);
+    shader.setUniform("uRenderDistance", getViewDistance());
 
     shader.setUniform("uShadowExponent", mShadowExponent);
     shader.setTexture("uShadowMaps", mShadowMaps);
@@ -933,6 +989,7 @@ void Assignment07::setUpLightShader(glow::Program* program, glow::camera::Camera
     shader.setUniform("uShadowViewProjs[0]", mShadowViewProjs);
     shader.setUniform("uShadowPos", mShadowPos);
     shader.setUniform("uShadowRange", mShadowRange);
+    shader.setUniform("uShadowDistance", mRenderDistance); // shadow cascades only cover the chunks
 
     shader.setTexture("uTexOpaqueDepth", mTexOpaqueDepth);
     shader.setTexture("uTexGBufferColor", mTexGBufferColor);
@@ -1157,6 +1214,8 @@ void Assignment07::init()
         glow::info() << "Init world";
 
         mWorld.init();
+        // (relative to the working directory, not the source tree)
+        mWorld.enablePersistence("world");
 
         // create terrain shaders
         for (auto const& mat : mWorld.materialsOpaque)
@@ -1239,6 +1298,160 @@ void Assignment07::updateShadowMapTexture()
     mFramebufferShadowBlur = Framebuffer::create({{"fShadow", mShadowBlurTarget}});
 }
 
+float Assignment07::getViewDistance() const
+{
+    if (!mWorld.lodSettings.enabled)
+        return mRenderDistance;
+    return tg::max(mRenderDistance, mWorld.lodSettings.distance);
+}
+
+void Assignment07::buildOcclusionBuffer()
+{
+    GLOW_ACTION();
+
+    auto cam = getCamera();
+    FrustumCuller culler(*cam, false);
+    auto const& lod = mWorld.getLod();
+
+    mOcclusionBuffer.begin(cam->getProjectionMatrix() * cam->getViewMatrix(), cam->getPosition(), getWindowSize());
+
+    // chunks in the frustum within the occluder distance
+    auto testBounds = [&](tg::pos3 amin, tg::pos3 amax) {
+        if (!culler.isAabbInRange(amin, amax, mOccluderDistance) || !culler.isAabbVisible(amin, amax))
+            return BoundsTest::Outside;
+        if (culler.isAabbFullyInRange(amin, amax, mOccluderDistance) && culler.isAabbInside(amin, amax))
+            return BoundsTest::Inside;
+        return BoundsTest::Partial;
+    };
+
+    mWorld.getChunkBounds().query(testBounds, [&](Chunk* chunk) {
+        auto const& occluders = chunk->getOccluders();
+        if (occluders.empty())
+            return;
+
+        // only chunks that are drawn
+        if (lod.isActive() && !lod.isChunkVisible(chunk->chunkPos))
+            return;
+        if (!mWorld.isChunkPotentiallyVisible(*chunk))
+            return;
+
+        auto cmin = tg::pos3(chunk->chunkPos);
+        for (auto const& box : occluders)
+            mOcclusionBuffer.addOccluder(cmin + tg::vec3(box.min), cmin + tg::vec3(box.max));
+    });
+    mOcclusionBuffer.finish();
+}
+
+void Assignment07::cullViews()
+{
+    GLOW_ACTION();
+    glow::timing::CpuTimer timer;
+
+    auto cam = getCamera();
+    auto const& lod = mWorld.getLod();
+    auto const viewDistance = getViewDistance();
+
+    // with LOD, the LOD cells decide which chunks are drawn
+    // (otherwise all chunks within the render distance)
+    auto const chunkRange = lod.isActive() ? viewDistance : mRenderDistance;
+
+    // the camera has a render distance, the shadow cascades see everything in their frustum
+    mViewCuller.clear();
+    auto camViewProj = cam->getProjectionMatrix() * cam->getViewMatrix();
+    mViewCuller.addView(camViewProj, cam->getPosition(), chunkRange, mEnableFrustumCulling);
+    for (auto i = 0; i < SHADOW_CASCADES; ++i)
+        mViewCuller.addView(mShadowViewProjs[i], tg::pos3::zero, -1.0f, mEnableFrustumCulling);
+
+    auto const cameraBit = ViewMask(1 << cameraView);
+    auto const rootViews = mEnableShadows ? mViewCuller.getAllViews() : cameraBit;
+
+    // occlusion test of a chunk or LOD cell (for the camera only)
+    auto isOccluded = [&](tg::pos3 amin, tg::pos3 amax) {
+        auto occluded = !mOcclusionBuffer.isAabbVisible(amin, amax);
+        ++mStatsOcclusionTested;
+        mStatsOcclusionCulled += occluded;
+        return occluded;
+    };
+
+    // adds the meshes of a chunk or LOD cell that are visible in some of its views
+    // (views that contain the whole chunk or cell are not tested again)
+    mVisibleMeshes.clear();
+    auto addMeshes = [&](PooledVector<TerrainMesh> const& meshes, tg::pos3 pos, float voxelSize, ViewMask views,
+                         ViewMask inside) {
+        for (auto const& mesh : meshes)
+        {
+            // view-frustum culling and render distance (pt. 2)
+            ViewMask meshInside;
+            auto meshViews = ViewMask(inside | mViewCuller.test(mesh.aabbMin, mesh.aabbMax, views & ~inside, meshInside));
+
+            // occlusion culling (pt. 2)
+            if ((meshViews & cameraBit) && !mOcclusionBuffer.isAabbVisible(mesh.aabbMin, mesh.aabbMax))
+                meshViews &= ~cameraBit; // behind occluders
+
+            if (meshViews)
+                mVisibleMeshes.push_back({&mesh, pos, voxelSize, meshViews});
+        }
+    };
+
+    // chunks: one query for all views, nodes are narrowed to the views that see them
+    // (only chunks with content, see World::getChunkBounds)
+    struct CullState
+    {
+        ViewMask views;  ///< views that potentially see the node
+        ViewMask inside; ///< views that contain the node completely
+    };
+    auto testBounds = [&](tg::pos3 amin, tg::pos3 amax, CullState& s) {
+        ViewMask inside;
+        s.views = s.inside | mViewCuller.test(amin, amax, s.views & ~s.inside, inside);
+        s.inside |= inside;
+        if (!s.views)
+            return BoundsTest::Outside;
+        return s.inside == s.views ? BoundsTest::Inside : BoundsTest::Partial;
+    };
+
+    auto addChunk = [&](Chunk* chunk, CullState const& s) {
+        auto const& meshes = chunk->queryMeshes();
+        if (meshes.empty())
+            return; // occluders only
+
+        // LOD selection
+        if (lod.isActive() && !lod.isChunkVisible(chunk->chunkPos))
+            return; // covered by a LOD cell
+
+        // visibility and occlusion culling (the sun sees different chunks)
+        auto views = s.views;
+        if (views & cameraBit)
+        {
+            if (!mWorld.isChunkPotentiallyVisible(*chunk))
+                views &= ~cameraBit; // hidden behind solid chunks
+            else if (isOccluded(chunk->getContentAabbMin(), chunk->getContentAabbMax()))
+                views &= ~cameraBit; // behind occluders
+        }
+        if (!views)
+            return;
+
+        addMeshes(meshes, tg::pos3(chunk->chunkPos), 1.0f, views, s.inside & views);
+    };
+    mStatsBoundsTests = mWorld.getChunkBounds().queryWithState(CullState{rootViews, 0}, testBounds, addChunk);
+
+    // LOD cells: up to the view distance
+    mViewCuller.setRange(cameraView, viewDistance);
+    for (auto cell : lod.getVisibleCells())
+    {
+        ViewMask inside;
+        auto views = mViewCuller.test(cell->aabbMin, cell->aabbMax, rootViews, inside);
+        if ((views & cameraBit) && isOccluded(cell->aabbMin, cell->aabbMax))
+            views &= ~cameraBit; // behind occluders
+        if (!views)
+            continue;
+
+        for (auto const& cube : cell->cubes)
+            addMeshes(cube.meshes, tg::pos3(cube.origin), float(cell->voxelSize()), views, inside & views);
+    }
+
+    mStatsCullMs = timer.elapsedSeconds() * 1000;
+}
+
 bool Assignment07::onMouseButton(double x, double y, int button, int action, int mods, int clickCount)
 {
     if (GlfwApp::onMouseButton(x, y, button, action, mods, clickCount))
@@ -1257,8 +1470,7 @@ bool Assignment07::onMouseButton(double x, double y, int button, int action, int
         auto blockMat = mMouseHit.block.mat;
         if (mods & GLFW_MOD_CONTROL)
         {
-            mWorld.queryBlockMutable(bPos).mat = 0;
-            modified = true;
+            modified = mWorld.setBlock(bPos, Block::air());
             // glow::info() << "Removing material " << int(mMouseHit.block.mat) << " at " << bPos;
         }
         else if (mods & GLFW_MOD_SHIFT)
@@ -1270,14 +1482,14 @@ bool Assignment07::onMouseButton(double x, double y, int button, int action, int
         else // no modifier -> add material
         {
             bPos += mMouseHit.hitNormal;
-            mWorld.queryBlockMutable(bPos).mat = mCurrentMaterial;
-            modified = true;
+            modified = mWorld.setBlock(bPos, Block(mCurrentMaterial));
             // glow::info() << "Adding material " << int(mCurrentMaterial) << " at " << bPos;
         }
 
         // trigger mesh rebuilding
+        // (the world also remeshes neighboring sections whose border contains the block)
         if (modified)
-            mWorld.markDirty(bPos, 1);
+            mWorld.markDirty(bPos, 0);
 
         return true;
     }
@@ -1297,7 +1509,7 @@ bool Assignment07::onMousePosition(double x, double y)
     return false;
 }
 
-bool Assignment07::onKey(int key, int scancode, int action, int mods)
+bool Assignment07::onKey(int key, int /*scancode*/, int action, int /*mods*/)
 {
     if (key == GLFW_KEY_LEFT_SHIFT || key == GLFW_KEY_RIGHT_SHIFT)
         mShiftPressed = action != GLFW_RELEASE;
@@ -13,6 +13,9 @@
 #include "Character.hh"
 #include "Chunk.hh"
 #include "Material.hh"
+#include "OcclusionBuffer.hh"
+#include "RenderQueue.hh"
+#include "ViewCuller.hh"
 #include "World.hh"
 
 enum class RenderPass
@@ -94,6 +97,10 @@ private: // object gfx
     std::map<std::string, glow::SharedProgram> mShadersTerrain;
     glow::SharedProgram mShaderTerrainShadow;
     glow::SharedProgram mShaderTerrainDepthPre;
+    std::vector<glow::Program*> mShaderOfMaterial; ///< mShadersTerrain[shader] per RenderMaterial::id (lazily)
+
+    // draw calls per render pass (kept between frames, see RenderQueue)
+    RenderQueue mRenderQueues[4];
 
     // background
     glow::SharedTextureCubeMap mTexSkybox;
@@ -212,11 +219,30 @@ private: // rendering pipeline
     bool mPassDepthPre = true;
     bool mPassOpaque = true;
     bool mPassTransparent = true;
+    bool mEnableMultiDraw = true; ///< one indirect draw call per material (otherwise one per mesh, see TerrainArena)
 
     // culling
-    float mRenderDistance = 128;
+    float mRenderDistance = 112; ///< of the full resolution chunks (see World::lodSettings for the terrain beyond)
     bool mEnableCustomBFC = true;
     bool mEnableFrustumCulling = true;
+    bool mEnableVisibilityCulling = true; ///< chunks hidden behind solid chunks (see World::updateVisibility)
+    bool mEnableOcclusionCulling = true;  ///< chunks and meshes hidden behind solid boxes (see OcclusionBuffer)
+    float mOccluderDistance = 128;        ///< only chunks within this distance contribute occluders
+    OcclusionBuffer mOcclusionBuffer;
+
+    // culling of all views at once (see cullViews)
+    // view 0 is the camera, view 1 + i the shadow cascade i
+    static constexpr int cameraView = 0;
+    static_assert(1 + SHADOW_CASCADES <= ViewCuller::maxViews, "too many shadow cascades for the view culler");
+    struct VisibleMesh
+    {
+        TerrainMesh const* mesh;
+        tg::pos3 pos;
+        float voxelSize;
+        ViewMask views; ///< views that see the mesh
+    };
+    ViewCuller mViewCuller;
+    std::vector<VisibleMesh> mVisibleMeshes;
 
     // debug
     bool mBackFaceCulling = true;
@@ -226,7 +252,12 @@ private: // rendering pipeline
     int mStatsChunksGenerated = -1;
     int mStatsMeshesRendered[4] = {};
     int mStatsVerticesRendered[4] = {};
+    int mStatsDrawCalls[4] = {};
     float mStatsVerticesPerMesh[4] = {};
+    int mStatsOcclusionTested = 0; ///< chunks and LOD cells in the opaque pass
+    int mStatsOcclusionCulled = 0;
+    int mStatsBoundsTests = 0; ///< box tests of the chunk query (all views)
+    float mStatsCullMs = 0;
 
 private: // gfx options
     /// accumulated time
@@ -259,6 +290,19 @@ private: // helper
     /// Updates shadow map texture if size changed
     void updateShadowMapTexture();
 
+    /// distance up to which terrain is drawn (chunks or LOD cells)
+    float getViewDistance() const;
+
+    /// rasterizes the occluders of the chunks close to the camera
+    void buildOcclusionBuffer();
+
+    /// sets up the cameras of the shadow cascades
+    void updateShadowCascades();
+
+    /// collects the meshes visible in the camera or a shadow cascade (mVisibleMeshes)
+    /// Chunks are culled against all views in a single query (see ViewCuller), the passes only check the view masks
+    void cullViews();
+
     // line drawing
     void buildLineMesh();
     void drawLine(tg::pos3 from, tg::pos3 to, tg::color3 color, RenderPass pass);
@@ -271,7 +315,8 @@ private: // helper
 
 private: // rendering
     /// renders the scene for a render pass
-    void renderScene(glow::camera::CameraBase* cam, RenderPass pass);
+    /// (terrain meshes visible in the given view, see cullViews)
+    void renderScene(glow::camera::CameraBase* cam, RenderPass pass, int view);
 
     // pipeline passes
     void renderShadowPass();
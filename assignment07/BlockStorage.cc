@@ -0,0 +1,107 @@
+#include "BlockStorage.hh"
+
+#include <algorithm>
+
+// palette indices must not cross word boundaries
+static_assert(BlockStorage::blockCount % 32 == 0, "unexpected chunk size");
+
+void BlockStorage::copyTo(int idx, int count, Block* dst) const
+{
+    switch (mKind)
+    {
+    case Kind::Uniform:
+        std::fill(dst, dst + count, mUniform);
+        break;
+    case Kind::Palette:
+        for (auto i = 0; i < count; ++i)
+            dst[i] = get(idx + i);
+        break;
+    case Kind::Dense:
+        std::copy(mDense.begin() + idx, mDense.begin() + idx + count, dst);
+        break;
+    }
+}
+
+void BlockStorage::fill(Block b)
+{
+    mKind = Kind::Uniform;
+    mUniform = b;
+
+    // release memory (assigning {} would keep the capacity)
+    mPalette = PooledVector<Block>();
+    mIndices = PooledVector<uint32_t>();
+    mBits = 0;
+    mDense = PooledVector<Block>();
+}
+
+void BlockStorage::assign(Block const* blocks)
+{
+    fill(Block());
+    mDense.assign(blocks, blocks + blockCount);
+    mKind = Kind::Dense;
+    compact();
+}
+
+void BlockStorage::densify()
+{
+    if (mKind == Kind::Dense)
+        return;
+
+    PooledVector<Block> dense(blockCount);
+    copyTo(0, blockCount, dense.data());
+
+    fill(Block());
+    mDense = std::move(dense);
+    mKind = Kind::Dense;
+}
+
+void BlockStorage::compact()
+{
+    if (mKind != Kind::Dense)
+        return; // already compact (blocks can only change in the dense representation)
+
+    // gather palette
+    int paletteIdx[256];
+    std::fill(std::begin(paletteIdx), std::end(paletteIdx), -1);
+
+    PooledVector<Block> palette;
+    for (auto const& b : mDense)
+    {
+        auto& pi = paletteIdx[b.mat + 128];
+        if (pi >= 0)
+            continue;
+
+        if (palette.size() == 16)
+            return; // too many different blocks: stay dense
+
+        pi = (int)palette.size();
+        palette.push_back(b);
+    }
+
+    // uniform
+    if (palette.size() == 1)
+    {
+        fill(palette[0]);
+        return;
+    }
+
+    // palette
+    auto bits = palette.size() <= 2 ? 1 : palette.size() <= 4 ? 2 : 4;
+    PooledVector<uint32_t> indices(blockCount * bits / 32, 0u);
+    for (auto i = 0; i < blockCount; ++i)
+    {
+        auto bit = i * bits;
+        indices[bit >> 5] |= uint32_t(paletteIdx[mDense[i].mat + 128]) << (bit & 31);
+    }
+
+    fill(Block());
+    mPalette = std::move(palette);
+    mIndices = std::move(indices);
+    mBits = bits;
+    mKind = Kind::Palette;
+}
+
+size_t BlockStorage::getMemoryUsage() const
+{
+    return mPalette.capacity() * sizeof(Block) + mIndices.capacity() * sizeof(uint32_t) + mDense.capacity() * sizeof(Block);
+}
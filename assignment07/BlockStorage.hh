@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Block.hh"
+#include "Constants.hh"
+
+#include "helper/MemoryPool.hh"
+
+/**
+ * @brief Storage for the blocks of a single chunk
+ *
+ * Three representations, chosen automatically by compact():
+ *  - Uniform: all blocks are the same (no allocation at all)
+ *  - Palette: up to 16 different blocks, 1/2/4 bits per block index into a small palette
+ *  - Dense:   one Block per block
+ *
+ * Reading works with every representation.
+ * Mutable access switches to the dense representation (until the next compact()).
+ *
+ * All arrays are allocated from the MemoryPool, so chunks that are evicted and streamed in again reuse the memory.
+ *
+ * Index is (z * CHUNK_SIZE + y) * CHUNK_SIZE + x
+ */
+class BlockStorage
+{
+public:
+    enum class Kind
+    {
+        Uniform,
+        Palette,
+        Dense
+    };
+
+    static constexpr int blockCount = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+private:
+    Kind mKind = Kind::Uniform;
+
+    /// the single block (only Kind::Uniform)
+    Block mUniform;
+
+    // only Kind::Palette
+    PooledVector<Block> mPalette;
+    PooledVector<uint32_t> mIndices; ///< packed palette indices
+    int mBits = 0;                  ///< bits per palette index
+
+    /// all blocks (only Kind::Dense)
+    PooledVector<Block> mDense;
+
+public:
+    explicit BlockStorage(Block fill = Block::invalid()) : mUniform(fill) {}
+
+    Block get(int idx) const
+    {
+        switch (mKind)
+        {
+        case Kind::Uniform:
+            return mUniform;
+        case Kind::Palette:
+        {
+            auto bit = idx * mBits;
+            return mPalette[(mIndices[bit >> 5] >> (bit & 31)) & ((1u << mBits) - 1)];
+        }
+        default:
+            return mDense[idx];
+        }
+    }
+
+    /// CAUTION: switches to the dense representation
+    /// (reference is valid until the next compact())
+    Block& getMutable(int idx)
+    {
+        if (mKind != Kind::Dense)
+            densify();
+        return mDense[idx];
+    }
+
+    /// copies count consecutive blocks starting at idx
+    void copyTo(int idx, int count, Block* dst) const;
+
+    /// replaces all blocks with a single one
+    void fill(Block b);
+
+    /// replaces all blocks (blockCount blocks) and compacts
+    void assign(Block const* blocks);
+
+    /// switches to the dense representation
+    void densify();
+
+    /// switches to the smallest representation for the current blocks
+    void compact();
+
+    Kind getKind() const { return mKind; }
+
+    /// heap memory in bytes
+    size_t getMemoryUsage() const;
+};
@@ -1,6 +1,6 @@
 #include "Chunk.hh"
 
-#include <set>
+#include <algorithm>
 
 #include <glow/common/log.hh>
 #include <glow/common/profiling.hh>
@@ -14,29 +14,41 @@
 
 using namespace glow;
 
+// block statistics are 16 bit counters
+static_assert(BlockStorage::blockCount <= 65535, "chunk too large for the block statistics");
 
-Chunk::Chunk(tg::ipos3 chunkPos, World *world) : chunkPos(chunkPos), world(world)
-{
-    mBlocks.resize(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE, Block::invalid());
-}
+
+Chunk::Chunk(tg::ipos3 chunkPos, World *world) : chunkPos(chunkPos), world(world), mBlocks(Block::invalid()) {}
 
 SharedChunk Chunk::create(tg::ipos3 chunkPos, World *world)
 {
     if (chunkPos.x % CHUNK_SIZE != 0 || chunkPos.y % CHUNK_SIZE != 0 || chunkPos.z % CHUNK_SIZE != 0)
         glow::error() << "Position must be a multiple of size!";
 
-    // "new" because Chunk() is private
-    return std::shared_ptr<Chunk>(new Chunk(chunkPos, world));
+    // chunk and shared_ptr control block are pooled (chunks are streamed in and out all the time)
+    // (placement new because Chunk() is private)
+    auto mem = PoolAllocator<Chunk>().allocate(1);
+    auto chunk = new (mem) Chunk(chunkPos, world);
+    return SharedChunk(chunk,
+                       [](Chunk* c) {
+                           c->~Chunk();
+                           PoolAllocator<Chunk>().deallocate(c, 1);
+                       },
+                       PoolAllocator<Chunk>());
 }
 
-const std::vector<TerrainMesh> &Chunk::queryMeshes()
+const PooledVector<TerrainMesh> &Chunk::queryMeshes()
 {
     // mesh update is done in terrain worker
     return mMeshes;
 }
 
-void Chunk::markDirty()
+void Chunk::markDirty() { markDirty(CHUNK_ALL_SECTIONS); }
+
+void Chunk::markDirty(int sections)
 {
+    mDirtySections |= sections;
+
     if (!mIsDirty)
         world->notifyDirtyChunk(this); // enqueue CPU update
 
@@ -46,128 +58,233 @@ void Chunk::markDirty()
     // mMeshes.clear();
 }
 
+int Chunk::beginMeshUpdate(int sections)
+{
+    auto version = ++mMeshVersion;
+    for (auto s = 0; s < CHUNK_SECTIONS; ++s)
+        if (sections >> s & 1)
+            mSectionMeshVersion[s] = version;
+    return version;
+}
+
+int Chunk::currentSections(int sections, int version) const
+{
+    auto current = 0;
+    for (auto s = 0; s < CHUNK_SECTIONS; ++s)
+        if ((sections >> s & 1) && mSectionMeshVersion[s] == version)
+            current |= 1 << s;
+    return current;
+}
+
 void Chunk::update()
 {
     if (!mIsDirty)
         return; // nothing to do
 
+    if (!mIsGenerated)
+    {
+        // blocks are still written by a worker thread
+        // (notifyChunkGenerated marks the chunk dirty again)
+        mIsDirty = false;
+        return;
+    }
+
+    // flags
+    mIsFullyAir = mAirCount == BlockStorage::blockCount;
+    mIsFullySolid = mSolidCount == BlockStorage::blockCount;
+
+    // aabb: first and last occupied slice per axis
+    tg::ivec3 amin(CHUNK_SIZE);
+    tg::ivec3 amax(-1);
+    for (auto d = 0; d < 3; ++d)
+        for (auto i = 0; i < CHUNK_SIZE; ++i)
+            if (mOccupancy[d][i] > 0)
+            {
+                amin[d] = tg::min(amin[d], i);
+                amax[d] = i;
+            }
+
+    if (amax.x < 0) // no blocks at all
+        amin = amax = tg::ivec3(-1);
+
+    mAabbMin = tg::pos3(chunkPos + amin);
+    mAabbMax = tg::pos3(chunkPos + amax + 1);
+
+    // light fountains with air above
+    // (the block above might be in the chunk above, which marks this chunk dirty when it changes)
     mActiveLightFountains.clear();
+    for (auto const &p : mLightFountains)
+        if (queryBlock(p + tg::ivec3(0, 1, 0)).isAir())
+            mActiveLightFountains.push_back(p);
 
-    // recalc flags
-    mIsFullyAir = true;
-    mIsFullySolid = true;
+    mIsDirty = false;
+}
 
-    // recalc aabb
-    mAabbMin = tg::pos3((float)CHUNK_SIZE + 1);
-    mAabbMax = tg::pos3(-1.0f);
+void Chunk::computeStats()
+{
+    GLOW_ACTION();
 
-    tg::ivec3 amin(CHUNK_SIZE + 1);
-    tg::ivec3 amax(-1);
+    mAirCount = 0;
+    mSolidCount = 0;
+    std::fill(std::begin(mMaterialCount), std::end(mMaterialCount), 0);
+    for (auto &counts : mOccupancy)
+        std::fill(std::begin(counts), std::end(counts), 0);
+    mLightFountains.clear();
+
+    // uniform chunks (most chunks) are counted in one go
+    if (mBlocks.getKind() == BlockStorage::Kind::Uniform)
+    {
+        auto b = mBlocks.get(0);
+        mMaterialCount[b.mat + 128] = BlockStorage::blockCount;
+        if (b.isAir())
+            mAirCount = BlockStorage::blockCount;
+        else
+            for (auto &counts : mOccupancy)
+                std::fill(std::begin(counts), std::end(counts), CHUNK_SIZE * CHUNK_SIZE);
+        if (b.isSolid())
+            mSolidCount = BlockStorage::blockCount;
+
+        auto m = world->getMaterialFromIndex(b.mat);
+        if (m && m->spawnsLightSources)
+            for (auto z = 0; z < CHUNK_SIZE; ++z)
+                for (auto y = 0; y < CHUNK_SIZE; ++y)
+                    for (auto x = 0; x < CHUNK_SIZE; ++x)
+                        mLightFountains.push_back(chunkPos + tg::ivec3(x, y, z));
+        return;
+    }
 
     auto idx = 0;
-    auto pChunk = mBlocks.data();
-    auto fullAir = true;
-    auto fullSolid = true;
     for (auto z = 0; z < CHUNK_SIZE; ++z)
         for (auto y = 0; y < CHUNK_SIZE; ++y)
             for (auto x = 0; x < CHUNK_SIZE; ++x)
-            {
-                auto const &b = pChunk[idx++];
-                tg::ivec3 p = {x, y, z}; // relative local position
-
-                // update flags
-                if (!b.isAir())
-                    fullAir = false;
-                if (!b.isSolid())
-                    fullSolid = false;
-
-                // update aabb
-                amax = tg::max(p, amax);
-                amin = tg::min(p, amin);
-
-                if (b.isInvalid() || b.isAir())
-                    continue;
-
-                // gather light fountains
-                if (world->getMaterialFromIndex(b.mat)->spawnsLightSources)
-                {
-                    auto gp = chunkPos + p;
-                    if (queryBlock(gp + tg::ivec3(0, 1, 0)).isAir())
-                    {
-                        // air above this block
-                        mActiveLightFountains.push_back(gp);
-                    }
-                }
-            }
+                countBlock({x, y, z}, mBlocks.get(idx++), 1);
+}
 
-    mAabbMin = tg::pos3(chunkPos + amin);
-    mAabbMax = tg::pos3(chunkPos + amax + 1);
+void Chunk::setBlock(tg::ivec3 relPos, Block b)
+{
+    auto &dst = mBlocks.getMutable((relPos.z * CHUNK_SIZE + relPos.y) * CHUNK_SIZE + relPos.x);
+    if (dst.mat == b.mat)
+        return; // unchanged
+
+    countBlock(relPos, dst, -1);
+    dst = b;
+    countBlock(relPos, b, 1);
+    ++mBlockRevision;
+}
 
-    mIsFullyAir = fullAir;
-    mIsFullySolid = fullSolid;
+void Chunk::countBlock(tg::ivec3 relPos, Block b, int delta)
+{
+    mMaterialCount[b.mat + 128] += delta;
 
-    mIsDirty = false;
+    if (b.isAir())
+        mAirCount += delta;
+    else
+        for (auto d = 0; d < 3; ++d)
+            mOccupancy[d][relPos[d]] += delta;
+
+    if (b.isSolid())
+        mSolidCount += delta;
+
+    auto m = world->getMaterialFromIndex(b.mat);
+    if (m && m->spawnsLightSources)
+    {
+        auto p = chunkPos + relPos;
+        if (delta > 0)
+            mLightFountains.push_back(p);
+        else
+            mLightFountains.erase(std::remove(mLightFountains.begin(), mLightFountains.end(), p), mLightFountains.end());
+    }
 }
 
-void Chunk::notifyMeshData(const std::vector<TerrainMeshData> &meshData)
+void Chunk::notifyMeshData(int sections, const PooledVector<TerrainMeshData> &meshData)
 {
     GLOW_ACTION();
 
     // upload new meshes
-    std::vector<TerrainMesh> newMeshes;
+    // (meshes of other sections are kept)
+    PooledVector<TerrainMesh> newMeshes;
+    for (auto const &m : mMeshes)
+        if (!(sections >> m.section & 1))
+            newMeshes.push_back(m);
 
     for (auto const &data : meshData)
     {
-        if (data.vertexData.empty())
-            continue; // no data
+        if (!(sections >> data.section & 1))
+            continue; // outdated section
 
-        auto d = data.dir;
-        auto pd = tg::abs(d);
-        auto s = (d.x + d.y + d.z + 1) / 2;
-        auto pdir = pd.y + pd.z * 2 + s * 3;
-        TG_ASSERT(0 <= pdir && pdir < 6);
+        if (data.vertices.empty())
+            continue; // no data
 
         TerrainMesh mesh;
-        mesh.mat = world->getMaterialFromIndex(data.mat)->renderMaterials[pdir];
+        mesh.section = data.section;
+        mesh.mat = world->getMaterialFromIndex(data.mat)->renderMaterials[renderMaterialIndex(data.dir)];
         mesh.dir = data.dir;
         mesh.aabbMin = data.aabbMin;
         mesh.aabbMax = data.aabbMax;
 
         // try to re-use existing mesh
         for (auto const &m : mMeshes)
-            if (m.mat == mesh.mat && m.dir == mesh.dir)
+            if (m.section == mesh.section && m.mat == mesh.mat && m.dir == mesh.dir)
             {
-                mesh.abData = m.abData;
-                mesh.abPositions = m.abPositions;
-                mesh.vaoFull = m.vaoFull;
-                mesh.vaoPosOnly = m.vaoPosOnly;
+                mesh.vertices = m.vertices;
                 break;
             }
 
-        // .. otherwise create VAO/AB
-        if (!mesh.vaoFull)
-        {
-            mesh.abPositions = ArrayBuffer::create();
-            mesh.abPositions->defineAttribute<tg::pos3>("aPosition");
-            mesh.abData = ArrayBuffer::create(TerrainVertex::attributes());
-            mesh.vaoFull = VertexArray::create({mesh.abPositions, mesh.abData});
-            mesh.vaoPosOnly = VertexArray::create(mesh.abPositions);
-        }
-
-        // upload new vertex data
-        mesh.abPositions->bind().setData(data.vertexPositions);
-        mesh.abData->bind().setData(data.vertexData);
+        // .. otherwise allocate in the arena, upload new vertex data
+        uploadTerrainMesh(world->getTerrainArena(), mesh, data);
 
         // add to result
         newMeshes.push_back(mesh);
     }
 
     // replace old meshes
-    mMeshes = newMeshes;
+    mMeshes = std::move(newMeshes);
+    mIsMeshed = true;
+
+    mMeshMemory = 0;
+    for (auto const &m : mMeshes)
+        mMeshMemory += size_t(m.indexCount / 6 * 4) * sizeof(TerrainVertex);
+
+    updateContentBounds();
     // glow::info() << "new meshes for " << chunkPos;
 }
 
-const Block &Chunk::queryBlock(tg::ipos3 worldPos) const
+void Chunk::notifyVisibility(int version, ChunkVisibility const& visibility)
+{
+    // mesh jobs may finish out of order
+    if (version < mVisibilityVersion)
+        return;
+
+    mVisibility = visibility;
+    mVisibilityVersion = version;
+
+    updateContentBounds();
+}
+
+void Chunk::notifyCompactedBlocks(int revision, BlockStorage blocks)
+{
+    if (revision != mBlockRevision)
+        return; // edited in the meantime, the next mesh job brings a newer copy
+
+    mBlocks = std::move(blocks);
+}
+
+void Chunk::updateContentBounds()
+{
+    mHasContent = false;
+    auto add = [&](tg::pos3 amin, tg::pos3 amax) {
+        mContentAabbMin = mHasContent ? tg::min(mContentAabbMin, amin) : amin;
+        mContentAabbMax = mHasContent ? tg::max(mContentAabbMax, amax) : amax;
+        mHasContent = true;
+    };
+
+    for (auto const &m : mMeshes)
+        add(m.aabbMin, m.aabbMax);
+    for (auto const &box : mVisibility.occluders)
+        add(tg::pos3(chunkPos + tg::ivec3(box.min)), tg::pos3(chunkPos + tg::ivec3(box.max)));
+}
+
+Block Chunk::queryBlock(tg::ipos3 worldPos) const
 {
     if (contains(worldPos))
         return block(worldPos - chunkPos);
@@ -177,15 +294,14 @@ const Block &Chunk::queryBlock(tg::ipos3 worldPos) const
 
 std::vector<Material const *> Chunk::queryMaterials() const
 {
-    std::set<int8_t> matIdx;
-
-    for (auto const &b : mBlocks)
-        matIdx.insert(b.mat);
-
     std::vector<Material const *> mats;
 
-    for (auto m : matIdx)
+    for (auto i = 0; i < 256; ++i)
     {
+        if (mMaterialCount[i] == 0)
+            continue;
+
+        auto m = i - 128;
         if (m == 0)
             mats.push_back(nullptr);
         else
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <map>
 #include <vector>
 
@@ -8,6 +9,8 @@
 #include <glow/fwd.hh>
 
 #include "Block.hh"
+#include "BlockStorage.hh"
+#include "ChunkVisibility.hh"
 #include "Constants.hh"
 #include "TerrainMesh.hh"
 
@@ -32,19 +35,34 @@ public: // properties
     bool isCpuDirty() const { return mIsDirty; }
 
     /// true iff the chunk is solid-only
-    /// (updated in queryMeshes)
+    /// (updated in update)
     bool isFullySolid() const { return mIsFullySolid; }
     /// true iff the chunk is air-only
-    /// (updated in queryMeshes)
+    /// (updated in update)
     bool isFullyAir() const { return mIsFullyAir; }
 
     /// true iff chunk is fully generated
     bool isGenerated() const { return mIsGenerated; }
 
+    /// true iff meshes were received at least once
+    bool isMeshed() const { return mIsMeshed; }
+
     /// returns mesh version nr
     int getMeshVersion() const { return mMeshVersion; }
 
-    /// Bounding box
+    /// which faces are connected through non-solid blocks (see ChunkVisibility.hh)
+    /// (all faces until the chunk is meshed)
+    FaceConnectivity getFaceConnectivity() const { return mVisibility.connectivity; }
+    /// boxes of solid blocks, relative to chunkPos (none until the chunk is meshed)
+    PooledVector<OccluderBox> const& getOccluders() const { return mVisibility.occluders; }
+
+    /// true iff the chunk has meshes or occluders
+    bool hasContent() const { return mHasContent; }
+    /// Bounding box of all meshes and occluders (world space, only valid if hasContent)
+    tg::pos3 getContentAabbMin() const { return mContentAabbMin; }
+    tg::pos3 getContentAabbMax() const { return mContentAabbMax; }
+
+    /// Bounding box of all non-air blocks
     tg::pos3 getAabbMin() const { return mAabbMin; }
     tg::pos3 getAabbMax() const { return mAabbMax; }
 
@@ -52,12 +70,12 @@ public: // properties
     tg::pos3 chunkCenter() const { return tg::pos3(chunkPos) + CHUNK_SIZE / 2.0f; }
 
 private: // private members
-    /// List of blocks
+    /// List of blocks (uniform, palette, or dense, see BlockStorage)
     /// Use block(...) functions!
-    std::vector<Block> mBlocks;
+    BlockStorage mBlocks;
 
     /// This chunk's configured meshes
-    std::vector<TerrainMesh> mMeshes;
+    PooledVector<TerrainMesh> mMeshes;
 
     /// if true, the list of blocks has changed and the mesh might be invalid
     bool mIsDirty = false; //< on cpu side (updated every frame)
@@ -70,15 +88,72 @@ private: // private members
     /// true iff chunk is generated
     bool mIsGenerated = false;
 
+    /// true iff notifyMeshData was called at least once
+    bool mIsMeshed = false;
+
+    /// true iff blocks were edited since the last mesh update was triggered
+    bool mIsEdited = false;
+
+    /// incremented by every block change
+    /// (a copy compacted by a worker is only taken over if no block changed in the meantime)
+    int mBlockRevision = 0;
+
+    /// true iff a job of this chunk was cancelled and waits until the chunk is back in range
+    bool mIsParked = false;
+
+    /// true iff the chunk was removed from the world (results of pending jobs are discarded)
+    bool mIsEvicted = false;
+
+    /// true iff blocks of this chunk were edited by the user
+    /// (without a region store such chunks are never evicted, regenerating them would lose the edits)
+    bool mHasEdits = false;
+
+    /// true iff the chunk has edits that are not written to the region store yet
+    bool mNeedsSave = false;
+
+    /// last time (see World::update) the chunk was within the eviction distance
+    double mLastUsedTime = 0.0;
+
+    /// GPU memory used by mMeshes in bytes
+    size_t mMeshMemory = 0;
+
     /// versioning of the mesh (is incremented whenever a mesh update is triggered)
-    int mMeshVersion = 0;
+    /// (read by the worker threads)
+    std::atomic<int> mMeshVersion = {0};
+
+    /// mesh version of the last update triggered for each section
+    /// (a job is outdated for all sections that were re-triggered in the meantime)
+    std::atomic<int> mSectionMeshVersion[CHUNK_SECTIONS] = {};
+
+    /// sections whose mesh is outdated (bit mask, see CHUNK_SECTIONS)
+    int mDirtySections = 0;
+
+    /// visibility information of the blocks and the mesh version it was computed for
+    ChunkVisibility mVisibility;
+    int mVisibilityVersion = 0;
 
     /// bounding box
     tg::pos3 mAabbMin;
     tg::pos3 mAabbMax;
 
-    /// list of blocks that spawn light sources
-    std::vector<tg::ipos3> mActiveLightFountains;
+    /// bounding box of meshes and occluders (see updateContentBounds)
+    bool mHasContent = false;
+    tg::pos3 mContentAabbMin;
+    tg::pos3 mContentAabbMax;
+
+    // block statistics
+    // (computed by the worker after generation, then updated by setBlock)
+    int mAirCount = 0;
+    int mSolidCount = 0;
+    /// number of blocks per material (index mat + 128)
+    uint16_t mMaterialCount[256] = {};
+    /// number of non-air blocks per x, y, and z slice (for the bounding box)
+    uint16_t mOccupancy[3][CHUNK_SIZE] = {};
+    /// all blocks that spawn light sources (world coordinates)
+    PooledVector<tg::ipos3> mLightFountains;
+
+    /// list of blocks that spawn light sources (with air above)
+    PooledVector<tg::ipos3> mActiveLightFountains;
 
 private: // ctor
     Chunk(tg::ipos3 chunkPos, World* world);
@@ -88,6 +163,12 @@ private: // ctor
     Chunk& operator=(Chunk const&) = delete;
     Chunk& operator=(Chunk&&) = delete;
 
+private: // helper
+    /// adds (delta = 1) or removes (delta = -1) a block from the statistics
+    void countBlock(tg::ivec3 relPos, Block b, int delta);
+    /// recomputes the bounding box of meshes and occluders
+    void updateContentBounds();
+
 public: // create
     static SharedChunk create(tg::ipos3 chunkPos, World* world);
 
@@ -95,27 +176,56 @@ public: // gfx
     /// returns an up-to-date version of the current meshes
     /// (might lazily rebuild the mesh)
     /// there is one or more meshes for each material
-    std::vector<TerrainMesh> const& queryMeshes();
+    PooledVector<TerrainMesh> const& queryMeshes();
 
 public: // modification funcs
     /// Marks this chunk as "dirty" (triggers rebuild of mesh)
     void markDirty();
+    /// Marks this chunk as "dirty", only the given sections are remeshed (bit mask)
+    void markDirty(int sections);
+
+    /// bumps the mesh version of the given sections, returns the new version
+    int beginMeshUpdate(int sections);
+    /// returns the subset of sections whose latest update is the given version
+    int currentSections(int sections, int version) const;
 
     /// Updates cpu part of the chunk
+    /// (from the block statistics, does not scan the blocks)
     void update();
 
-    /// Replaces current mesh data by new one
-    void notifyMeshData(const std::vector<TerrainMeshData>& meshData);
+    /// recomputes the block statistics from scratch
+    /// (called by the worker after generation or loading)
+    void computeStats();
+
+    /// Replaces the meshes of the given sections by new ones
+    void notifyMeshData(int sections, const PooledVector<TerrainMeshData>& meshData);
+    /// Replaces the visibility information (ignored if computed for an older mesh version than the current one)
+    void notifyVisibility(int version, ChunkVisibility const& visibility);
+    /// Replaces the dense blocks by a compacted copy (ignored if blocks changed since the given revision)
+    void notifyCompactedBlocks(int revision, BlockStorage blocks);
 
 public: // accessor functions
     /// relative coordinates 0..size-1
     /// do not call outside that range
-    Block& block(tg::ivec3 relPos) { return mBlocks[(relPos.z * CHUNK_SIZE + relPos.y) * CHUNK_SIZE + relPos.x]; }
-    Block const& block(tg::ivec3 relPos) const
+    Block block(tg::ivec3 relPos) const { return mBlocks.get((relPos.z * CHUNK_SIZE + relPos.y) * CHUNK_SIZE + relPos.x); }
+    /// replaces a block and updates the block statistics (relative coordinates)
+    /// CAUTION: switches to the dense representation
+    /// (compacted again by the worker that meshes the chunk, see notifyCompactedBlocks)
+    void setBlock(tg::ivec3 relPos, Block b);
+
+    /// copies count blocks in x direction, starting at relative coordinates relPos
+    void copyBlockRow(tg::ivec3 relPos, int count, Block* dst) const
     {
-        return mBlocks[(relPos.z * CHUNK_SIZE + relPos.y) * CHUNK_SIZE + relPos.x];
+        mBlocks.copyTo((relPos.z * CHUNK_SIZE + relPos.y) * CHUNK_SIZE + relPos.x, count, dst);
     }
 
+    /// heap memory used by the blocks in bytes
+    size_t getBlockMemory() const { return mBlocks.getMemoryUsage(); }
+    /// GPU memory used by the meshes in bytes
+    size_t getMeshMemory() const { return mMeshMemory; }
+    /// total memory used by this chunk in bytes (approximate)
+    size_t getMemoryUsage() const { return sizeof(Chunk) + getBlockMemory() + getMeshMemory(); }
+
     /// returns true iff these global coordinates are contained in this block
     bool contains(tg::ipos3 p) const
     {
@@ -126,14 +236,14 @@ public: // accessor functions
 
     /// queries a block in global coordinates
     /// will first search locally and otherwise consult world
-    Block const& queryBlock(tg::ipos3 worldPos) const;
+    Block queryBlock(tg::ipos3 worldPos) const;
 
     /// returns a list of all materials in this chunk
     /// may contain nullptr for air!
     std::vector<Material const*> queryMaterials() const;
 
     /// returns a list of all active light fountains
-    std::vector<tg::ipos3> const& getActiveLightFountains() const { return mActiveLightFountains; }
+    PooledVector<tg::ipos3> const& getActiveLightFountains() const { return mActiveLightFountains; }
 
     friend class World;
 };
@@ -0,0 +1,178 @@
+#include "ChunkVisibility.hh"
+
+#include <cstdint>
+
+#include <glow/common/profiling.hh>
+
+#include "Constants.hh"
+
+namespace
+{
+static_assert(CHUNK_SIZE <= 32, "solid layers are stored as 32 bit masks");
+
+auto constexpr blockCount = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+auto constexpr tileCount = CHUNK_SIZE / occluderTileSize;
+
+/// flood fills every region of open blocks, all faces it touches are connected
+/// visited is true for solid blocks (and all blocks afterwards)
+/// index of a block is (z * CHUNK_SIZE + y) * CHUNK_SIZE + x
+FaceConnectivity floodFillFaces(bool* visited)
+{
+    FaceConnectivity result = 0;
+    PooledVector<int> stack;
+    for (auto start = 0; start < blockCount; ++start)
+    {
+        if (visited[start])
+            continue;
+
+        auto faces = 0;
+        visited[start] = true;
+        stack.push_back(start);
+        while (!stack.empty())
+        {
+            auto i = stack.back();
+            stack.pop_back();
+
+            auto x = i % CHUNK_SIZE;
+            auto y = i / CHUNK_SIZE % CHUNK_SIZE;
+            auto z = i / (CHUNK_SIZE * CHUNK_SIZE);
+
+            // neighbors inside the chunk, faces for the ones outside
+            auto visit = [&](bool inside, int face, int j) {
+                if (!inside)
+                    faces |= 1 << face;
+                else if (!visited[j])
+                {
+                    visited[j] = true;
+                    stack.push_back(j);
+                }
+            };
+            visit(x > 0, 0, i - 1);
+            visit(x < CHUNK_SIZE - 1, 1, i + 1);
+            visit(y > 0, 2, i - CHUNK_SIZE);
+            visit(y < CHUNK_SIZE - 1, 3, i + CHUNK_SIZE);
+            visit(z > 0, 4, i - CHUNK_SIZE * CHUNK_SIZE);
+            visit(z < CHUNK_SIZE - 1, 5, i + CHUNK_SIZE * CHUNK_SIZE);
+        }
+
+        for (auto a = 0; a < 6; ++a)
+            if (faces >> a & 1)
+                for (auto b = 0; b < 6; ++b)
+                    if (faces >> b & 1)
+                        result |= FaceConnectivity(1) << (a * 6 + b);
+
+        if (result == allFacesConnected)
+            break; // nothing left to add
+    }
+
+    return result;
+}
+
+/// merges the solid layer ranges of the block columns into boxes
+/// solidLayers[tz][tx] has bit y set iff all blocks of layer y in that column are solid
+PooledVector<OccluderBox> mergeOccluders(uint32_t const (&solidLayers)[tileCount][tileCount])
+{
+    // longest range of solid layers per column
+    tg::ipos2 range[tileCount][tileCount];
+    for (auto tz = 0; tz < tileCount; ++tz)
+        for (auto tx = 0; tx < tileCount; ++tx)
+        {
+            auto best = tg::ipos2(0, 0);
+            auto y = 0;
+            auto layers = solidLayers[tz][tx];
+            while (y < CHUNK_SIZE)
+            {
+                if (!(layers >> y & 1))
+                {
+                    ++y;
+                    continue;
+                }
+
+                auto y0 = y;
+                while (y < CHUNK_SIZE && layers >> y & 1)
+                    ++y;
+                if (y - y0 > best.y - best.x)
+                    best = {y0, y};
+            }
+            range[tz][tx] = best;
+        }
+
+    // greedy rectangles of columns with the same range
+    PooledVector<OccluderBox> boxes;
+    bool used[tileCount][tileCount] = {};
+    for (auto tz = 0; tz < tileCount; ++tz)
+        for (auto tx = 0; tx < tileCount; ++tx)
+        {
+            auto r = range[tz][tx];
+            if (used[tz][tx] || r.x == r.y)
+                continue;
+
+            auto ex = tx + 1;
+            while (ex < tileCount && !used[tz][ex] && range[tz][ex] == r)
+                ++ex;
+
+            auto ez = tz + 1;
+            for (; ez < tileCount; ++ez)
+            {
+                auto rowMatches = true;
+                for (auto x = tx; x < ex; ++x)
+                    rowMatches = rowMatches && !used[ez][x] && range[ez][x] == r;
+                if (!rowMatches)
+                    break;
+            }
+
+            for (auto z = tz; z < ez; ++z)
+                for (auto x = tx; x < ex; ++x)
+                    used[z][x] = true;
+
+            boxes.push_back({{tx * occluderTileSize, r.x, tz * occluderTileSize}, //
+                             {ex * occluderTileSize, r.y, ez * occluderTileSize}});
+        }
+
+    return boxes;
+}
+} // namespace
+
+ChunkVisibility computeChunkVisibility(PooledVector<Block> const& blocks)
+{
+    GLOW_ACTION("[WORKER] - chunk visibility");
+
+    auto constexpr cs = CHUNK_SIZE + 2;
+
+    // solid blocks count as visited
+    bool visited[blockCount];
+    uint32_t solidLayers[tileCount][tileCount];
+    for (auto& row : solidLayers)
+        for (auto& layers : row)
+            layers = ~0u;
+
+    auto openCount = 0;
+    for (auto z = 0; z < CHUNK_SIZE; ++z)
+        for (auto x = 0; x < CHUNK_SIZE; ++x)
+        {
+            uint32_t solid = 0;
+            for (auto y = 0; y < CHUNK_SIZE; ++y)
+            {
+                auto isSolid = blocks[((z + 1) * cs + y + 1) * cs + x + 1].isSolid();
+                visited[(z * CHUNK_SIZE + y) * CHUNK_SIZE + x] = isSolid;
+                openCount += !isSolid;
+                solid |= uint32_t(isSolid) << y;
+            }
+            solidLayers[z / occluderTileSize][x / occluderTileSize] &= solid;
+        }
+
+    ChunkVisibility vis;
+
+    // early outs: no open block connects anything, a fully open chunk connects everything
+    if (openCount == 0)
+        vis.connectivity = 0;
+    else if (openCount == blockCount)
+        vis.connectivity = allFacesConnected;
+    else
+        vis.connectivity = floodFillFaces(visited);
+
+    if (openCount < blockCount)
+        vis.occluders = mergeOccluders(solidLayers);
+
+    return vis;
+}
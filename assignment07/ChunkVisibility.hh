@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#include <typed-geometry/tg-lean.hh>
+
+#include "Block.hh"
+#include "helper/MemoryPool.hh"
+
+/**
+ * @brief Visibility information of chunks, computed by the worker threads whenever a chunk is meshed
+ *
+ *  - face connectivity for the visibility graph (see World::updateVisibility)
+ *  - solid boxes as occluders for the occlusion buffer (see OcclusionBuffer)
+ *
+ * The faces of a chunk are indexed 0 .. 5: -x, +x, -y, +y, -z, +z (so face ^ 1 is the opposite face).
+ * Two faces are connected if a path of non-solid blocks (air or translucent) inside the chunk touches both.
+ * Bit (a * 6 + b) of a FaceConnectivity mask is set iff faces a and b are connected (symmetric).
+ *
+ * Occluders are boxes of solid blocks: the chunk is divided into columns of occluderTileSize x occluderTileSize blocks,
+ * each column contributes the longest range of layers in which all of its blocks are solid,
+ * adjacent columns with the same range are merged.
+ */
+using FaceConnectivity = uint64_t;
+
+/// every face is connected to every other one (e.g. for chunks that are not meshed yet)
+constexpr FaceConnectivity allFacesConnected = (FaceConnectivity(1) << 36) - 1;
+
+/// true iff faces a and b are connected
+inline bool facesConnected(FaceConnectivity c, int a, int b) { return (c >> (a * 6 + b)) & 1; }
+
+/// outward direction of a face
+inline tg::ivec3 faceDirection(int face)
+{
+    auto d = tg::ivec3::zero;
+    d[face >> 1] = face & 1 ? 1 : -1;
+    return d;
+}
+
+/// width of the block columns that occluders are made of
+constexpr int occluderTileSize = 8;
+
+/// box of solid blocks, relative to the chunk (max is exclusive)
+struct OccluderBox
+{
+    tg::ipos3 min;
+    tg::ipos3 max;
+};
+
+/// visibility information of a chunk
+struct ChunkVisibility
+{
+    FaceConnectivity connectivity = allFacesConnected;
+    PooledVector<OccluderBox> occluders;
+};
+
+/// computes the visibility information of the blocks of a chunk
+/// Blocks contain 1 neighborhood (like generateMesh), only the blocks of the chunk itself are considered
+ChunkVisibility computeChunkVisibility(PooledVector<Block> const& blocks);
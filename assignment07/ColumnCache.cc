@@ -0,0 +1,36 @@
+#include "ColumnCache.hh"
+
+void ColumnCache::retain(tg::ipos3 chunkPos)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto& entry = mEntries[keyOf(chunkPos)];
+    if (!entry)
+        entry = std::make_shared<Entry>();
+    ++entry->chunks;
+}
+
+void ColumnCache::release(tg::ipos3 chunkPos)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mEntries.find(keyOf(chunkPos));
+    if (it == mEntries.end())
+        return;
+
+    // workers that still use the column keep it alive
+    if (--it->second->chunks == 0)
+        mEntries.erase(it);
+}
+
+void ColumnCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+}
+
+int ColumnCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return (int)mEntries.size();
+}
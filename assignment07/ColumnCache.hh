@@ -0,0 +1,92 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <typed-geometry/tg-std.hh>
+#include <typed-geometry/tg.hh>
+
+#include "Constants.hh"
+
+/// 2D terrain parameters of a column of chunks (everything that only depends on x and z)
+/// Index is z * CHUNK_SIZE + x
+struct TerrainColumn
+{
+    /// terrain height (including the hill factor)
+    double height[CHUNK_SIZE * CHUNK_SIZE];
+    /// grass is only generated below this height
+    float grassLine[CHUNK_SIZE * CHUNK_SIZE];
+    /// snow is only generated above this height
+    float snowLine[CHUNK_SIZE * CHUNK_SIZE];
+};
+
+/**
+ * @brief Cache of TerrainColumns, shared by all vertically stacked chunks
+ *
+ * Columns are reference-counted by the resident chunks of the world (retain/release, render thread),
+ * a column is dropped together with its last chunk.
+ * acquire is called by the worker threads, concurrent requests of the same column compute it only once.
+ *
+ * Columns are identified by the x/z position of their chunks (y is ignored).
+ */
+class ColumnCache
+{
+private:
+    struct Entry
+    {
+        int chunks = 0; ///< resident chunks of this column (guarded by mMutex)
+
+        std::mutex mutex; ///< guards computation
+        bool isComputed = false;
+        std::shared_ptr<TerrainColumn> column;
+    };
+
+    mutable std::mutex mMutex;
+    std::unordered_map<tg::ipos2, std::shared_ptr<Entry>> mEntries;
+
+public:
+    /// a chunk of the column became resident
+    void retain(tg::ipos3 chunkPos);
+    /// a chunk of the column was removed
+    void release(tg::ipos3 chunkPos);
+    /// removes all columns
+    void clear();
+
+    /// returns the column of a chunk, compute(column) is called if it is not cached yet
+    /// (columns without resident chunks are computed but not cached)
+    /// may be called from any thread
+    template <class ComputeF>
+    std::shared_ptr<TerrainColumn const> acquire(tg::ipos3 chunkPos, ComputeF&& compute)
+    {
+        std::shared_ptr<Entry> entry;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = mEntries.find(keyOf(chunkPos));
+            if (it != mEntries.end())
+                entry = it->second;
+        }
+
+        if (!entry)
+        {
+            auto column = std::make_shared<TerrainColumn>();
+            compute(*column);
+            return column;
+        }
+
+        std::lock_guard<std::mutex> lock(entry->mutex);
+        if (!entry->isComputed)
+        {
+            entry->column = std::make_shared<TerrainColumn>();
+            compute(*entry->column);
+            entry->isComputed = true;
+        }
+        return entry->column;
+    }
+
+    /// number of cached columns
+    int size() const;
+
+private:
+    static tg::ipos2 keyOf(tg::ipos3 chunkPos) { return {chunkPos.x, chunkPos.z}; }
+};
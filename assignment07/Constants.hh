@@ -2,4 +2,15 @@
 
 #define CHUNK_SIZE 32
 
+/// chunks are meshed in horizontal sections of this many block rows
+/// (an edit only remeshes the sections it touches)
+#define CHUNK_SECTION_HEIGHT 8
+#define CHUNK_SECTIONS (CHUNK_SIZE / CHUNK_SECTION_HEIGHT)
+/// bit mask of all sections
+#define CHUNK_ALL_SECTIONS ((1 << CHUNK_SECTIONS) - 1)
+
 #define SHADOW_CASCADES 3
+
+/// levels of detail beyond the full resolution chunks
+/// (a cell of level l covers 2^l x 2^l chunk columns with voxels of 2^l blocks, see LodBuilder.hh)
+#define LOD_LEVELS 3
@@ -74,6 +74,23 @@ public:
         return true;
     }
 
+    /// true iff the bounding sphere of the box is completely inside the frustum
+    bool isAabbInside(tg::pos3 amin, tg::pos3 amax) const
+    {
+        auto center = (amin + amax) / 2.0f;
+        auto radius = distance(amax, center);
+
+        for (auto i = 0; i < 6; ++i)
+        {
+            auto const& p = planes[i];
+            auto dis = dot(center, tg::vec3(p));
+            if (dis + radius > p.w)
+                return false;
+        }
+
+        return true;
+    }
+
     bool isAabbInRange(tg::pos3 amin, tg::pos3 amax, float renderDistance) const
     {
         auto p = clamp(camPos, amin, amax);
@@ -84,6 +101,13 @@ public:
         return true;
     }
 
+    /// true iff the farthest corner of the box is within the render distance
+    bool isAabbFullyInRange(tg::pos3 amin, tg::pos3 amax, float renderDistance) const
+    {
+        auto d = tg::max(tg::abs(camPos - amin), tg::abs(camPos - amax));
+        return length(d) <= renderDistance;
+    }
+
     bool isFaceVisible(tg::ivec3 dir, tg::pos3 amin, tg::pos3 amax) const
     {
         auto n = tg::vec3(dir);
@@ -0,0 +1,269 @@
+#include "LodBuilder.hh"
+
+#include <cstring>
+#include <memory>
+
+#include <glow/common/profiling.hh>
+
+#include "BlockStorage.hh"
+#include "ColumnCache.hh"
+#include "RegionStore.hh"
+#include "TerrainGenerator.hh"
+
+namespace
+{
+/// rounds towards negative infinity
+int floorDiv(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+/// block counts of a single voxel
+struct VoxelCounts
+{
+    int solid = 0;
+    int translucent = 0;
+    int total = 0;
+
+    /// blocks per material (index mat + 128)
+    int perMat[256] = {};
+    /// materials with a non-zero count
+    int8_t mats[256];
+    int matCount = 0;
+
+    /// adds n blocks of the same material
+    void add(Block b, int n = 1)
+    {
+        if (n <= 0)
+            return;
+
+        total += n;
+        solid += b.isSolid() ? n : 0;
+        translucent += b.isTranslucent() ? n : 0;
+
+        if (perMat[b.mat + 128] == 0)
+            mats[matCount++] = b.mat;
+        perMat[b.mat + 128] += n;
+    }
+
+    /// majority selection (see LodBuilder.hh), resets the counts
+    Block select()
+    {
+        // solid if most blocks are solid, translucent if most are at least translucent
+        auto wantSolid = 2 * solid > total || (2 * (solid + translucent) > total && solid >= translucent);
+        auto wantTranslucent = !wantSolid && 2 * (solid + translucent) > total;
+
+        // most frequent material of that kind
+        auto result = Block::air();
+        auto best = 0;
+        for (auto i = 0; i < matCount; ++i)
+        {
+            auto b = Block(mats[i]);
+            auto n = perMat[b.mat + 128];
+            perMat[b.mat + 128] = 0;
+
+            if (n > best && ((wantSolid && b.isSolid()) || (wantTranslucent && b.isTranslucent())))
+            {
+                result = b;
+                best = n;
+            }
+        }
+
+        solid = translucent = total = matCount = 0;
+        return result;
+    }
+};
+
+/// voxels of all cubes of a cell including a border of one voxel
+/// Index is (z * sizeY + y) * sizeX + x
+struct LodVolume
+{
+    int sizeX = 0;
+    int sizeY = 0;
+    int sizeZ = 0;
+    std::vector<Block> voxels;
+
+    Block& at(int x, int y, int z) { return voxels[(z * sizeY + y) * sizeX + x]; }
+};
+} // namespace
+
+std::vector<LodCubeData> buildLodCell(int level,
+                                      tg::ipos3 origin,
+                                      TerrainGenerator const& generator,
+                                      ColumnCache& columns,
+                                      RegionStore* store,
+                                      MeshingMode mode,
+                                      int skirtDepth)
+{
+    GLOW_ACTION("[WORKER] - build LOD cell");
+
+    auto const s = 1 << level;             // blocks per voxel side
+    auto const chunks = s;                 // chunk columns per footprint side
+    auto const footprint = CHUNK_SIZE * s; // blocks per footprint side
+    auto const chunkVoxels = CHUNK_SIZE / s;
+    auto const& mats = generator.getMaterials();
+    origin.y = 0;
+
+    // 2D terrain of the footprint and of the neighboring columns (for the border)
+    auto const columnsPerSide = chunks + 2;
+    std::vector<std::shared_ptr<TerrainColumn const>> cols(columnsPerSide * columnsPerSide);
+    for (auto cz = -1; cz <= chunks; ++cz)
+        for (auto cx = -1; cx <= chunks; ++cx)
+        {
+            auto cp = origin + tg::ivec3(cx, 0, cz) * CHUNK_SIZE;
+            cols[(cz + 1) * columnsPerSide + cx + 1]
+                = columns.acquire(cp, [&](TerrainColumn& col) { generator.generateColumn(cp, col); });
+        }
+
+    // terrain height of a block column (relative to origin, one voxel into the neighboring columns at most)
+    auto heightAt = [&](int x, int z) -> int {
+        auto cx = floorDiv(x, CHUNK_SIZE);
+        auto cz = floorDiv(z, CHUNK_SIZE);
+        auto const& col = *cols[(cz + 1) * columnsPerSide + cx + 1];
+        return (int)tg::floor(col.height[(z - cz * CHUNK_SIZE) * CHUNK_SIZE + x - cx * CHUNK_SIZE]);
+    };
+
+    // height range of the footprint and its border
+    auto minHeight = heightAt(-s, -s);
+    auto maxHeight = minHeight;
+    for (auto z = -s; z < footprint + s; ++z)
+        for (auto x = -s; x < footprint + s; ++x)
+        {
+            auto h = heightAt(x, z);
+            minHeight = tg::min(minHeight, h);
+            maxHeight = tg::max(maxHeight, h);
+        }
+
+    // blocks below the skirts are never visible
+    // (no chunks are generated for them, they are filled with solid voxels)
+    auto const hiddenBelow = floorDiv(minHeight - (skirtDepth + 1) * s, CHUNK_SIZE) * CHUNK_SIZE;
+
+    // cubes from the hidden blocks up to the terrain or the water surface (y = 0)
+    auto const cubeSize = CHUNK_SIZE * s;
+    auto const cubeLo = floorDiv(hiddenBelow, cubeSize);
+    auto const cubeHi = floorDiv(tg::max(maxHeight, 0), cubeSize);
+    auto const cubeCount = cubeHi - cubeLo + 1;
+
+    // voxel volume (y = 0 is the border below the first cube)
+    LodVolume vol;
+    vol.sizeX = CHUNK_SIZE + 2;
+    vol.sizeY = cubeCount * CHUNK_SIZE + 2;
+    vol.sizeZ = CHUNK_SIZE + 2;
+    vol.voxels.resize(vol.sizeX * vol.sizeY * vol.sizeZ);
+    auto const voxelY0 = cubeLo * CHUNK_SIZE - 1; // voxel y coordinate of vol.at(.., 0, ..)
+
+    VoxelCounts counts;
+
+    // border: the terrain heights lowered by the skirt depth
+    // (solid below, water up to the sea level, air above)
+    for (auto vz = 0; vz < vol.sizeZ; ++vz)
+        for (auto vx = 0; vx < vol.sizeX; ++vx)
+        {
+            if (vx > 0 && vx <= CHUNK_SIZE && vz > 0 && vz <= CHUNK_SIZE)
+                continue; // inside
+
+            for (auto vy = 0; vy < vol.sizeY; ++vy)
+            {
+                auto y0 = (voxelY0 + vy) * s;
+                for (auto z = 0; z < s; ++z)
+                    for (auto x = 0; x < s; ++x)
+                    {
+                        auto h = heightAt((vx - 1) * s + x, (vz - 1) * s + z) - skirtDepth * s;
+                        auto solid = tg::clamp(h - y0 + 1, 0, s);
+                        auto water = tg::clamp(tg::min(0, y0 + s - 1) - tg::max(h + 1, y0) + 1, 0, s);
+                        counts.add(Block(mats.rock), solid);
+                        counts.add(Block(mats.water), water);
+                        counts.add(Block::air(), s - solid - water);
+                    }
+
+                vol.at(vx, vy, vz) = counts.select();
+            }
+        }
+
+    // inside: hidden solid voxels below, air above (the blocks in between are downsampled below)
+    for (auto vz = 1; vz <= CHUNK_SIZE; ++vz)
+        for (auto vy = 0; vy < vol.sizeY; ++vy)
+            for (auto vx = 1; vx <= CHUNK_SIZE; ++vx)
+                vol.at(vx, vy, vz) = (voxelY0 + vy) * s < hiddenBelow ? Block(mats.rock) : Block::air();
+
+    // downsample all chunks between the hidden blocks and the top of their column
+    std::vector<Block> dense(BlockStorage::blockCount);
+    for (auto cz = 0; cz < chunks; ++cz)
+        for (auto cx = 0; cx < chunks; ++cx)
+        {
+            auto const& column = *cols[(cz + 1) * columnsPerSide + cx + 1];
+
+            auto columnTop = 0; // water surface
+            for (auto i = 0; i < CHUNK_SIZE * CHUNK_SIZE; ++i)
+                columnTop = tg::max(columnTop, (int)tg::floor(column.height[i]));
+
+            for (auto y = hiddenBelow; y <= columnTop; y += CHUNK_SIZE)
+            {
+                auto cp = origin + tg::ivec3(cx * CHUNK_SIZE, y, cz * CHUNK_SIZE);
+
+                // stored chunks include the edits
+                BlockStorage blocks;
+                if (!store || !store->load(cp, blocks))
+                    generator.generate(cp, column, blocks);
+                blocks.copyTo(0, BlockStorage::blockCount, dense.data());
+
+                for (auto vz = 0; vz < chunkVoxels; ++vz)
+                    for (auto vy = 0; vy < chunkVoxels; ++vy)
+                        for (auto vx = 0; vx < chunkVoxels; ++vx)
+                        {
+                            for (auto z = vz * s; z < (vz + 1) * s; ++z)
+                                for (auto by = vy * s; by < (vy + 1) * s; ++by)
+                                    for (auto x = vx * s; x < (vx + 1) * s; ++x)
+                                        counts.add(dense[(z * CHUNK_SIZE + by) * CHUNK_SIZE + x]);
+
+                            vol.at(1 + cx * chunkVoxels + vx, y / s - voxelY0 + vy, 1 + cz * chunkVoxels + vz) = counts.select();
+                        }
+            }
+        }
+
+    // mesh every cube like a chunk
+    auto const ext = CHUNK_SIZE + 2;
+    std::vector<LodCubeData> cubes;
+    PooledVector<Block> cubeBlocks(ext * ext * ext);
+    for (auto k = 0; k < cubeCount; ++k)
+    {
+        for (auto z = 0; z < ext; ++z)
+            for (auto y = 0; y < ext; ++y)
+                std::memcpy(&cubeBlocks[(z * ext + y) * ext], &vol.at(0, k * CHUNK_SIZE + y, z), ext * sizeof(Block));
+
+        LodCubeData cube;
+        cube.origin = origin + tg::ivec3(0, (cubeLo + k) * cubeSize, 0);
+
+        // the mesher splits the chunk into sections, LOD cubes are never remeshed partially
+        // (one mesh per material and direction)
+        for (auto const& m : generateMesh(cubeBlocks, tg::ipos3::zero, mode))
+        {
+            if (m.vertices.empty())
+                continue;
+
+            auto amin = tg::pos3(cube.origin) + (m.aabbMin - tg::pos3::zero) * float(s);
+            auto amax = tg::pos3(cube.origin) + (m.aabbMax - tg::pos3::zero) * float(s);
+
+            TerrainMeshData* merged = nullptr;
+            for (auto& c : cube.meshes)
+                if (c.mat == m.mat && c.dir == m.dir)
+                    merged = &c;
+
+            if (!merged)
+            {
+                cube.meshes.emplace_back();
+                merged = &cube.meshes.back();
+                merged->mat = m.mat;
+                merged->dir = m.dir;
+                merged->aabbMin = amin;
+                merged->aabbMax = amax;
+            }
+
+            merged->aabbMin = tg::min(merged->aabbMin, amin);
+            merged->aabbMax = tg::max(merged->aabbMax, amax);
+            merged->vertices.insert(merged->vertices.end(), m.vertices.begin(), m.vertices.end());
+        }
+
+        if (!cube.meshes.empty())
+            cubes.push_back(std::move(cube));
+    }
+
+    return cubes;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+
+#include <typed-geometry/tg.hh>
+
+#include "Constants.hh"
+#include "MeshGenerator.hh"
+#include "TerrainMesh.hh"
+
+#include "helper/MemoryPool.hh"
+
+class TerrainGenerator;
+class ColumnCache;
+class RegionStore;
+
+/**
+ * @brief Downsampled terrain for distant regions (CPU only, no GL resources)
+ *
+ * A LOD cell of level l (1 .. LOD_LEVELS) covers a square footprint of 2^l x 2^l chunk columns (all heights).
+ * Its voxels are 2^l blocks wide, so a cube of CHUNK_SIZE^3 voxels covers as much as 2^l x 2^l x 2^l chunks.
+ * The cubes of a cell are meshed like chunks (positions in voxels, scaled in the vertex shader).
+ *
+ * Downsampling uses the full resolution blocks (stored or generated):
+ *  - a voxel is solid if most of its blocks are solid, otherwise translucent if most are translucent or solid
+ *  - its material is the most frequent one of that kind (majority selection)
+ * Chunks far below the terrain surface are never generated, they only contribute hidden solid voxels.
+ *
+ * Seams between cells of different levels are covered by skirts:
+ * the neighborhood of a cell is derived from the terrain heights, lowered by lodSkirtDepth voxels,
+ * so the side faces at the top of the cell border are always emitted.
+ * (the camera is always on the side of the finer neighbor, which is the one these faces are visible from)
+ */
+
+/// depth of the skirts at the sides of a LOD cell in voxels
+constexpr int lodSkirtDepth = 2;
+
+/// meshes of one cube of a LOD cell
+struct LodCubeData
+{
+    /// world space position of the first voxel of the cube
+    tg::ipos3 origin;
+
+    /// one mesh per (material, direction), positions in voxels, bounding boxes in world space
+    PooledVector<TerrainMeshData> meshes;
+};
+
+/// distance up to which a node of the given level is split into its finer children (nearest point of its footprint)
+/// (level 1 is split into chunks, so every chunk column within chunkDistance is drawn at full resolution)
+inline float lodSplitDistance(int level, float chunkDistance) { return chunkDistance * float(1 << (level - 1)); }
+
+/// horizontal distance between a position and the closest point of the footprint of a node
+inline float lodNearestDistance(tg::pos3 pos, tg::ipos3 origin, int level)
+{
+    auto size = float(CHUNK_SIZE << level);
+    auto dx = tg::max(0.0f, tg::max(float(origin.x) - pos.x, pos.x - (float(origin.x) + size)));
+    auto dz = tg::max(0.0f, tg::max(float(origin.z) - pos.z, pos.z - (float(origin.z) + size)));
+    return tg::sqrt(dx * dx + dz * dz);
+}
+
+/// downsamples and meshes all cubes of the LOD cell of the given level whose footprint starts at origin (y ignored)
+/// chunks are loaded from store (if not null) or generated otherwise, columns are taken from columns
+/// (level 0 without skirts meshes a column of chunks as they are, e.g. for comparisons)
+/// may be called from any thread
+std::vector<LodCubeData> buildLodCell(int level,
+                                      tg::ipos3 origin,
+                                      TerrainGenerator const& generator,
+                                      ColumnCache& columns,
+                                      RegionStore* store,
+                                      MeshingMode mode = MeshingMode::Greedy,
+                                      int skirtDepth = lodSkirtDepth);
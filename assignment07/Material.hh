@@ -12,6 +12,9 @@ struct RenderMaterial
 {
     std::string shader;
 
+    /// dense index of the render material (assigned by World, used to sort draws)
+    int id = -1;
+
     // material
     float metallic = 0.0;
     float reflectivity = 0.3;
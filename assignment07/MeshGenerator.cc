@@ -1,6 +1,16 @@
 #include "MeshGenerator.hh"
 
+#include <algorithm>
 #include <cassert>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #include <glow/common/log.hh>
 #include <glow/common/profiling.hh>
@@ -10,95 +20,356 @@
 
 #define EXT_SIZE (CHUNK_SIZE + 2)
 
+// quad sizes are packed into 5 bits per axis
+static_assert(CHUNK_SIZE <= 32, "greedy quads must fit into the vertex flags");
+
 namespace
 {
-int aoAt(const std::vector<Block> &blocks, tg::ipos3 pos, tg::ivec3 dx, tg::ivec3 dy)
+/// true iff a block of material mat has a visible face towards the neighbor nblk
+bool hasFace(int mat, Block nblk) { return !nblk.isSolid() && nblk.mat != mat; }
+
+/// number of different AO and edge flag combinations
+constexpr int faceFlagCount = 3 * 3 * 3 * 3 * 4 * 4 * 4 * 4;
+
+/// number of (material, direction) combinations
+constexpr int streamCount = 256 * 6;
+
+int streamIdx(int mat, int pdir) { return (mat + 128) * 6 + pdir; }
+
+/// packed AO and edge flags of a visible face
+/// solid(dt, db, dn) is the solidity of the block at np + dt * T + db * B + dn * N,
+/// where np is the (non-solid) neighbor in front of the face
+/// (faces can only be merged if these flags are identical)
+template <class SolidF>
+int faceFlagsOf(SolidF &&solid)
 {
-    auto block = [&blocks](tg::ipos3 ip) { return blocks[(ip.z * EXT_SIZE + ip.y) * EXT_SIZE + ip.x]; };
+    // Ambient Occlusion trick
+    auto aoAt = [&](int dt, int db) {
+        // query three relevant materials
+        auto s10 = solid(dt, 0, 0);
+        auto s01 = solid(0, db, 0);
+        auto s11 = solid(dt, db, 0);
 
-    // block(pos) is non-solid
+        if (s10 && s01)
+            s11 = true; // corner case
 
-    // query three relevant materials
-    auto s10 = block(pos + dx).isSolid();
-    auto s01 = block(pos + dy).isSolid();
-    auto s11 = block(pos + dx + dy).isSolid();
+        return 3 - s10 - s01 - s11;
+    };
+    auto a00 = aoAt(-1, -1);
+    auto a01 = aoAt(-1, +1);
+    auto a10 = aoAt(+1, -1);
+    auto a11 = aoAt(+1, +1);
+
+    // Edge tricks
+    auto edgeAt = [&](int dt, int db) {
+        if (solid(dt, db, 0))
+            return 2;
+        else if (solid(dt, db, -1))
+            return 1;
+        else
+            return 0;
+    };
+    auto ePT = edgeAt(+1, 0);
+    auto eNT = edgeAt(-1, 0);
+    auto ePB = edgeAt(0, +1);
+    auto eNB = edgeAt(0, -1);
+
+    // CAUTION: flag assembly in OPPOSITE direction
+    int flags = 0;
+
+    // edges
+    flags = flags * 3 + eNB;
+    flags = flags * 3 + ePB;
+    flags = flags * 3 + eNT;
+    flags = flags * 3 + ePT;
+
+    // AO
+    flags = flags * 4 + a11;
+    flags = flags * 4 + a10;
+    flags = flags * 4 + a01;
+    flags = flags * 4 + a00;
+
+    return flags;
+}
 
-    if (s10 && s01)
-        s11 = true; // corner case
+/// flags of the quad covering the faces f00 (smallest T and B) .. f11 (largest T and B) of a rectangle:
+/// the edges of its sides and the AO of its corners (see quadFaceFlags)
+int quadFlagsOf(int f00, int f01, int f10, int f11)
+{
+    // (AO: 4 values per corner, lowest digit first: 00, 01, 10, 11; then edges: 3 values per side: +T, -T, +B, -B)
+    auto ePT = f10 / 256 % 3;
+    auto eNT = f00 / 256 / 3 % 3;
+    auto ePB = f01 / 256 / 9 % 3;
+    auto eNB = f00 / 256 / 27 % 3;
+    auto edges = ((eNB * 3 + ePB) * 3 + eNT) * 3 + ePT;
+    return edges * 256 + (f11 / 64 % 4) * 64 + (f10 / 16 % 4) * 16 + (f01 / 4 % 4) * 4 + f00 % 4;
+}
 
-    return 3 - s10 - s01 - s11;
+/// face flags from the blocks
+int faceFlags(const PooledVector<Block> &blocks, tg::ipos3 np, tg::ivec3 n, tg::ivec3 idt, tg::ivec3 idb)
+{
+    return faceFlagsOf([&](int dt, int db, int dn) {
+        auto ip = np + dt * idt + db * idb + dn * n;
+        return blocks[(ip.z * EXT_SIZE + ip.y) * EXT_SIZE + ip.x].isSolid();
+    });
 }
 
-int edgeAt(const std::vector<Block> &blocks, tg::ipos3 pos, tg::ivec3 d, tg::ivec3 n)
+/// face flags of all 2^12 solidity patterns around a face (see Occupancy::flagIndex)
+/// per sign of T (T points along the negative axis for the positive directions)
+struct FaceFlagTable
 {
-    auto block = [&blocks](tg::ipos3 ip) { return blocks[(ip.z * EXT_SIZE + ip.y) * EXT_SIZE + ip.x]; };
+    int flags[2][1 << 12];
 
-    auto sTop = block(pos + d).isSolid();
-    auto sBot = block(pos + d - n).isSolid();
+    FaceFlagTable()
+    {
+        for (auto negT = 0; negT < 2; ++negT)
+            for (auto idx = 0; idx < 1 << 12; ++idx)
+                flags[negT][idx] = faceFlagsOf([&](int dt, int db, int dn) {
+                    auto du = negT ? -dt : dt; // offset along the positive T axis
+                    if (dn == 0)
+                    {
+                        // front plane: 3 bits per row, without the center
+                        auto bit = (db + 1) * 3 + du + 1;
+                        if (bit > 4)
+                            --bit;
+                        return bool(idx >> bit & 1);
+                    }
+
+                    // back plane: only the four edge neighbors are queried
+                    auto bit = db < 0 ? 8 : db > 0 ? 11 : du < 0 ? 9 : 10;
+                    return bool(idx >> bit & 1);
+                });
+    }
+
+    static FaceFlagTable const &instance()
+    {
+        static FaceFlagTable table;
+        return table;
+    }
+};
 
-    if (sTop)
-        return 2;
-    else if (sBot)
-        return 1;
-    else
-        return 0;
+int countTrailingZeros(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return int(idx);
+#else
+    return __builtin_ctzll(v);
+#endif
 }
 
-void buildMeshFor(const std::vector<Block> &blocks,
-                  tg::ipos3 chunkPos,
-                  int mat, //
-                  std::vector<TerrainMeshData> &newMeshes)
+/// transposes a 64x64 bit matrix in place (bit c of row r <-> bit r of row c)
+void transpose64(uint64_t *rows)
 {
-    auto block = [&blocks](tg::ipos3 ip) { return blocks[(ip.z * EXT_SIZE + ip.y) * EXT_SIZE + ip.x]; };
+    uint64_t m = 0x00000000FFFFFFFFull;
+    for (auto j = 32; j != 0; j >>= 1, m ^= m << j)
+        for (auto k = 0; k < 64; k = ((k | j) + 1) & ~j)
+        {
+            auto t = ((rows[k] >> j) ^ rows[k | j]) & m;
+            rows[k] ^= t << j;
+            rows[k | j] ^= t;
+        }
+}
 
-    // GLOW_ACTION(); // time this method (shown on shutdown)
+/**
+ * Solid and translucent occupancy of a padded neighborhood as bit rows
+ *
+ * For each axis N, rows[N][n][b] holds the blocks with N coordinate n and B coordinate b,
+ * bit u is the block with T coordinate u (T and B of the faces with normal N, both along the positive axis):
+ *   N = x: T = y, B = z
+ *   N = y: T = z, B = x
+ *   N = z: T = x, B = y (the memory layout of the blocks)
+ *
+ * Face visibility, AO, and edge flags of a whole row are then a few shifts and ANDs.
+ */
+struct Occupancy
+{
+    uint64_t solid[3][EXT_SIZE][EXT_SIZE];
+    uint64_t translucent[3][EXT_SIZE][EXT_SIZE];
 
-    // assemble data
-    std::vector<TerrainVertex> dataPerMesh[6];
-    std::vector<tg::pos3> positionsPerMesh[6];
-    TerrainMeshData meshes[6];
+    /// true iff at most one translucent material is present
+    /// (otherwise translucent faces between translucent blocks compare the materials)
+    bool singleTranslucent = true;
 
-    // set mesh dir
-    for (auto pdir = 0; pdir < 6; ++pdir)
+    /// fills all rows from a padded neighborhood
+    void build(const PooledVector<Block> &blocks)
     {
-        auto dir = pdir % 3;
-        auto s = pdir < 3 ? -1 : 1;
+        static_assert(sizeof(Block) == 1, "rows are built from the raw materials");
+        static_assert(EXT_SIZE <= 64, "rows must fit into 64 bit");
 
-        // face normal/direction
-        meshes[pdir].dir = s * tg::ivec3(dir == 0, dir == 1, dir == 2);
+        // rows along x (the memory layout of the blocks)
+        auto translucentMat = 0;
+        for (auto z = 0; z < EXT_SIZE; ++z)
+            for (auto y = 0; y < EXT_SIZE; ++y)
+            {
+                auto row = &blocks[(z * EXT_SIZE + y) * EXT_SIZE];
+                uint64_t s = 0;
+                uint64_t t = 0;
+                auto x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+                // 16 blocks at once: solid is mat > 0, translucent is the sign bit
+                auto const zero = _mm_setzero_si128();
+                for (; x + 16 <= EXT_SIZE; x += 16)
+                {
+                    auto mats = _mm_loadu_si128(reinterpret_cast<__m128i const *>(row + x));
+                    s |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpgt_epi8(mats, zero)))) << x;
+                    t |= uint64_t(uint32_t(_mm_movemask_epi8(mats))) << x;
+                }
+#endif
+                for (; x < EXT_SIZE; ++x)
+                {
+                    auto mat = row[x].mat;
+                    s |= uint64_t(mat > 0) << x;
+                    t |= uint64_t(mat < 0) << x;
+                }
+
+                // compare the translucent materials
+                for (auto bits = t; bits; bits &= bits - 1)
+                {
+                    auto mat = row[countTrailingZeros(bits)].mat;
+                    if (translucentMat == 0)
+                        translucentMat = mat;
+                    else if (mat != translucentMat)
+                        singleTranslucent = false;
+                }
+
+                solid[2][z][y] = s;
+                translucent[2][z][y] = t;
+            }
+
+        // the other axes by transposition
+        uint64_t m[64];
+        // (src is [z][y], bit x)
+        auto const full = (uint64_t(1) << EXT_SIZE) - 1;
+        auto transposeFrom = [&](uint64_t(&src)[EXT_SIZE][EXT_SIZE], uint64_t(&dst)[EXT_SIZE][EXT_SIZE], bool perZ) {
+            for (auto a = 0; a < EXT_SIZE; ++a)
+            {
+                // perZ: the y rows of a z plane (for N = x), otherwise the z rows of a y plane (for N = y)
+                uint64_t any = 0;
+                uint64_t all = full;
+                for (auto r = 0; r < 64; ++r)
+                {
+                    m[r] = r < EXT_SIZE ? (perZ ? src[a][r] : src[r][a]) : 0;
+                    any |= m[r];
+                    all &= r < EXT_SIZE ? m[r] : full;
+                }
+
+                // empty and full planes (most of them) are their own transpose
+                if (any != 0 && all != full)
+                    transpose64(m);
+                for (auto c = 0; c < EXT_SIZE; ++c)
+                    if (perZ)
+                        dst[c][a] = m[c]; // dst[x][z], bit y
+                    else
+                        dst[a][c] = m[c]; // dst[y][x], bit z
+            }
+        };
+        transposeFrom(solid[2], solid[0], true);
+        transposeFrom(translucent[2], translucent[0], true);
+        transposeFrom(solid[2], solid[1], false);
+        transposeFrom(translucent[2], translucent[1], false);
     }
 
-    // set mesh AB and VAO and AABB
-    for (auto mi = 0; mi < 6; ++mi)
+    /// solidity pattern around the face of the block (s, u, v) towards slice f (see FaceFlagTable)
+    int flagIndex(int dir, int s, int f, int u, int v) const
     {
-        auto &mesh = meshes[mi];
+        auto const &front = solid[dir][f];
+        auto const &back = solid[dir][s];
+        return int((front[v - 1] >> (u - 1)) & 7)           //
+               | int((front[v] >> (u - 1)) & 1) << 3        //
+               | int((front[v] >> (u + 1)) & 1) << 4        //
+               | int((front[v + 1] >> (u - 1)) & 7) << 5    //
+               | int((back[v - 1] >> u) & 1) << 8           //
+               | int((back[v] >> (u - 1)) & 1) << 9         //
+               | int((back[v] >> (u + 1)) & 1) << 10        //
+               | int((back[v + 1] >> u) & 1) << 11;
+    }
+};
+
+/// face frame of a packed direction
+/// packed dir 0,1,2 negative, 3,4,5 positive
+struct FaceDir
+{
+    tg::ivec3 n;
+    tg::ivec3 t;
+    tg::ivec3 b;
 
-        // set mat
-        mesh.mat = mat;
+    explicit FaceDir(int pdir)
+    {
+        auto dir = pdir % 3;
+        auto s = pdir < 3 ? -1 : 1;
 
-        // prepare AABB
-        mesh.aabbMin = tg::pos3(chunkPos) + CHUNK_SIZE + 1;
-        mesh.aabbMax = tg::pos3(chunkPos);
+        n = s * tg::ivec3(dir == 0, dir == 1, dir == 2);
+        t = tg::ivec3(cross(tg::vec3(n), tg::vec3(dir == 1, dir == 2, dir == 0)));
+        b = tg::ivec3(cross(tg::vec3(t), tg::vec3(n)));
     }
+};
+} // namespace
 
-    // optimized packed vertex
-    auto addVert = [&](tg::pos3 pos, int pdir, int vIdx, tg::ivec4 ao, tg::ivec4 edges) {
-        positionsPerMesh[pdir].push_back(pos);
+int quadFaceFlags(int quadFlags, int i, int j, int sizeT, int sizeB)
+{
+    auto onNT = i == 0;
+    auto onPT = i == sizeT - 1;
+    auto onNB = j == 0;
+    auto onPB = j == sizeB - 1;
+
+    // edges of the quad sides, 1 (continuing surface) inside
+    auto edges = quadFlags / 256;
+    auto ePT = onPT ? edges % 3 : 1;
+    auto eNT = onNT ? edges / 3 % 3 : 1;
+    auto ePB = onPB ? edges / 9 % 3 : 1;
+    auto eNB = onNB ? edges / 27 % 3 : 1;
+
+    // AO of a face corner: the quad corner, or on a side: occluded (1) iff the side is a wall (edge 2)
+    auto sideAO = [&](int e) { return e == 2 ? 1 : 3; };
+    auto cornerAO = [&](bool onT, bool onB, int shift, int eT, int eB) {
+        if (onT && onB)
+            return quadFlags >> shift & 3;
+        if (onT)
+            return sideAO(eT);
+        if (onB)
+            return sideAO(eB);
+        return 3;
+    };
+    auto a00 = cornerAO(onNT, onNB, 0, eNT, eNB);
+    auto a01 = cornerAO(onNT, onPB, 2, eNT, ePB);
+    auto a10 = cornerAO(onPT, onNB, 4, ePT, eNB);
+    auto a11 = cornerAO(onPT, onPB, 6, ePT, ePB);
+
+    return (((eNB * 3 + ePB) * 3 + eNT) * 3 + ePT) * 256 + a11 * 64 + a10 * 16 + a01 * 4 + a00;
+}
+
+PooledVector<TerrainMeshData> generateMesh(const PooledVector<Block> &blocks,
+                                           tg::ipos3 chunkPos,
+                                           MeshingMode mode,
+                                           int sections)
+{
+    GLOW_ACTION("[WORKER] - create mesh"); // time this method (shown on shutdown)
+
+    auto block = [&blocks](tg::ipos3 ip) { return blocks[(ip.z * EXT_SIZE + ip.y) * EXT_SIZE + ip.x]; };
+
+    FaceDir const faceDirs[6] = {FaceDir(0), FaceDir(1), FaceDir(2), FaceDir(3), FaceDir(4), FaceDir(5)};
 
+    PooledVector<TerrainMeshData> newMeshes;
+
+    // output stream per (material, direction) of the current section
+    // (fixed-size arrays: meshing does not allocate apart from the output)
+    int faceCount[streamCount];
+    int streamOf[streamCount];
+
+    // optimized packed vertex
+    // pos is the chunk-local corner (0..CHUNK_SIZE)
+    auto addVert = [](TerrainMeshData &mesh, tg::ipos3 pos, int pdir, int vIdx, int faceFlags, int sizeT, int sizeB) {
         // CAUTION: flag assembly in OPPOSITE direction
         int flags = 0;
 
-        // edges
-        flags = flags * 3 + edges.w;
-        flags = flags * 3 + edges.z;
-        flags = flags * 3 + edges.y;
-        flags = flags * 3 + edges.x;
+        // quad size (in blocks)
+        flags = flags * 32 + (sizeB - 1);
+        flags = flags * 32 + (sizeT - 1);
 
-        // AO
-        flags = flags * 4 + ao.w;
-        flags = flags * 4 + ao.z;
-        flags = flags * 4 + ao.y;
-        flags = flags * 4 + ao.x;
+        // edges and AO
+        flags = flags * faceFlagCount + faceFlags;
 
         // packed direction
         flags = flags * 6 + pdir;
@@ -108,149 +379,352 @@ void buildMeshFor(const std::vector<Block> &blocks,
 
         // assemble "vertex"
         TerrainVertex v;
+        v.position = TerrainVertex::packPosition(pos.x, pos.y, pos.z);
         v.flags = flags;
-        dataPerMesh[pdir].push_back(v);
+        mesh.vertices.push_back(v);
     };
 
-    for (auto z = 1; z <= CHUNK_SIZE; ++z)
-        for (auto y = 1; y <= CHUNK_SIZE; ++y)
-            for (auto x = 1; x <= CHUNK_SIZE; ++x)
-            {
-                tg::ipos3 p = {x, y, z}; // local position
-                auto const &blk = block(p);
+    // quad covering sizeT x sizeB faces, starting at the face of the local block p
+    auto addQuad = [&](tg::ipos3 p, int mat, int pdir, int faceFlags, int sizeT, int sizeB) {
+        auto &mesh = newMeshes[streamOf[streamIdx(mat, pdir)]];
+
+        auto const &fd = faceDirs[pdir];
+
+        // corner of the face with the smallest T and B coordinates
+        // (a face of block lp spans lp .. lp + 1 in T and B and lies at lp + (n + 1) / 2 along the normal)
+        auto lp = p - 1; // chunk-local block position
+        auto p00 = lp + (fd.n + 1) / 2 + (tg::ivec3(1) - fd.t) / 2 + (tg::ivec3(1) - fd.b) / 2;
+        auto p01 = p00 + fd.b * sizeB;
+        auto p10 = p00 + fd.t * sizeT;
+        auto p11 = p10 + fd.b * sizeB;
+
+        // Create face (vertex idx order, see getTerrainQuadIndices)
+        addVert(mesh, p00, pdir, 0, faceFlags, sizeT, sizeB);
+        addVert(mesh, p01, pdir, 1, faceFlags, sizeT, sizeB);
+        addVert(mesh, p10, pdir, 2, faceFlags, sizeT, sizeB);
+        addVert(mesh, p11, pdir, 3, faceFlags, sizeT, sizeB);
+    };
 
-                if (blk.mat != mat)
-                    continue; // consider only current material
+    // bit rows of the neighborhood (greedy meshing only, shared by all sections)
+    Occupancy occ;
 
-                auto gp = chunkPos + tg::ivec3(p) - 1; // global position
+    // padded position of the block at slice s, T coordinate u, and B coordinate v (see Occupancy)
+    auto blockAt = [&](int dir, int s, int u, int v) {
+        switch (dir)
+        {
+        case 0:
+            return block({s, u, v});
+        case 1:
+            return block({v, s, u});
+        default:
+            return block({u, v, s});
+        }
+    };
 
-                // go over all directions
-                // packed dir 0,1,2 negative, 3,4,5 positive
-                for (auto pdir = 0; pdir < 6; ++pdir)
+    // greedy: visible faces of all interior rows
+    // (bit u of visibleRows[pdir][s - 1][v - 1], bit v - 1 of rowMask[pdir][s - 1] iff the row has any)
+    uint64_t visibleRows[6][CHUNK_SIZE][CHUNK_SIZE];
+    uint32_t rowMask[6][CHUNK_SIZE];
+    if (mode == MeshingMode::Greedy)
+    {
+        occ.build(blocks);
+
+        auto const interior = ((uint64_t(1) << CHUNK_SIZE) - 1) << 1;
+        for (auto pdir = 0; pdir < 6; ++pdir)
+        {
+            auto dir = pdir % 3;
+            auto sign = pdir < 3 ? -1 : 1;
+            for (auto s = 1; s <= CHUNK_SIZE; ++s)
+            {
+                auto f = s + sign; // slice in front of the faces
+                auto const &solid = occ.solid[dir][s];
+                auto const &translucent = occ.translucent[dir][s];
+                auto const &frontSolid = occ.solid[dir][f];
+                auto const &frontTranslucent = occ.translucent[dir][f];
+                auto &vis = visibleRows[pdir][s - 1];
+
+                // faces towards non-solid blocks
+                // (translucent blocks have no faces towards the same translucent material)
+                for (auto v = 1; v <= CHUNK_SIZE; ++v)
                 {
-                    auto dir = pdir % 3;
-                    auto n = meshes[pdir].dir;
+                    auto sameTranslucent = translucent[v] & frontTranslucent[v];
+                    vis[v - 1] = (solid[v] | translucent[v]) & ~frontSolid[v] & ~sameTranslucent & interior;
+                }
 
-                    // neighbor position and block
-                    auto np = p + n;
-                    auto nblk = block(np); // "global" query
+                // .. but towards other translucent materials
+                if (!occ.singleTranslucent)
+                    for (auto v = 1; v <= CHUNK_SIZE; ++v)
+                        for (auto both = translucent[v] & frontTranslucent[v] & interior; both; both &= both - 1)
+                        {
+                            auto u = countTrailingZeros(both);
+                            if (blockAt(dir, s, u, v).mat != blockAt(dir, f, u, v).mat)
+                                vis[v - 1] |= uint64_t(1) << u;
+                        }
+
+                uint32_t mask = 0;
+                for (auto j = 0; j < CHUNK_SIZE; ++j)
+                    mask |= uint32_t(vis[j] != 0) << j;
+                rowMask[pdir][s - 1] = mask;
+            }
+        }
+    }
 
-                    // check if we have to gen a face
-                    bool hasFace = !nblk.isSolid() && nblk.mat != mat;
+    // per (material, direction), reset after each section
+    std::fill(std::begin(faceCount), std::end(faceCount), 0);
+    std::fill(std::begin(streamOf), std::end(streamOf), -1);
 
-                    if (hasFace)
+    // every section is meshed separately (faces are never merged across sections)
+    for (auto section = 0; section < CHUNK_SECTIONS; ++section)
+    {
+        if (!(sections >> section & 1))
+            continue;
+
+        // local y range of the section (inclusive)
+        auto yBegin = 1 + section * CHUNK_SECTION_HEIGHT;
+        auto yEnd = yBegin + CHUNK_SECTION_HEIGHT - 1;
+
+        // greedy: the part of a direction inside the section
+        // (padded slices along N, bit masks of the rows along B and the faces along T)
+        auto const sectionBits = ((uint64_t(1) << CHUNK_SECTION_HEIGHT) - 1) << (yBegin - 1);
+        struct SectionRange
+        {
+            int sliceBegin, sliceEnd;
+            uint32_t vBits; ///< bit v - 1
+            uint64_t tBits; ///< bit u
+        };
+        auto rangeOf = [&](int dir) {
+            SectionRange r;
+            r.sliceBegin = dir == 1 ? yBegin : 1;
+            r.sliceEnd = dir == 1 ? yEnd : CHUNK_SIZE;
+            r.vBits = dir == 2 ? uint32_t(sectionBits) : ~uint32_t(0);
+            r.tBits = dir == 0 ? sectionBits << 1 : ~uint64_t(0);
+            return r;
+        };
+
+        // pre-pass: count visible faces per (material, direction)
+        // (also tracks the materials in order of appearance)
+        int materials[256];
+        auto materialCount = 0;
+        bool hasMat[256] = {};
+        auto countFace = [&](int mat, int pdir) {
+            if (!hasMat[mat + 128])
+            {
+                hasMat[mat + 128] = true;
+                materials[materialCount++] = mat;
+            }
+            ++faceCount[streamIdx(mat, pdir)];
+        };
+
+        if (mode == MeshingMode::Naive)
+        {
+            for (auto z = 1; z <= CHUNK_SIZE; ++z)
+                for (auto y = yBegin; y <= yEnd; ++y)
+                    for (auto x = 1; x <= CHUNK_SIZE; ++x)
                     {
-                        auto dn = tg::vec3(n);
-                        auto dt = cross(dn, tg::vec3(dir == 1, dir == 2, dir == 0));
-                        auto db = cross(dt, dn);
-
-                        auto idt = tg::ivec3(dt);
-                        auto idb = tg::ivec3(db);
-
-                        auto pc = tg::pos3(gp) + 0.5f + dn * 0.5f;
-
-                        // vertex indixes
-                        auto i00 = 0;
-                        auto i01 = 1;
-                        auto i10 = 2;
-                        auto i11 = 3;
-
-                        // Calculate position
-                        auto p00 = pc - dt * 0.5f - db * 0.5f;
-                        auto p01 = pc - dt * 0.5f + db * 0.5f;
-                        auto p10 = pc + dt * 0.5f - db * 0.5f;
-                        auto p11 = pc + dt * 0.5f + db * 0.5f;
-
-                        // Ambient Occlusion trick
-                        auto a00 = aoAt(blocks, p + n, -idt, -idb);
-                        auto a01 = aoAt(blocks, p + n, -idt, +idb);
-                        auto a10 = aoAt(blocks, p + n, +idt, -idb);
-                        auto a11 = aoAt(blocks, p + n, +idt, +idb);
-
-                        tg::ivec4 ao = {a00, a01, a10, a11};
-
-                        // Edge tricks
-                        auto ePT = edgeAt(blocks, p + n, +idt, n);
-                        auto eNT = edgeAt(blocks, p + n, -idt, n);
-                        auto ePB = edgeAt(blocks, p + n, +idb, n);
-                        auto eNB = edgeAt(blocks, p + n, -idb, n);
-
-                        auto edges = tg::ivec4(ePT, eNT, ePB, eNB);
-                        // auto e00 = glm::ivec2(eNT, eNB);
-                        // auto e01 = glm::ivec2(eNT, ePB);
-                        // auto e10 = glm::ivec2(ePT, eNB);
-                        // auto e11 = glm::ivec2(ePT, ePB);
-
-                        // Create face
-                        addVert(p00, pdir, i00, ao, edges);
-                        addVert(p01, pdir, i01, ao, edges);
-                        addVert(p11, pdir, i11, ao, edges);
-
-                        addVert(p00, pdir, i00, ao, edges);
-                        addVert(p11, pdir, i11, ao, edges);
-                        addVert(p10, pdir, i10, ao, edges);
+                        tg::ipos3 p = {x, y, z}; // local position
+                        auto blk = block(p);
+                        if (blk.isAir())
+                            continue;
+
+                        for (auto pdir = 0; pdir < 6; ++pdir)
+                            if (hasFace(blk.mat, block(p + faceDirs[pdir].n)))
+                                countFace(blk.mat, pdir);
+                    }
+        }
+        else
+        {
+            for (auto pdir = 0; pdir < 6; ++pdir)
+            {
+                auto dir = pdir % 3;
+                auto r = rangeOf(dir);
+                for (auto s = r.sliceBegin; s <= r.sliceEnd; ++s)
+                    for (auto m = rowMask[pdir][s - 1] & r.vBits; m; m &= m - 1)
+                    {
+                        auto v = countTrailingZeros(m) + 1;
+                        for (auto vis = visibleRows[pdir][s - 1][v - 1] & r.tBits; vis; vis &= vis - 1)
+                            countFace(blockAt(dir, s, countTrailingZeros(vis), v).mat, pdir);
                     }
-                }
             }
+        }
 
-    // create GPU data and write results
-    for (auto pdir = 0; pdir < 6; ++pdir)
-    {
-        auto &mesh = meshes[pdir];
+        // create one output stream per (material, direction) with visible faces
+        for (auto mi = 0; mi < materialCount; ++mi)
+            for (auto pdir = 0; pdir < 6; ++pdir)
+            {
+                auto mat = materials[mi];
+                auto faces = faceCount[streamIdx(mat, pdir)];
+                if (faces == 0) // no visible faces
+                    continue;
 
-        if (dataPerMesh[pdir].empty()) // no visible faces
-            continue;
+                streamOf[streamIdx(mat, pdir)] = (int)newMeshes.size();
+                newMeshes.emplace_back();
+                auto &mesh = newMeshes.back();
 
-        // move new vertex data
-        mesh.vertexData = std::move(dataPerMesh[pdir]);
-        mesh.vertexPositions = std::move(positionsPerMesh[pdir]);
+                mesh.mat = mat;
+                mesh.dir = faceDirs[pdir].n;
+                mesh.section = section;
+
+                // upper bound (greedy meshing produces fewer quads)
+                mesh.vertices.reserve(faces * 4);
+            }
 
-        // update AABB
-        for (auto const &pos : mesh.vertexPositions)
+        if (mode == MeshingMode::Naive)
         {
-            mesh.aabbMin = tg::min(pos, mesh.aabbMin);
-            mesh.aabbMax = tg::max(pos, mesh.aabbMax);
+            // single sweep, one quad per visible face
+            for (auto z = 1; z <= CHUNK_SIZE; ++z)
+                for (auto y = yBegin; y <= yEnd; ++y)
+                    for (auto x = 1; x <= CHUNK_SIZE; ++x)
+                    {
+                        tg::ipos3 p = {x, y, z}; // local position
+                        auto blk = block(p);
+                        if (blk.isAir())
+                            continue;
+
+                        for (auto pdir = 0; pdir < 6; ++pdir)
+                        {
+                            auto const &fd = faceDirs[pdir];
+                            auto np = p + fd.n;
+                            if (hasFace(blk.mat, block(np)))
+                                addQuad(p, blk.mat, pdir, faceFlags(blocks, np, fd.n, fd.t, fd.b), 1, 1);
+                        }
+                    }
         }
+        else
+        {
+            // greedy meshing: slice by slice along the normal,
+            // merge faces with identical material into rectangles (first along T, then along B)
+            // as long as quadFaceFlags reproduces the flags of every face from the flags of the rectangle
+            // (faces of a slice are bit rows along T, bit i is the face at origin + i * T + j * B)
+            auto const &flagTable = FaceFlagTable::instance();
+            uint32_t rows[CHUNK_SIZE];
+            int keys[CHUNK_SIZE * CHUNK_SIZE]; // material and flags, only valid for set bits
+            for (auto pdir = 0; pdir < 6; ++pdir)
+            {
+                auto const &fd = faceDirs[pdir];
+                auto dir = pdir % 3;
+                auto sign = pdir < 3 ? -1 : 1;
+                auto negT = pdir >= 3; // T points along the negative axis
+                auto r = rangeOf(dir);
 
-        // add to result
-        newMeshes.push_back(mesh);
-    }
-}
-} // namespace
+                tg::ipos3 origin;
+                for (auto k = 0; k < 3; ++k)
+                    origin[k] = fd.t[k] < 0 || fd.b[k] < 0 ? CHUNK_SIZE : 1;
 
-std::vector<TerrainMeshData> generateMesh(const std::vector<Block> &blocks, tg::ipos3 chunkPos)
-{
-    GLOW_ACTION("[WORKER] - create mesh"); // time this method (shown on shutdown)
+                for (auto slice = r.sliceBegin; slice <= r.sliceEnd; ++slice)
+                {
+                    origin[dir] = slice;
 
-    std::vector<int> built;                 // track already built materials
-    std::vector<TerrainMeshData> newMeshes; // build new mesh list
+                    auto sliceRows = rowMask[pdir][slice - 1] & r.vBits;
+                    if (sliceRows == 0)
+                        continue; // no faces
 
-    auto block = [&blocks](int x, int y, int z) { return blocks[(z * EXT_SIZE + y) * EXT_SIZE + x]; };
+                    // material and flags of all faces of this slice
+                    // (B is along the positive axis, so row j is v - 1)
+                    std::fill(std::begin(rows), std::end(rows), 0);
+                    for (auto m = sliceRows; m; m &= m - 1)
+                    {
+                        auto j = countTrailingZeros(m);
+                        auto v = j + 1;
+                        for (auto vis = visibleRows[pdir][slice - 1][j] & r.tBits; vis; vis &= vis - 1)
+                        {
+                            auto u = countTrailingZeros(vis);
+                            auto i = negT ? CHUNK_SIZE - u : u - 1;
+                            auto mat = blockAt(dir, slice, u, v).mat;
+                            auto flags = flagTable.flags[negT][occ.flagIndex(dir, slice, slice + sign, u, v)];
+                            keys[j * CHUNK_SIZE + i] = (mat + 128) * faceFlagCount + flags;
+                            rows[j] |= uint32_t(1) << i;
+                        }
+                    }
 
-    auto hasMat = [&built](int mat) {
-        for (auto m : built)
-            if (m == mat)
-                return true;
-        return false;
-    };
+                    for (auto m = sliceRows; m; m &= m - 1)
+                    {
+                        auto j = countTrailingZeros(m);
+                        while (rows[j])
+                        {
+                            auto i = countTrailingZeros(rows[j]);
+                            auto matKey = keys[j * CHUNK_SIZE + i] / faceFlagCount;
+                            auto flagsAt = [&](int x, int y) { return keys[y * CHUNK_SIZE + x] % faceFlagCount; };
+
+                            // true iff the faces x0..x1, y0..y1 of the quad w x h at (i, j) with the flags q have
+                            // the flags derived from their position (only faces whose role changed are checked)
+                            auto fits = [&](int q, int w, int h, int x0, int x1, int y0, int y1) {
+                                for (auto y = y0; y <= y1; ++y)
+                                    for (auto x = x0; x <= x1; ++x)
+                                        if (flagsAt(x, y) != quadFaceFlags(q, x - i, y - j, w, h))
+                                            return false;
+                                return true;
+                            };
+
+                            // extend along T
+                            // (the new face is the +T side, the previous one becomes interior along T)
+                            auto w = 1;
+                            auto row = rows[j];
+                            while (i + w < CHUNK_SIZE && (row >> (i + w) & 1)
+                                   && keys[j * CHUNK_SIZE + i + w] / faceFlagCount == matKey)
+                            {
+                                auto f0 = flagsAt(i, j);
+                                auto f1 = flagsAt(i + w, j);
+                                if (!fits(quadFlagsOf(f0, f0, f1, f1), w + 1, 1, i + w - 1, i + w, j, j))
+                                    break;
+                                ++w;
+                            }
+                            auto span = uint32_t(((uint64_t(1) << w) - 1) << i);
+
+                            // extend along B (whole rows only, rows outside the section are empty)
+                            // (the new row is the +B side, the previous one becomes interior along B)
+                            auto h = 1;
+                            for (; j + h < CHUNK_SIZE; ++h)
+                            {
+                                auto rowMatches = (rows[j + h] & span) == span;
+                                for (auto k = 0; k < w && rowMatches; ++k)
+                                    rowMatches = keys[(j + h) * CHUNK_SIZE + i + k] / faceFlagCount == matKey;
+                                if (!rowMatches)
+                                    break;
+
+                                auto q = quadFlagsOf(flagsAt(i, j), flagsAt(i, j + h), flagsAt(i + w - 1, j),
+                                                     flagsAt(i + w - 1, j + h));
+                                if (!fits(q, w, h + 1, i, i + w - 1, j + h - 1, j + h))
+                                    break;
+                            }
+
+                            // consume faces
+                            for (auto dj = 0; dj < h; ++dj)
+                                rows[j + dj] &= ~span;
+
+                            auto q = quadFlagsOf(flagsAt(i, j), flagsAt(i, j + h - 1), flagsAt(i + w - 1, j),
+                                                 flagsAt(i + w - 1, j + h - 1));
+                            addQuad(origin + i * fd.t + j * fd.b, matKey - 128, pdir, q, w, h);
+                        }
+                    }
+                }
+            }
+        }
 
-    // ensure that each material is accounted for
-    for (auto z = 1; z <= CHUNK_SIZE; ++z)
-        for (auto y = 1; y <= CHUNK_SIZE; ++y)
-            for (auto x = 1; x <= CHUNK_SIZE; ++x)
+        // reset the used entries for the next section
+        for (auto mi = 0; mi < materialCount; ++mi)
+            for (auto pdir = 0; pdir < 6; ++pdir)
             {
-                auto const &b = block(x, y, z); // get block
+                faceCount[streamIdx(materials[mi], pdir)] = 0;
+                streamOf[streamIdx(materials[mi], pdir)] = -1;
+            }
+    }
 
-                // if block material is not air and not already built
-                if (!b.isAir() && !hasMat(b.mat))
-                {
-                    // mark as built
-                    built.push_back(b.mat);
+    // compute AABBs
+    for (auto &mesh : newMeshes)
+    {
+        auto amin = tg::ipos3(CHUNK_SIZE + 1);
+        auto amax = tg::ipos3(0);
 
-                    // create VAO(s)
-                    buildMeshFor(blocks, chunkPos, b.mat, newMeshes);
-                }
-            }
+        for (auto const &v : mesh.vertices)
+        {
+            auto pos = TerrainVertex::unpackPosition(v.position);
+            amin = tg::min(pos, amin);
+            amax = tg::max(pos, amax);
+        }
+
+        mesh.aabbMin = tg::pos3(chunkPos + tg::ivec3(amin));
+        mesh.aabbMax = tg::pos3(chunkPos + tg::ivec3(amax));
+    }
 
     return newMeshes;
 }
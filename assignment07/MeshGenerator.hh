@@ -4,8 +4,30 @@
 
 #include "TerrainMesh.hh"
 #include "Block.hh"
+#include "helper/MemoryPool.hh"
 #include <typed-geometry/tg-lean.hh>
 
+enum class MeshingMode
+{
+    /// one quad per visible block face
+    /// (block by block, the reference for the greedy mesher)
+    Naive,
+    /// coplanar adjacent faces with identical material and direction are merged into larger quads
+    /// if the AO and edges of every face follow from those of the quad (see quadFaceFlags)
+    /// (face visibility and flags are computed on bit rows of the neighborhood)
+    Greedy
+};
+
+/// AO and edge flags of the face (i, j) of a quad of sizeT x sizeB faces with the given flags
+/// (faces inside the quad are flat, faces on a side of the quad take its edge and are occluded along it if it is a wall)
+/// the terrain shaders do the same per fragment (see faceFlags in shader/terrain/material.glsl)
+int quadFaceFlags(int quadFlags, int i, int j, int sizeT, int sizeB);
+
 /// Generates mesh data for a given array of blocks
 /// Blocks contain 1 neighborhood
-std::vector<TerrainMeshData> generateMesh(std::vector<Block> const& blocks, tg::ipos3 chunkPos);
+/// Only the sections in the bit mask are meshed (bit s covers the block rows s * CHUNK_SECTION_HEIGHT ..),
+/// every mesh belongs to exactly one section
+PooledVector<TerrainMeshData> generateMesh(PooledVector<Block> const& blocks,
+                                           tg::ipos3 chunkPos,
+                                           MeshingMode mode = MeshingMode::Greedy,
+                                           int sections = CHUNK_ALL_SECTIONS);
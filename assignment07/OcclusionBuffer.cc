@@ -0,0 +1,377 @@
+#include "OcclusionBuffer.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#ifdef _MSC_VER
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+#include <glow/common/log.hh>
+#include <glow/common/profiling.hh>
+
+namespace
+{
+/// scalar fallback of the vector interface (see OcclusionRasterKernels.hh)
+struct Scalar
+{
+    using F = float;
+    using M = bool;
+    static constexpr int width = 1;
+
+    static F load(const float* p) { return *p; }
+    static void store(float* p, F v) { *p = v; }
+    static F set1(float f) { return f; }
+    static F ramp() { return 0; }
+
+    static F add(F a, F b) { return a + b; }
+    static F mul(F a, F b) { return a * b; }
+    static F min(F a, F b) { return a < b ? a : b; }
+
+    static M inside(F e0, F e1, F e2) { return e0 >= 0 && e1 >= 0 && e2 >= 0; }
+    static F select(M m, F a, F b) { return m ? a : b; }
+};
+} // namespace
+
+#include "OcclusionRasterKernels.hh"
+
+void occlusion_raster::rasterizeTile_scalar(
+    OcclusionTriangle const* tris, int const* indices, int count, OcclusionTile tile, float* depth, int stride)
+{
+    rasterizeTileKernel<Scalar>(tris, indices, count, tile, depth, stride);
+}
+
+namespace
+{
+using RasterizeTileF = void (*)(OcclusionTriangle const*, int const*, int, OcclusionTile, float*, int);
+
+RasterizeTileF detectRasterizer()
+{
+#if !defined(OCCLUSION_RASTER_SIMD)
+    return occlusion_raster::rasterizeTile_scalar;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool avx = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    return avx ? occlusion_raster::rasterizeTile_avx : occlusion_raster::rasterizeTile_sse2;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+        return occlusion_raster::rasterizeTile_avx;
+    return occlusion_raster::rasterizeTile_sse2;
+#endif
+}
+
+RasterizeTileF rasterizer()
+{
+    static const RasterizeTileF f = detectRasterizer();
+    return f;
+}
+
+/// snaps a screen coordinate to 1/16 pixel (shared edges of adjacent faces stay exact)
+float snap(float v) { return std::round(v * 16.0f) / 16.0f; }
+
+/// screen coordinates beyond this distance to the buffer are not representable precisely enough
+constexpr float guardBand = 2048.0f;
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer(int threads, int width)
+{
+    mWidth = (width + tileWidth - 1) / tileWidth * tileWidth;
+
+    for (auto i = 0; i < threads; ++i)
+        mThreads.emplace_back([this] { run(); });
+}
+
+OcclusionBuffer::~OcclusionBuffer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mShouldStop = true;
+    }
+    mCondStart.notify_all();
+    for (auto& t : mThreads)
+        t.join();
+}
+
+void OcclusionBuffer::begin(tg::mat4 const& viewProj, tg::pos3 camPos, tg::isize2 viewportSize)
+{
+    mViewProj = viewProj;
+    mCamPos = camPos;
+    mIsActive = false; // until finish
+
+    // height follows the aspect ratio
+    auto aspect = viewportSize.height / float(tg::max(1, viewportSize.width));
+    auto height = tg::clamp(int(std::ceil(mWidth * aspect)), 1, 4 * mWidth);
+    if (height != mHeight || mLevels.empty())
+    {
+        mHeight = height;
+
+        // pyramid down to a single texel
+        mLevels.clear();
+        auto w = mWidth;
+        auto h = mHeight;
+        while (true)
+        {
+            Level l;
+            l.width = w;
+            l.height = h;
+            l.stride = mLevels.empty() ? mWidth : w;
+            l.depth.resize(l.stride * h);
+            mLevels.push_back(std::move(l));
+
+            if (w == 1 && h == 1)
+                break;
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+        }
+
+        // tiles
+        mTiles.clear();
+        for (auto y = 0; y < mHeight; y += tileHeight)
+            for (auto x = 0; x < mWidth; x += tileWidth)
+                mTiles.push_back({x, y, x + tileWidth, tg::min(y + tileHeight, mHeight)});
+        mBins.resize(mTiles.size());
+    }
+
+    mTriangles.clear();
+    for (auto& bin : mBins)
+        bin.clear();
+    mStats = {};
+}
+
+void OcclusionBuffer::addOccluder(tg::pos3 amin, tg::pos3 amax)
+{
+    // project all corners (corner i has bit 0/1/2 set for max x/y/z)
+    tg::pos2 screen[8];
+    auto farthest = 0.0f;
+    auto smin = tg::pos2(std::numeric_limits<float>::max());
+    auto smax = tg::pos2(std::numeric_limits<float>::lowest());
+    for (auto i = 0; i < 8; ++i)
+    {
+        auto p = tg::pos3(i & 1 ? amax.x : amin.x, i & 2 ? amax.y : amin.y, i & 4 ? amax.z : amin.z);
+        auto clip = mViewProj * tg::vec4(p, 1.0f);
+        if (clip.w < nearDistance)
+            return; // crosses the camera plane
+
+        auto s = tg::pos2((clip.x / clip.w * 0.5f + 0.5f) * mWidth, (clip.y / clip.w * 0.5f + 0.5f) * mHeight);
+        screen[i] = tg::pos2(snap(s.x), snap(s.y));
+        smin = tg::min(smin, screen[i]);
+        smax = tg::max(smax, screen[i]);
+        farthest = tg::max(farthest, clip.w);
+    }
+
+    // off-screen, smaller than a pixel, or too large
+    if (smax.x < 0 || smax.y < 0 || smin.x > mWidth || smin.y > mHeight)
+        return;
+    if (smax.x - smin.x < 1 || smax.y - smin.y < 1)
+        return;
+    if (smin.x < -guardBand || smin.y < -guardBand || smax.x > mWidth + guardBand || smax.y > mHeight + guardBand)
+        return;
+
+    auto addTriangle = [&](tg::pos2 p0, tg::pos2 p1, tg::pos2 p2) {
+        // counter-clockwise
+        auto area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+        if (area == 0)
+            return;
+        if (area < 0)
+            std::swap(p1, p2);
+
+        OcclusionTriangle t;
+        tg::pos2 v[3] = {p0, p1, p2};
+        for (auto i = 0; i < 3; ++i)
+        {
+            auto const& a = v[i];
+            auto const& b = v[(i + 1) % 3];
+            auto dx = b.x - a.x;
+            auto dy = b.y - a.y;
+
+            // e(p) = dx * (p.y - a.y) - dy * (p.x - a.x) at the pixel center p = (x + 0.5, y + 0.5)
+            t.a[i] = -dy;
+            t.b[i] = dx;
+            t.c[i] = dy * a.x - dx * a.y + 0.5f * (dx - dy);
+
+            // top-left rule: pixel centers on shared edges are covered exactly once
+            // (edge values are multiples of 1 / 256 for snapped vertices)
+            auto topLeft = dy < 0 || (dy == 0 && dx < 0);
+            if (!topLeft)
+                t.c[i] -= 1.0f / 512;
+        }
+
+        t.depth = farthest;
+        t.minX = tg::max(0, int(std::floor(tg::min(p0.x, p1.x, p2.x))));
+        t.minY = tg::max(0, int(std::floor(tg::min(p0.y, p1.y, p2.y))));
+        t.maxX = tg::min(mWidth - 1, int(std::ceil(tg::max(p0.x, p1.x, p2.x))));
+        t.maxY = tg::min(mHeight - 1, int(std::ceil(tg::max(p0.y, p1.y, p2.y))));
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            return;
+
+        // bin into tiles
+        auto idx = (int)mTriangles.size();
+        mTriangles.push_back(t);
+        auto tilesX = mWidth / tileWidth;
+        for (auto ty = t.minY / tileHeight; ty <= t.maxY / tileHeight; ++ty)
+            for (auto tx = t.minX / tileWidth; tx <= t.maxX / tileWidth; ++tx)
+                mBins[ty * tilesX + tx].push_back(idx);
+    };
+
+    // front faces only (the camera is on their outer side)
+    for (auto axis = 0; axis < 3; ++axis)
+    {
+        auto u = 1 << (axis + 1) % 3;
+        auto v = 1 << (axis + 2) % 3;
+        for (auto side = 0; side < 2; ++side)
+        {
+            if (side == 0 ? mCamPos[axis] >= amin[axis] : mCamPos[axis] <= amax[axis])
+                continue;
+
+            auto base = side << axis;
+            addTriangle(screen[base], screen[base | u], screen[base | u | v]);
+            addTriangle(screen[base], screen[base | u | v], screen[base | v]);
+        }
+    }
+
+    ++mStats.occluders;
+}
+
+void OcclusionBuffer::finish()
+{
+    GLOW_ACTION();
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    // clear
+    auto& level0 = mLevels[0];
+    std::fill(level0.depth.begin(), level0.depth.end(), std::numeric_limits<float>::infinity());
+
+    // rasterize tiles on all threads
+    mNextTile = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ++mFrame;
+        mBusyThreads = (int)mThreads.size();
+    }
+    mCondStart.notify_all();
+
+    rasterizeTiles();
+
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondDone.wait(lock, [&] { return mBusyThreads == 0; });
+    }
+
+    buildPyramid();
+
+    mStats.triangles = (int)mTriangles.size();
+    mStats.rasterMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    mIsActive = true;
+}
+
+void OcclusionBuffer::rasterizeTiles()
+{
+    auto rasterize = rasterizer();
+    auto& level0 = mLevels[0];
+    for (auto i = mNextTile++; i < (int)mTiles.size(); i = mNextTile++)
+    {
+        auto const& bin = mBins[i];
+        if (!bin.empty())
+            rasterize(mTriangles.data(), bin.data(), (int)bin.size(), mTiles[i], level0.depth.data(), level0.stride);
+    }
+}
+
+void OcclusionBuffer::buildPyramid()
+{
+    // farthest depth of the (up to) four finer texels
+    for (auto l = 1u; l < mLevels.size(); ++l)
+    {
+        auto const& src = mLevels[l - 1];
+        auto& dst = mLevels[l];
+        for (auto y = 0; y < dst.height; ++y)
+            for (auto x = 0; x < dst.width; ++x)
+            {
+                auto x0 = 2 * x;
+                auto y0 = 2 * y;
+                auto x1 = tg::min(x0 + 1, src.width - 1);
+                auto y1 = tg::min(y0 + 1, src.height - 1);
+                dst.depth[y * dst.stride + x] = tg::max(tg::max(src.depth[y0 * src.stride + x0], src.depth[y0 * src.stride + x1]),
+                                                        tg::max(src.depth[y1 * src.stride + x0], src.depth[y1 * src.stride + x1]));
+            }
+    }
+}
+
+bool OcclusionBuffer::isAabbVisible(tg::pos3 amin, tg::pos3 amax) const
+{
+    if (!mIsActive)
+        return true;
+
+    // screen rectangle and nearest depth
+    auto nearest = std::numeric_limits<float>::max();
+    auto smin = tg::pos2(std::numeric_limits<float>::max());
+    auto smax = tg::pos2(std::numeric_limits<float>::lowest());
+    for (auto i = 0; i < 8; ++i)
+    {
+        auto p = tg::pos3(i & 1 ? amax.x : amin.x, i & 2 ? amax.y : amin.y, i & 4 ? amax.z : amin.z);
+        auto clip = mViewProj * tg::vec4(p, 1.0f);
+        if (clip.w < nearDistance)
+            return true; // crosses the camera plane
+
+        auto s = tg::pos2((clip.x / clip.w * 0.5f + 0.5f) * mWidth, (clip.y / clip.w * 0.5f + 0.5f) * mHeight);
+        smin = tg::min(smin, s);
+        smax = tg::max(smax, s);
+        nearest = tg::min(nearest, clip.w);
+    }
+
+    // pixels touched by the rectangle, grown by one pixel
+    // (occluders cover pixels by their centers, so their silhouettes are up to half a pixel too large)
+    auto x0 = tg::max(0, int(std::floor(smin.x)) - 1);
+    auto y0 = tg::max(0, int(std::floor(smin.y)) - 1);
+    auto x1 = tg::min(mWidth - 1, int(std::floor(smax.x)) + 1);
+    auto y1 = tg::min(mHeight - 1, int(std::floor(smax.y)) + 1);
+    if (x0 > x1 || y0 > y1)
+        return true; // off-screen (left to the frustum culling)
+
+    // coarsest level where the rectangle spans at most 4 x 4 texels
+    auto level = 0u;
+    while (level + 1 < mLevels.size() && (x1 - x0 >= 4 || y1 - y0 >= 4))
+    {
+        ++level;
+        x0 >>= 1;
+        y0 >>= 1;
+        x1 >>= 1;
+        y1 >>= 1;
+    }
+
+    auto const& l = mLevels[level];
+    for (auto y = y0; y <= y1; ++y)
+        for (auto x = x0; x <= x1; ++x)
+            if (l.depth[y * l.stride + x] >= nearest)
+                return true; // not behind the farthest occluder of this texel
+
+    return false;
+}
+
+void OcclusionBuffer::run()
+{
+    auto frame = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondStart.wait(lock, [&] { return mShouldStop || mFrame != frame; });
+            if (mShouldStop)
+                return;
+            frame = mFrame;
+        }
+
+        rasterizeTiles();
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            --mBusyThreads;
+        }
+        mCondDone.notify_one();
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <typed-geometry/tg.hh>
+
+#include "OcclusionRaster.hh"
+
+/**
+ * @brief Software occlusion culling with a coarse depth buffer on the CPU
+ *
+ * Every frame (see begin/finish):
+ *  - occluders (solid boxes, see ChunkVisibility.hh) are projected with the camera,
+ *    their front faces become triangles with the farthest depth of the box (conservative)
+ *  - triangles are binned into screen tiles that are rasterized in parallel (SIMD, see OcclusionRaster.hh)
+ *  - a hierarchical-Z pyramid stores the farthest occluder depth per texel for each level
+ *
+ * isAabbVisible then compares the nearest depth of a box against the farthest occluder depth
+ * of the pyramid texels covering its screen rectangle (grown by one pixel for the pixel center sampling).
+ * Depths are view space distances (clip w), uncovered pixels are infinitely far away.
+ *
+ * Render thread only (the helper threads are only active within finish).
+ */
+class OcclusionBuffer
+{
+public:
+    /// pixel size of a tile (width is a multiple of every SIMD width)
+    static constexpr int tileWidth = 64;
+    static constexpr int tileHeight = 32;
+
+    /// boxes closer than this to the camera plane are never occluders (and always visible)
+    static constexpr float nearDistance = 0.5f;
+
+    struct Stats
+    {
+        int occluders = 0; ///< boxes that were rasterized
+        int triangles = 0;
+        float rasterMs = 0; ///< binning, rasterization, and the pyramid
+    };
+
+private:
+    // buffer
+    int mWidth = 0;
+    int mHeight = 0;
+    tg::mat4 mViewProj;
+    tg::pos3 mCamPos;
+    bool mIsActive = false;
+
+    /// pyramid levels, level 0 is the depth buffer (row-major, width rounded up to tileWidth)
+    struct Level
+    {
+        int width = 0;
+        int height = 0;
+        int stride = 0;
+        std::vector<float> depth;
+    };
+    std::vector<Level> mLevels;
+
+    // occluders of the current frame
+    std::vector<OcclusionTriangle> mTriangles;
+    std::vector<std::vector<int>> mBins; ///< triangle indices per tile
+    std::vector<OcclusionTile> mTiles;
+    Stats mStats;
+
+    // helper threads
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mCondStart;
+    std::condition_variable mCondDone;
+    int mFrame = 0;      ///< incremented for every finish (guarded by mMutex)
+    int mBusyThreads = 0; ///< helper threads still rasterizing (guarded by mMutex)
+    bool mShouldStop = false;
+    std::atomic<int> mNextTile = {0};
+
+public:
+    /// threads: helper threads for the rasterization (in addition to the render thread)
+    /// width: horizontal resolution of the depth buffer (the height follows the aspect ratio of the viewport)
+    explicit OcclusionBuffer(int threads = 2, int width = 256);
+    ~OcclusionBuffer();
+
+    OcclusionBuffer(OcclusionBuffer const&) = delete;
+    OcclusionBuffer& operator=(OcclusionBuffer const&) = delete;
+
+    /// clears the buffer for a new frame
+    void begin(tg::mat4 const& viewProj, tg::pos3 camPos, tg::isize2 viewportSize);
+    /// adds a world space box of solid blocks
+    void addOccluder(tg::pos3 amin, tg::pos3 amax);
+    /// rasterizes all occluders and builds the pyramid
+    void finish();
+    /// disables the culling (every box is visible until the next begin)
+    void clear() { mIsActive = false; }
+
+    /// false iff the box is completely hidden behind occluders
+    bool isAabbVisible(tg::pos3 amin, tg::pos3 amax) const;
+
+    /// statistics of the last finish
+    Stats const& getStats() const { return mStats; }
+
+private:
+    /// rasterizes tiles until none are left (render thread and helper threads)
+    void rasterizeTiles();
+    /// builds the pyramid levels from the depth buffer
+    void buildPyramid();
+
+    /// helper thread execution
+    void run();
+};
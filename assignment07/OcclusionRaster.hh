@@ -0,0 +1,40 @@
+#pragma once
+
+// Internal interface between OcclusionBuffer and its SIMD tile rasterizers (OcclusionRaster*.cc)
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define OCCLUSION_RASTER_SIMD 1
+#endif
+
+/// triangle with a constant depth, set up for rasterization
+struct OcclusionTriangle
+{
+    /// edge functions e_i(x, y) = a[i] * x + b[i] * y + c[i] of the pixel (x, y) (evaluated at its center)
+    /// a pixel is covered iff all three are >= 0
+    float a[3];
+    float b[3];
+    float c[3];
+
+    /// depth of the whole triangle (the farthest depth of its occluder)
+    float depth;
+
+    /// pixel bounds (inclusive, within the buffer)
+    int minX, minY, maxX, maxY;
+};
+
+/// pixel range of a tile (max is exclusive, x range is a multiple of 8)
+struct OcclusionTile
+{
+    int minX, minY, maxX, maxY;
+};
+
+namespace occlusion_raster
+{
+/// rasterizes the given triangles into the depth buffer, only pixels of the tile are written
+/// (the depth of a covered pixel becomes the minimum of its old depth and the triangle's)
+void rasterizeTile_scalar(OcclusionTriangle const* tris, int const* indices, int count, OcclusionTile tile, float* depth, int stride);
+
+// CAUTION: only call these if the CPU supports the instruction set
+void rasterizeTile_sse2(OcclusionTriangle const* tris, int const* indices, int count, OcclusionTile tile, float* depth, int stride);
+void rasterizeTile_avx(OcclusionTriangle const* tris, int const* indices, int count, OcclusionTile tile, float* depth, int stride);
+} // namespace occlusion_raster
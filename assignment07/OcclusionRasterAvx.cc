@@ -0,0 +1,42 @@
+// Occlusion buffer tile rasterizer for AVX (compiled with -mavx, see CMakeLists.txt)
+
+#include "OcclusionRaster.hh"
+
+#ifdef OCCLUSION_RASTER_SIMD
+
+#include <immintrin.h>
+
+namespace
+{
+struct Avx
+{
+    using F = __m256;
+    using M = __m256;
+    static constexpr int width = 8;
+
+    static F load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, F v) { _mm256_storeu_ps(p, v); }
+    static F set1(float f) { return _mm256_set1_ps(f); }
+    static F ramp() { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+
+    static M inside(F e0, F e1, F e2)
+    {
+        return _mm256_cmp_ps(_mm256_min_ps(e0, _mm256_min_ps(e1, e2)), _mm256_setzero_ps(), _CMP_GE_OQ);
+    }
+    static F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+};
+} // namespace
+
+#include "OcclusionRasterKernels.hh"
+
+void occlusion_raster::rasterizeTile_avx(
+    OcclusionTriangle const* tris, int const* indices, int count, OcclusionTile tile, float* depth, int stride)
+{
+    rasterizeTileKernel<Avx>(tris, indices, count, tile, depth, stride);
+}
+
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+// Tile rasterizer of the occlusion buffer, written against a small vector interface V:
+//   F, M              float vector and lane mask types
+//   width             lanes per vector
+//   load, store, set1, add, mul, min
+//   ramp              0, 1, .., width - 1
+//   inside            mask of the lanes where all three edge values are >= 0
+//   select            per lane: mask ? a : b
+//
+// Included by exactly one translation unit per instruction set (compiled with the matching flags).
+// Everything lives in an anonymous namespace so that instantiations for different instruction sets never merge.
+
+#include <algorithm>
+
+#include "OcclusionRaster.hh"
+
+namespace
+{
+template <class V>
+void rasterizeTileKernel(OcclusionTriangle const* tris, int const* indices, int count, OcclusionTile tile, float* depth, int stride)
+{
+    using F = typename V::F;
+
+    auto const lanes = V::ramp();
+    for (auto k = 0; k < count; ++k)
+    {
+        auto const& t = tris[indices[k]];
+
+        // bounds within the tile, x aligned to the vector width
+        auto x0 = std::max(t.minX, tile.minX) / V::width * V::width;
+        auto x1 = std::min(t.maxX, tile.maxX - 1);
+        auto y0 = std::max(t.minY, tile.minY);
+        auto y1 = std::min(t.maxY, tile.maxY - 1);
+        if (x0 > x1 || y0 > y1)
+            continue;
+
+        auto const d = V::set1(t.depth);
+
+        // edge values of the first pixels in the row, steps in x and y
+        F row[3], stepX[3], stepY[3];
+        for (auto i = 0; i < 3; ++i)
+        {
+            auto xs = V::add(V::set1(float(x0)), lanes);
+            row[i] = V::add(V::mul(V::set1(t.a[i]), xs), V::set1(t.b[i] * y0 + t.c[i]));
+            stepX[i] = V::set1(t.a[i] * V::width);
+            stepY[i] = V::set1(t.b[i]);
+        }
+
+        for (auto y = y0; y <= y1; ++y)
+        {
+            auto e0 = row[0];
+            auto e1 = row[1];
+            auto e2 = row[2];
+            auto line = depth + y * stride;
+            for (auto x = x0; x <= x1; x += V::width)
+            {
+                auto old = V::load(line + x);
+                V::store(line + x, V::select(V::inside(e0, e1, e2), V::min(old, d), old));
+
+                e0 = V::add(e0, stepX[0]);
+                e1 = V::add(e1, stepX[1]);
+                e2 = V::add(e2, stepX[2]);
+            }
+
+            for (auto i = 0; i < 3; ++i)
+                row[i] = V::add(row[i], stepY[i]);
+        }
+    }
+}
+} // namespace
@@ -0,0 +1,39 @@
+// Occlusion buffer tile rasterizer for SSE2 (part of every x86-64 CPU, no extra flags)
+
+#include "OcclusionRaster.hh"
+
+#ifdef OCCLUSION_RASTER_SIMD
+
+#include <emmintrin.h>
+
+namespace
+{
+struct Sse2
+{
+    using F = __m128;
+    using M = __m128;
+    static constexpr int width = 4;
+
+    static F load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, F v) { _mm_storeu_ps(p, v); }
+    static F set1(float f) { return _mm_set1_ps(f); }
+    static F ramp() { return _mm_setr_ps(0, 1, 2, 3); }
+
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+
+    static M inside(F e0, F e1, F e2) { return _mm_cmpge_ps(_mm_min_ps(e0, _mm_min_ps(e1, e2)), _mm_setzero_ps()); }
+    static F select(M m, F a, F b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+} // namespace
+
+#include "OcclusionRasterKernels.hh"
+
+void occlusion_raster::rasterizeTile_sse2(
+    OcclusionTriangle const* tris, int const* indices, int count, OcclusionTile tile, float* depth, int stride)
+{
+    rasterizeTileKernel<Sse2>(tris, indices, count, tile, depth, stride);
+}
+
+#endif
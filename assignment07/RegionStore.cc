@@ -0,0 +1,495 @@
+#include "RegionStore.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <snappy/snappy.hh>
+
+#include <glow/common/log.hh>
+#include <glow/common/profiling.hh>
+
+#include "Constants.hh"
+
+namespace
+{
+constexpr char regionMagic[4] = {'R', 'T', 'G', 'R'};
+constexpr uint32_t regionVersion = 1;
+
+// header: magic, version, index
+constexpr size_t headerIndexOffset = sizeof(regionMagic) + sizeof(uint32_t);
+constexpr size_t headerSize = headerIndexOffset + RegionStore::chunksPerRegion * 2 * sizeof(uint32_t);
+
+// records are addressed by 32 bit offsets
+constexpr size_t maxFileSize = UINT32_MAX;
+
+// files are compacted when the overwritten records exceed both the live ones and this size
+constexpr size_t minCompactionBytes = 4 * 1024 * 1024;
+
+// record payload (before compression)
+enum class RecordKind : char
+{
+    Uniform = 0, // followed by a single block
+    Dense = 1    // followed by all blocks
+};
+
+int floorDiv(int a, int b) { return (a >= 0 ? a : a - b + 1) / b; }
+
+tg::ipos3 chunkIdxOf(tg::ipos3 chunkPos)
+{
+    return {floorDiv(chunkPos.x, CHUNK_SIZE), floorDiv(chunkPos.y, CHUNK_SIZE), floorDiv(chunkPos.z, CHUNK_SIZE)};
+}
+
+tg::ipos3 regionOf(tg::ipos3 chunkPos)
+{
+    auto ci = chunkIdxOf(chunkPos);
+    auto rs = RegionStore::regionSize;
+    return {floorDiv(ci.x, rs), floorDiv(ci.y, rs), floorDiv(ci.z, rs)};
+}
+
+int indexOf(tg::ipos3 chunkPos)
+{
+    auto rs = RegionStore::regionSize;
+    auto l = chunkIdxOf(chunkPos) - regionOf(chunkPos) * rs;
+    return (l.z * rs + l.y) * rs + l.x;
+}
+
+// platform file access
+#ifdef _WIN32
+int openFile(std::string const& path, bool create)
+{
+    return _open(path.c_str(), _O_RDWR | _O_BINARY | (create ? _O_CREAT : 0), _S_IREAD | _S_IWRITE);
+}
+void closeFile(int f) { _close(f); }
+size_t fileSizeOf(int f) { return (size_t)_lseeki64(f, 0, SEEK_END); }
+bool readAt(int f, size_t offset, size_t size, void* dst)
+{
+    return _lseeki64(f, offset, SEEK_SET) >= 0 && _read(f, dst, (unsigned)size) == (int)size;
+}
+bool writeAt(int f, size_t offset, size_t size, void const* src)
+{
+    return _lseeki64(f, offset, SEEK_SET) >= 0 && _write(f, src, (unsigned)size) == (int)size;
+}
+// no mapping on windows: reads fall back to readAt
+char const* mapFile(int, size_t) { return nullptr; }
+void unmapFile(char const*, size_t) {}
+#else
+int openFile(std::string const& path, bool create) { return open(path.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644); }
+void closeFile(int f) { close(f); }
+size_t fileSizeOf(int f)
+{
+    struct stat st;
+    return fstat(f, &st) == 0 ? (size_t)st.st_size : 0;
+}
+bool readAt(int f, size_t offset, size_t size, void* dst) { return pread(f, dst, size, offset) == (ssize_t)size; }
+bool writeAt(int f, size_t offset, size_t size, void const* src)
+{
+    return pwrite(f, src, size, offset) == (ssize_t)size;
+}
+char const* mapFile(int f, size_t size)
+{
+    auto m = mmap(nullptr, size, PROT_READ, MAP_SHARED, f, 0);
+    return m == MAP_FAILED ? nullptr : (char const*)m;
+}
+void unmapFile(char const* m, size_t size)
+{
+    if (m)
+        munmap((void*)m, size);
+}
+#endif
+} // namespace
+
+RegionStore::RegionStore(std::string directory) : mDirectory(std::move(directory))
+{
+    std::error_code ec;
+    std::filesystem::create_directories(mDirectory, ec);
+    if (ec)
+        glow::error() << "Could not create region directory " << mDirectory << ": " << ec.message();
+
+    mWriter = std::thread([this] { run(); });
+}
+
+RegionStore::~RegionStore()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutexWriter);
+        mShouldStop = true;
+        mCondWriter.notify_all();
+    }
+    mWriter.join();
+
+    for (auto& regionPair : mRegions)
+    {
+        auto& r = *regionPair.second;
+        unmapFile(r.map, r.mapSize);
+        if (r.file >= 0)
+            closeFile(r.file);
+    }
+}
+
+RegionStore::Region* RegionStore::queryRegion(tg::ipos3 regionPos, bool create)
+{
+    Region* r;
+    {
+        std::lock_guard<std::mutex> lock(mMutexRegions);
+        auto& region = mRegions[regionPos];
+        if (!region)
+            region.reset(new Region());
+        r = region.get();
+    }
+
+    std::lock_guard<std::mutex> lock(r->mutex);
+    if (r->file >= 0)
+        return r; // already open
+    if (r->missing && !create)
+        return nullptr; // only the writer creates files
+
+    auto const& path = r->path = mDirectory + "/r." + std::to_string(regionPos.x) + "." + std::to_string(regionPos.y)
+                                 + "." + std::to_string(regionPos.z) + ".rtg";
+
+    r->file = openFile(path, create);
+    if (r->file < 0)
+    {
+        if (create)
+            glow::error() << "Could not open region file " << path;
+        else
+            r->missing = true;
+        return nullptr; // does not exist (yet)
+    }
+
+    r->fileSize = fileSizeOf(r->file);
+    if (r->fileSize < headerSize)
+    {
+        // new file: write empty header
+        std::vector<char> header(headerSize, 0);
+        memcpy(header.data(), regionMagic, sizeof(regionMagic));
+        memcpy(header.data() + sizeof(regionMagic), &regionVersion, sizeof(regionVersion));
+        if (!writeAt(r->file, 0, header.size(), header.data()))
+            glow::error() << "Could not write region header " << path;
+        r->fileSize = headerSize;
+    }
+    else
+    {
+        // existing file: read index
+        char magic[4];
+        uint32_t version = 0;
+        readAt(r->file, 0, sizeof(magic), magic);
+        readAt(r->file, sizeof(magic), sizeof(version), &version);
+        if (memcmp(magic, regionMagic, sizeof(magic)) != 0 || version != regionVersion)
+            glow::error() << "Invalid region file " << path << " (ignored)";
+        else
+            readAt(r->file, headerIndexOffset, sizeof(r->index), r->index);
+    }
+
+    return r;
+}
+
+bool RegionStore::load(tg::ipos3 chunkPos, BlockStorage& blocks)
+{
+    GLOW_ACTION();
+
+    // queued or being written: the snapshot is newer than the file
+    {
+        std::lock_guard<std::mutex> lock(mMutexWriter);
+        auto it = mUnwritten.find(chunkPos);
+        if (it != mUnwritten.end())
+        {
+            blocks = *it->second;
+            ++mChunksLoaded;
+            return true;
+        }
+    }
+
+    auto r = queryRegion(regionOf(chunkPos), false);
+    if (!r)
+        return false;
+
+    // copy compressed record
+    std::string compressed;
+    {
+        std::lock_guard<std::mutex> lock(r->mutex);
+
+        auto entry = r->index[indexOf(chunkPos)];
+        if (entry.offset == 0)
+            return false; // not stored
+
+        auto end = size_t(entry.offset) + entry.size;
+        if (end > r->fileSize)
+            return false; // corrupt
+
+        // (re-)map if the file grew
+        if (end > r->mapSize)
+        {
+            unmapFile(r->map, r->mapSize);
+            r->map = mapFile(r->file, r->fileSize);
+            r->mapSize = r->map ? r->fileSize : 0;
+        }
+
+        if (r->map)
+            compressed.assign(r->map + entry.offset, entry.size);
+        else
+        {
+            compressed.resize(entry.size);
+            if (!readAt(r->file, entry.offset, entry.size, &compressed[0]))
+                return false;
+        }
+    }
+
+    // decompress
+    std::string data;
+    if (!snappy::Uncompress(compressed.data(), compressed.size(), &data) || data.empty())
+    {
+        glow::error() << "Corrupt chunk record at " << chunkPos;
+        return false;
+    }
+
+    switch (RecordKind(data[0]))
+    {
+    case RecordKind::Uniform:
+        if (data.size() != 1 + sizeof(Block))
+            return false;
+        blocks.fill(Block(int8_t(data[1])));
+        break;
+
+    case RecordKind::Dense:
+        if (data.size() != 1 + BlockStorage::blockCount * sizeof(Block))
+            return false;
+        blocks.assign(reinterpret_cast<Block const*>(data.data() + 1));
+        break;
+
+    default:
+        return false;
+    }
+
+    ++mChunksLoaded;
+    return true;
+}
+
+void RegionStore::save(tg::ipos3 chunkPos, BlockStorage blocks)
+{
+    auto snapshot = std::make_shared<BlockStorage const>(std::move(blocks));
+
+    std::lock_guard<std::mutex> lock(mMutexWriter);
+    mPendingSaves.push_back({chunkPos, snapshot});
+    mUnwritten[chunkPos] = std::move(snapshot);
+    mCondWriter.notify_one();
+}
+
+void RegionStore::flush()
+{
+    std::unique_lock<std::mutex> lock(mMutexWriter);
+    mCondFlushed.wait(lock, [this] { return mPendingSaves.empty() && !mIsWriting; });
+}
+
+void RegionStore::write(std::vector<SaveRequest>& batch)
+{
+    GLOW_ACTION();
+
+    // group by region (keep order within a region: later saves win)
+    std::stable_sort(batch.begin(), batch.end(), [](SaveRequest const& a, SaveRequest const& b) {
+        auto ra = regionOf(a.chunkPos);
+        auto rb = regionOf(b.chunkPos);
+        if (ra.x != rb.x)
+            return ra.x < rb.x;
+        if (ra.y != rb.y)
+            return ra.y < rb.y;
+        return ra.z < rb.z;
+    });
+
+    std::string raw;
+    std::string compressed;
+    std::string records;
+    for (size_t begin = 0; begin < batch.size();)
+    {
+        auto regionPos = regionOf(batch[begin].chunkPos);
+        auto end = begin;
+        while (end < batch.size() && regionOf(batch[end].chunkPos) == regionPos)
+            ++end;
+
+        auto r = queryRegion(regionPos, true);
+        if (!r)
+        {
+            begin = end;
+            continue;
+        }
+
+        // compress all records of this region (without holding the lock)
+        // (only the latest save of each chunk)
+        records.clear();
+        std::vector<std::pair<int, IndexEntry>> entries;
+        std::vector<bool> isSaved(chunksPerRegion, false);
+        for (auto i = end; i-- > begin;)
+        {
+            auto idx = indexOf(batch[i].chunkPos);
+            if (isSaved[idx])
+                continue;
+            isSaved[idx] = true;
+
+            auto const& blocks = *batch[i].blocks;
+            if (blocks.getKind() == BlockStorage::Kind::Uniform)
+            {
+                raw.resize(1 + sizeof(Block));
+                raw[0] = char(RecordKind::Uniform);
+                raw[1] = char(blocks.get(0).mat);
+            }
+            else
+            {
+                raw.resize(1 + BlockStorage::blockCount * sizeof(Block));
+                raw[0] = char(RecordKind::Dense);
+                blocks.copyTo(0, BlockStorage::blockCount, reinterpret_cast<Block*>(&raw[1]));
+            }
+
+            snappy::Compress(raw.data(), raw.size(), &compressed);
+
+            IndexEntry e;
+            e.offset = uint32_t(records.size()); // relative for now
+            e.size = uint32_t(compressed.size());
+            entries.push_back({idx, e});
+            records += compressed;
+        }
+
+        // append records and update index (single write each)
+        {
+            std::lock_guard<std::mutex> lock(r->mutex);
+
+            // drop overwritten records if they dominate the file or the new ones would not be addressable
+            size_t liveBytes = 0;
+            for (auto const& e : r->index)
+                liveBytes += e.size;
+            auto usedBytes = headerSize + liveBytes;
+            auto deadBytes = r->fileSize > usedBytes ? r->fileSize - usedBytes : 0;
+            if ((deadBytes > liveBytes && deadBytes > minCompactionBytes)
+                || (deadBytes > 0 && r->fileSize + records.size() > maxFileSize))
+                compact(*r);
+
+            auto base = r->fileSize;
+            if (base + records.size() > maxFileSize)
+            {
+                glow::error() << "Region " << regionPos << " exceeds 4 GB, " << entries.size() << " chunks not saved";
+                begin = end;
+                continue;
+            }
+
+            if (!writeAt(r->file, base, records.size(), records.data()))
+            {
+                glow::error() << "Could not write region " << regionPos;
+                begin = end;
+                continue;
+            }
+            r->fileSize += records.size();
+
+            for (auto& e : entries)
+            {
+                e.second.offset += uint32_t(base);
+                r->index[e.first] = e.second;
+            }
+            writeAt(r->file, headerIndexOffset, sizeof(r->index), r->index);
+        }
+
+        // load reads the file from now on (unless the chunk was saved again in the meantime)
+        {
+            std::lock_guard<std::mutex> lock(mMutexWriter);
+            for (auto i = begin; i < end; ++i)
+            {
+                auto it = mUnwritten.find(batch[i].chunkPos);
+                if (it != mUnwritten.end() && it->second == batch[i].blocks)
+                    mUnwritten.erase(it);
+            }
+        }
+
+        mChunksSaved += int(entries.size());
+        begin = end;
+    }
+}
+
+bool RegionStore::compact(Region& r)
+{
+    GLOW_ACTION();
+
+    // new file content: header and all live records (in index order)
+    std::vector<char> data(headerSize, 0);
+    memcpy(data.data(), regionMagic, sizeof(regionMagic));
+    memcpy(data.data() + sizeof(regionMagic), &regionVersion, sizeof(regionVersion));
+
+    std::vector<IndexEntry> index(chunksPerRegion);
+    for (auto i = 0; i < chunksPerRegion; ++i)
+    {
+        auto e = r.index[i];
+        if (e.offset == 0)
+            continue;
+
+        index[i] = {uint32_t(data.size()), e.size};
+        data.resize(data.size() + e.size);
+        if (!readAt(r.file, e.offset, e.size, &data[index[i].offset]))
+        {
+            glow::error() << "Could not read region " << r.path << " for compaction";
+            return false;
+        }
+    }
+    memcpy(data.data() + headerIndexOffset, index.data(), sizeof(r.index));
+
+    // write a temporary file and replace the region file with it
+    std::error_code ec;
+    auto tmpPath = r.path + ".tmp";
+    std::filesystem::remove(tmpPath, ec);
+    auto f = openFile(tmpPath, true);
+    auto ok = f >= 0 && writeAt(f, 0, data.size(), data.data());
+    if (f >= 0)
+        closeFile(f);
+    if (!ok)
+    {
+        glow::error() << "Could not write " << tmpPath;
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+
+    unmapFile(r.map, r.mapSize);
+    r.map = nullptr;
+    r.mapSize = 0;
+    closeFile(r.file);
+
+    std::filesystem::rename(tmpPath, r.path, ec);
+    if (ec)
+        glow::error() << "Could not replace region file " << r.path << ": " << ec.message();
+    else
+        std::copy(index.begin(), index.end(), r.index);
+
+    r.file = openFile(r.path, false);
+    if (r.file < 0)
+        glow::error() << "Could not reopen region file " << r.path;
+    r.fileSize = r.file >= 0 ? fileSizeOf(r.file) : 0;
+
+    return !ec;
+}
+
+void RegionStore::run()
+{
+    std::vector<SaveRequest> batch;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutexWriter);
+            mIsWriting = false;
+            mCondFlushed.notify_all();
+
+            mCondWriter.wait(lock, [this] { return !mPendingSaves.empty() || mShouldStop; });
+            if (mPendingSaves.empty())
+                return; // stopped and everything written
+
+            std::swap(batch, mPendingSaves);
+            mIsWriting = true;
+        }
+
+        write(batch);
+        batch.clear();
+    }
+}
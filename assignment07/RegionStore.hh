@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <typed-geometry/tg-std.hh>
+
+#include "BlockStorage.hh"
+
+/**
+ * @brief On-disk storage of chunks in region files
+ *
+ * A region file contains up to 16 x 16 x 16 chunks:
+ *  - header: magic, version, and a fixed index with (offset, size) per chunk (offset 0 means "not stored")
+ *  - records: snappy-compressed blocks, appended to the file
+ *    (saving a chunk again appends a new record and overwrites its index entry,
+ *     the file is rewritten without the old records once they make up most of it)
+ *
+ * load() can be called from any thread (e.g. the terrain workers) and reads through a memory mapping
+ * (or returns the snapshot of a save that is not written yet).
+ * save() only queues a snapshot of the blocks;
+ * compression and file writes are done in batches (grouped by region) by a dedicated writer thread.
+ */
+class RegionStore
+{
+public:
+    /// chunks per region side
+    static constexpr int regionSize = 16;
+    static constexpr int chunksPerRegion = regionSize * regionSize * regionSize;
+
+private:
+    struct IndexEntry
+    {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+    };
+
+    struct Region
+    {
+        /// guards everything below
+        std::mutex mutex;
+
+        std::string path;
+        int file = -1;
+        bool missing = false; ///< true iff the file did not exist when last opened for reading
+        size_t fileSize = 0;
+
+        /// read-only mapping of the first mapSize bytes (re-mapped when the file grew)
+        char const* map = nullptr;
+        size_t mapSize = 0;
+
+        IndexEntry index[chunksPerRegion];
+    };
+
+    struct SaveRequest
+    {
+        tg::ipos3 chunkPos;
+        std::shared_ptr<BlockStorage const> blocks;
+    };
+
+    std::string mDirectory;
+
+    // open regions
+    std::mutex mMutexRegions;
+    std::unordered_map<tg::ipos3, std::unique_ptr<Region>> mRegions;
+
+    // writer thread
+    std::thread mWriter;
+    std::mutex mMutexWriter;
+    std::condition_variable mCondWriter;
+    std::condition_variable mCondFlushed;
+    std::vector<SaveRequest> mPendingSaves; ///< guarded by mMutexWriter
+    bool mIsWriting = false;                ///< guarded by mMutexWriter
+    bool mShouldStop = false;               ///< guarded by mMutexWriter
+
+    /// latest snapshot of every queued chunk until its index entry is written (guarded by mMutexWriter)
+    /// (load returns it instead of the older record in the file)
+    std::unordered_map<tg::ipos3, std::shared_ptr<BlockStorage const>> mUnwritten;
+
+    // stats
+    std::atomic<int> mChunksLoaded = {0};
+    std::atomic<int> mChunksSaved = {0};
+
+public:
+    /// region files are stored in the given directory (created if it does not exist)
+    explicit RegionStore(std::string directory);
+    /// writes all queued chunks
+    ~RegionStore();
+
+    RegionStore(RegionStore const&) = delete;
+    RegionStore& operator=(RegionStore const&) = delete;
+
+    /// loads a chunk (thread-safe), including chunks that are only queued for writing
+    /// returns false if the chunk is not stored
+    bool load(tg::ipos3 chunkPos, BlockStorage& blocks);
+
+    /// queues a chunk for writing (thread-safe)
+    void save(tg::ipos3 chunkPos, BlockStorage blocks);
+
+    /// blocks until all queued chunks are written
+    void flush();
+
+    int getChunksLoaded() const { return mChunksLoaded; }
+    int getChunksSaved() const { return mChunksSaved; }
+
+private:
+    /// returns the region, opens (or creates) its file
+    /// returns nullptr if the region file does not exist and create is false (or cannot be created)
+    Region* queryRegion(tg::ipos3 regionPos, bool create);
+
+    /// writes a batch of chunks
+    void write(std::vector<SaveRequest>& batch);
+
+    /// rewrites a region file with only the records in its index (r.mutex must be locked)
+    /// returns false if the file could not be replaced (it stays as it was)
+    bool compact(Region& r);
+
+    /// writer thread execution
+    void run();
+};
@@ -0,0 +1,79 @@
+#include "RenderQueue.hh"
+
+#include <cstring>
+#include <utility>
+
+#include <typed-geometry/tg.hh>
+
+void RenderQueue::add(RenderDraw const& draw, int materialId, float distance)
+{
+    TG_ASSERT((int)mDraws.size() < maxDraws && "too many draws");
+    TG_ASSERT(0 <= materialId && materialId < (1 << 12) && "material id out of range");
+
+    // (the programs of consecutive draws are usually the same)
+    if (draw.program != mLastProgram)
+    {
+        auto id = 0u;
+        while (id < mPrograms.size() && mPrograms[id] != draw.program)
+            ++id;
+        if (id == mPrograms.size())
+            mPrograms.push_back(draw.program);
+        TG_ASSERT(id < 256 && "too many programs");
+
+        mLastProgram = draw.program;
+        mLastProgramId = id;
+    }
+
+    uint32_t disBits;
+    distance = tg::max(distance, 0.0f);
+    std::memcpy(&disBits, &distance, sizeof(disBits));
+
+    auto key = mLastProgramId << 56                      //
+               | uint64_t(materialId) << 44              //
+               | uint64_t(disBits >> 7 & 0xFFFFFF) << 20 //
+               | uint64_t(mDraws.size());
+    mKeys.push_back(key);
+    mDraws.push_back(draw);
+}
+
+void RenderQueue::sort()
+{
+    auto const n = mKeys.size();
+    if (n < 2)
+        return;
+
+    // histograms of all bytes in one pass
+    // (byte 0 and 1 only contain the index, which is unique and already ascending)
+    uint32_t counts[8][256] = {};
+    for (auto k : mKeys)
+        for (auto b = 2; b < 8; ++b)
+            ++counts[b][k >> (b * 8) & 0xFF];
+
+    mKeysTmp.resize(n);
+    auto src = mKeys.data();
+    auto dst = mKeysTmp.data();
+    for (auto b = 2; b < 8; ++b)
+    {
+        auto shift = b * 8;
+        if (counts[b][src[0] >> shift & 0xFF] == n)
+            continue; // equal for all keys
+
+        // prefix sums -> first position of each digit
+        uint32_t offsets[256];
+        auto sum = 0u;
+        for (auto d = 0; d < 256; ++d)
+        {
+            offsets[d] = sum;
+            sum += counts[b][d];
+        }
+
+        // stable scatter
+        for (auto i = 0u; i < n; ++i)
+            dst[offsets[src[i] >> shift & 0xFF]++] = src[i];
+
+        std::swap(src, dst);
+    }
+
+    if (src != mKeys.data())
+        mKeys.swap(mKeysTmp);
+}
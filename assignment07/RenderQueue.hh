@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <typed-geometry/tg-lean.hh>
+
+#include <glow/fwd.hh>
+
+struct RenderMaterial;
+
+/// a draw call of the terrain
+struct RenderDraw
+{
+    glow::Program* program;
+    RenderMaterial const* mat;
+    int firstVertex; ///< in the terrain arena
+    int indexCount;
+    tg::pos3 chunkPos;
+    float voxelSize;
+};
+
+/**
+ * @brief Draw calls of a render pass, sorted by program, material, and distance (front-to-back)
+ *
+ * Every draw gets a packed 64 bit key (most significant first):
+ *  -  8 bit program (index in the programs seen by this queue)
+ *  - 12 bit material (RenderMaterial::id)
+ *  - 24 bit distance (upper bits of the float, non-negative floats sort like their bits)
+ *  - 20 bit index of the draw
+ * The keys are sorted by an LSD radix sort over their bytes (bytes that are equal for all draws are skipped).
+ *
+ * The queue is meant to be kept: clear keeps all buffers, so a steady state does not allocate.
+ */
+class RenderQueue
+{
+public:
+    static constexpr int maxDraws = 1 << 20;
+
+private:
+    std::vector<RenderDraw> mDraws;
+    std::vector<uint64_t> mKeys;
+    std::vector<uint64_t> mKeysTmp; ///< radix sort buffer
+
+    /// programs seen so far (their index is the program part of the key)
+    std::vector<glow::Program*> mPrograms;
+    glow::Program* mLastProgram = nullptr;
+    uint64_t mLastProgramId = 0;
+
+public:
+    /// removes all draws (keeps the memory)
+    void clear()
+    {
+        mDraws.clear();
+        mKeys.clear();
+    }
+
+    /// adds a draw with a material of the given id (see RenderMaterial::id)
+    void add(RenderDraw const& draw, int materialId, float distance);
+
+    /// sorts the draws
+    void sort();
+
+public: // accessor functions
+    int size() const { return (int)mKeys.size(); }
+    bool empty() const { return mKeys.empty(); }
+
+    /// i-th draw in sorted order (after sort)
+    RenderDraw const& operator[](int i) const { return mDraws[mKeys[i] & (maxDraws - 1)]; }
+};
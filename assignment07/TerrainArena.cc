@@ -0,0 +1,178 @@
+#include "TerrainArena.hh"
+
+#include <glow/callbacks.hh>
+#include <glow/objects/ArrayBuffer.hh>
+#include <glow/objects/VertexArray.hh>
+
+#include "TerrainMesh.hh"
+
+namespace
+{
+constexpr size_t bytesPerQuad = 4 * sizeof(TerrainVertex);
+}
+
+TerrainAllocation::~TerrainAllocation() { mArena->free(mHandle); }
+
+int TerrainAllocation::getFirstVertex() const { return int(mArena->getAllocator().getOffset(mHandle) * 4); }
+
+int TerrainAllocation::getQuadCapacity() const { return int(mArena->getAllocator().getSize(mHandle)); }
+
+TerrainArena::TerrainArena(int initialQuads) : mAllocator(uint32_t(initialQuads)), mThread(std::this_thread::get_id()) {}
+
+TerrainArena::~TerrainArena()
+{
+    if (mCommandBuffer)
+        glDeleteBuffers(1, &mCommandBuffer);
+}
+
+SharedTerrainAllocation TerrainArena::allocate(int quads)
+{
+    TG_ASSERT(quads > 0);
+    TG_ASSERT(std::this_thread::get_id() == mThread && "terrain arena used by another thread");
+
+    if (!mVertices)
+        resize(0);
+
+    auto handle = mAllocator.allocate(uint32_t(quads));
+    while (handle == TlsfAllocator::invalidHandle)
+    {
+        auto oldQuads = mAllocator.getCapacity();
+        mAllocator.grow(oldQuads * 2);
+        resize(oldQuads);
+        handle = mAllocator.allocate(uint32_t(quads));
+    }
+
+    return std::make_shared<TerrainAllocation>(shared_from_this(), handle);
+}
+
+void TerrainArena::free(TlsfAllocator::Handle handle)
+{
+    TG_ASSERT(std::this_thread::get_id() == mThread && "terrain mesh destroyed by another thread");
+    mAllocator.free(handle);
+}
+
+void TerrainArena::upload(TerrainAllocation const& allocation, TerrainVertex const* vertices, int quads)
+{
+    TG_ASSERT(quads <= allocation.getQuadCapacity());
+    auto offset = size_t(allocation.getFirstVertex()) * sizeof(TerrainVertex);
+    glNamedBufferSubData(mVertices->getObjectName(), GLintptr(offset), GLsizeiptr(quads * bytesPerQuad), vertices);
+}
+
+void TerrainArena::resize(uint32_t oldQuads)
+{
+    // vertices: new buffer, copy the old content
+    auto oldVertices = mVertices;
+    mVertices = glow::ArrayBuffer::create(TerrainVertex::attributes());
+    mVertices->bind().setData(mAllocator.getCapacity() * bytesPerQuad, nullptr, GL_DYNAMIC_DRAW);
+    if (oldVertices)
+    {
+        glCopyNamedBufferSubData(oldVertices->getObjectName(), mVertices->getObjectName(), 0, 0,
+                                 GLsizeiptr(oldQuads * bytesPerQuad));
+        ++mGrows;
+        glow::info() << "Terrain arena grown to " << mAllocator.getCapacity() * bytesPerQuad / (1024 * 1024) << " MB";
+    }
+
+    // per-draw data is created once (its content is replaced by every uploadDraws)
+    if (!mDrawBuffer)
+    {
+        mDrawBuffer = glow::ArrayBuffer::create({
+            {&DrawData::chunkPos, "aChunkPos"},   //
+            {&DrawData::voxelSize, "aVoxelSize"}, //
+        });
+        mDrawBuffer->setDivisor(1);
+        glCreateBuffers(1, &mCommandBuffer);
+    }
+
+    mVao = glow::VertexArray::create({mVertices, mDrawBuffer}, getTerrainQuadIndices());
+}
+
+void TerrainArena::defragment(size_t maxBytes)
+{
+    TG_ASSERT(std::this_thread::get_id() == mThread && "terrain arena used by another thread");
+
+    // only worth it if the holes are a noticeable part of the used space
+    auto holes = mAllocator.getEnd() - mAllocator.getUsedUnits();
+    if (!mVertices || holes < mAllocator.getUsedUnits() / 8)
+        return;
+
+    mMoves.clear();
+    mAllocator.defragment(uint32_t(maxBytes / bytesPerQuad), 1024, mMoves);
+
+    // (source and destination never overlap, later moves may use the space of earlier ones)
+    auto buffer = mVertices->getObjectName();
+    for (auto const& m : mMoves)
+    {
+        glCopyNamedBufferSubData(buffer, buffer, GLintptr(m.oldOffset * bytesPerQuad),
+                                 GLintptr(m.newOffset * bytesPerQuad), GLsizeiptr(m.size * bytesPerQuad));
+        mMovedBytes += m.size * bytesPerQuad;
+    }
+}
+
+void TerrainArena::clearDraws()
+{
+    mCommands.clear();
+    mDrawData.clear();
+}
+
+int TerrainArena::addDraw(int firstVertex, int indexCount, tg::pos3 chunkPos, float voxelSize)
+{
+    auto idx = int(mCommands.size());
+    mCommands.push_back({GLuint(indexCount), 1, 0, GLint(firstVertex), GLuint(idx)});
+    mDrawData.push_back({chunkPos, voxelSize});
+    return idx;
+}
+
+void TerrainArena::uploadDraws()
+{
+    if (mCommands.empty() || !mVertices)
+        return;
+
+    // (orphans the previous content, the previous pass might still read it)
+    mDrawBuffer->bind().setData(mDrawData.size() * sizeof(DrawData), mDrawData.data(), GL_STREAM_DRAW);
+    glNamedBufferData(mCommandBuffer, GLsizeiptr(mCommands.size() * sizeof(DrawCommand)), mCommands.data(), GL_STREAM_DRAW);
+}
+
+glow::BoundVertexArray TerrainArena::bind()
+{
+    if (!mVertices)
+        resize(0);
+    return mVao->bind();
+}
+
+void TerrainArena::draw(glow::BoundVertexArray& vao, int first, int count, bool multiDraw)
+{
+    TG_ASSERT(0 <= first && first + count <= (int)mCommands.size());
+    if (count <= 0)
+        return;
+
+    // (attribute locations of the current program, done by glow for its own draw calls)
+    vao.negotiateBindings();
+
+    // (the index buffer is bound by the VAO, the draws use 16 bit quad indices)
+    if (multiDraw)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)(first * sizeof(DrawCommand)), count, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else
+    {
+        for (auto i = first; i < first + count; ++i)
+        {
+            auto const& c = mCommands[i];
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, GLsizei(c.count), GL_UNSIGNED_SHORT, nullptr, 1,
+                                                          c.baseVertex, c.baseInstance);
+        }
+    }
+
+    glow::notifyShaderExecuted();
+}
+
+TerrainArena::Stats TerrainArena::getStats() const
+{
+    Stats s;
+    s.quads = mAllocator.getStats();
+    s.grows = mGrows;
+    s.movedBytes = mMovedBytes;
+    return s;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <typed-geometry/tg-lean.hh>
+
+#include <glow/common/nodiscard.hh>
+#include <glow/common/shared.hh>
+#include <glow/fwd.hh>
+#include <glow/gl.hh>
+
+#include "Vertices.hh"
+#include "helper/TlsfAllocator.hh"
+
+GLOW_SHARED(class, TerrainArena);
+GLOW_SHARED(class, TerrainAllocation);
+
+/// vertices of a terrain mesh in the arena, freed when the last mesh referencing them is destroyed
+/// (render thread only, like the GL objects the meshes owned before)
+class TerrainAllocation
+{
+    SharedTerrainArena mArena;
+    TlsfAllocator::Handle mHandle;
+
+public:
+    TerrainAllocation(SharedTerrainArena arena, TlsfAllocator::Handle handle) : mArena(std::move(arena)), mHandle(handle) {}
+    ~TerrainAllocation();
+
+    TerrainAllocation(TerrainAllocation const&) = delete;
+    TerrainAllocation& operator=(TerrainAllocation const&) = delete;
+
+public: // accessor functions
+    /// first vertex in the arena (changes when the arena is defragmented)
+    int getFirstVertex() const;
+    /// number of quads that fit into the allocation
+    int getQuadCapacity() const;
+};
+
+/**
+ * @brief All terrain vertices in one large GPU buffer, drawn with one multi-draw call per material
+ *
+ * Meshes are ranges of whole quads in a single ArrayBuffer, sub-allocated by a TlsfAllocator
+ * (the buffer doubles its size when it is full, defragment moves meshes into holes at lower offsets).
+ * A single VAO combines the vertices, the shared quad indices (see getTerrainQuadIndices), and a per-draw buffer
+ * with the chunk position and voxel size (instanced attributes aChunkPos and aVoxelSize, selected by baseInstance).
+ *
+ * Drawing: clearDraws, addDraw for every mesh, uploadDraws, then bind and draw ranges of the added draws
+ * (glMultiDrawElementsIndirect with one command per draw).
+ */
+class TerrainArena : public std::enable_shared_from_this<TerrainArena>
+{
+public:
+    /// command of glMultiDrawElementsIndirect
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    /// per-draw data (instanced attributes)
+    struct DrawData
+    {
+        tg::pos3 chunkPos;
+        float voxelSize;
+    };
+
+    struct Stats
+    {
+        TlsfAllocator::Stats quads; ///< allocator stats (in quads)
+        int grows = 0;              ///< number of buffer reallocations
+        size_t movedBytes = 0;      ///< by defragment, in total
+    };
+
+private:
+    TlsfAllocator mAllocator; ///< in quads
+    std::thread::id mThread;  ///< the render thread (that created the arena)
+
+    glow::SharedArrayBuffer mVertices;
+    glow::SharedArrayBuffer mDrawBuffer;
+    glow::SharedVertexArray mVao;
+    GLuint mCommandBuffer = 0;
+
+    std::vector<DrawCommand> mCommands;
+    std::vector<DrawData> mDrawData;
+    std::vector<TlsfAllocator::Move> mMoves;
+
+    int mGrows = 0;
+    size_t mMovedBytes = 0;
+
+public:
+    /// GL objects are created on first use
+    /// all functions must be called on the thread that created the arena
+    /// (meshes must not be destroyed elsewhere, see World::removeChunk and TerrainLod::drop)
+    explicit TerrainArena(int initialQuads);
+    ~TerrainArena();
+
+    TerrainArena(TerrainArena const&) = delete;
+    TerrainArena& operator=(TerrainArena const&) = delete;
+
+    static SharedTerrainArena create(int initialQuads = 1 << 20) { return std::make_shared<TerrainArena>(initialQuads); }
+
+    /// allocates space for the given number of quads (grows the buffer if needed)
+    SharedTerrainAllocation allocate(int quads);
+
+    /// writes the vertices (4 per quad) to the start of an allocation
+    void upload(TerrainAllocation const& allocation, TerrainVertex const* vertices, int quads);
+
+    /// moves meshes into holes at lower offsets (GPU copies of at most maxBytes)
+    /// only if a noticeable part of the free space is fragmented
+    void defragment(size_t maxBytes);
+
+    /// removes all draws
+    void clearDraws();
+    /// adds a draw of indexCount indices of the mesh starting at firstVertex, returns its index
+    int addDraw(int firstVertex, int indexCount, tg::pos3 chunkPos, float voxelSize);
+    /// uploads the commands and per-draw data of all added draws
+    void uploadDraws();
+
+    /// binds the VAO of the arena (required by draw)
+    GLOW_NODISCARD glow::BoundVertexArray bind();
+
+    /// draws the draws first .. first + count - 1 with the current program
+    /// (in one call, or one call per draw if multiDraw is false)
+    void draw(glow::BoundVertexArray& vao, int first, int count, bool multiDraw = true);
+
+    /// frees an allocation (see ~TerrainAllocation)
+    void free(TlsfAllocator::Handle handle);
+
+public: // accessor functions
+    TlsfAllocator const& getAllocator() const { return mAllocator; }
+
+    /// O(number of free blocks)
+    Stats getStats() const;
+
+private:
+    /// creates or enlarges the buffers to the capacity of the allocator
+    void resize(uint32_t oldQuads);
+};
@@ -0,0 +1,341 @@
+#include "TerrainGenerator.hh"
+
+#include <chrono>
+#include <limits>
+
+#include <glow/common/log.hh>
+#include <glow/common/profiling.hh>
+
+namespace
+{
+uint32_t wang_hash(uint32_t seed)
+{
+    seed = (seed ^ 61u) ^ (seed >> 16u);
+    seed *= 9u;
+    seed = seed ^ (seed >> 4u);
+    seed *= 0x27D4EB2Du;
+    seed = seed ^ (seed >> 15u);
+    return seed;
+}
+
+float getRandFloat01Wang(tg::ivec3 relPos)
+{
+    uint32_t seed = ((relPos.x * 123) + relPos.y) * 5 + relPos.z;
+    return float(wang_hash(seed)) / std::numeric_limits<uint32_t>::max();
+}
+
+/// adds the time since the last call to a stage (no-op without times)
+struct StageClock
+{
+    using clock = std::chrono::steady_clock;
+
+    bool enabled;
+    clock::time_point last;
+
+    explicit StageClock(bool enabled) : enabled(enabled)
+    {
+        if (enabled)
+            last = clock::now();
+    }
+
+    void lap(double& stage)
+    {
+        if (!enabled)
+            return;
+
+        auto now = clock::now();
+        stage += std::chrono::duration<double>(now - last).count();
+        last = now;
+    }
+};
+
+int blockIdx(tg::ivec3 rp) { return (rp.z * CHUNK_SIZE + rp.y) * CHUNK_SIZE + rp.x; }
+} // namespace
+
+TerrainGenerator::TerrainGenerator(int seed)
+{
+    mNoiseGen.SetSeed(seed);
+    mNoiseGen.SetNoiseType(FastNoise::SimplexFractal);
+}
+
+void TerrainGenerator::setMaterials(std::vector<Material> const& opaque, std::vector<Material> const& translucent)
+{
+    auto indexOf = [&](std::string const& name) -> int8_t {
+        for (auto const& m : opaque)
+            if (m.name == name)
+                return m.index;
+
+        for (auto const& m : translucent)
+            if (m.name == name)
+                return m.index;
+
+        glow::error() << "Material `" << name << "' not found";
+        return 0;
+    };
+
+    mMats.grass = indexOf("grass");
+    mMats.dirt = indexOf("dirt");
+    mMats.rock = indexOf("rock");
+    mMats.sand = indexOf("sand");
+    mMats.snow = indexOf("snow");
+    mMats.snowRock = indexOf("snowrock");
+
+    mMats.gold = indexOf("gold");
+    mMats.copper = indexOf("copper");
+    mMats.bronze = indexOf("bronze");
+
+    mMats.water = indexOf("water");
+    mMats.crystal = indexOf("crystal");
+    mMats.lightFountain = indexOf("lightfountain");
+}
+
+void TerrainGenerator::generate(tg::ipos3 chunkPos, TerrainColumn const& column, BlockStorage& blocks, StageTimes* times) const
+{
+    GLOW_ACTION("[WORKER] - generate chunk");
+
+    StageClock clock(times != nullptr);
+    auto const& m = mMats;
+    int8_t const matAir = 0;
+
+    // 3D noise of all blocks that may become crystals (below the surface, above y = -20, not in flat regions)
+    // or minerals (additionally below hills), evaluated in batches
+    // (the candidates of a column are a contiguous y range, their noise starts at crystalStart/oreStart)
+    auto const columnCount = CHUNK_SIZE * CHUNK_SIZE;
+    int yBegin[columnCount];
+    int crystalStart[columnCount];
+    int oreStart[columnCount];
+
+    PooledVector<FN_DECIMAL> nx, ny, nz;
+    PooledVector<FN_DECIMAL> crystalNoise, goldNoise, copperNoise;
+
+    auto gatherCandidates = [&](float minHeight, int* start, auto&& coords) {
+        nx.clear();
+        ny.clear();
+        nz.clear();
+        for (auto col = 0; col < columnCount; ++col)
+        {
+            auto d = column.height[col];
+            yBegin[col] = tg::max(0, -20 - chunkPos.y);
+            auto yEnd = tg::min(CHUNK_SIZE, int(tg::floor(d)) - chunkPos.y + 1);
+            start[col] = (int)nx.size();
+            if (!(d > minHeight))
+                continue;
+
+            for (auto y = yBegin[col]; y < yEnd; ++y)
+            {
+                auto p = tg::pos3(chunkPos + tg::ivec3(col % CHUNK_SIZE, y, col / CHUNK_SIZE));
+                auto np = coords(p);
+                nx.push_back(np[0]);
+                ny.push_back(np[1]);
+                nz.push_back(np[2]);
+            }
+        }
+    };
+    auto evalCandidates = [&](PooledVector<FN_DECIMAL>& noise) {
+        noise.resize(nx.size());
+        mNoiseGen.GetValue(nx.data(), ny.data(), nz.data(), noise.data(), (int)nx.size());
+    };
+
+    // (same arguments as the scalar calls, the batch results are identical)
+    using NoisePos = tg::array<FN_DECIMAL, 3>;
+    gatherCandidates(3, crystalStart, [](tg::pos3 p) {
+        return NoisePos{FN_DECIMAL(12.1 * p.x), FN_DECIMAL(5.1 * p.y), FN_DECIMAL(9.6 * p.z)};
+    });
+    evalCandidates(crystalNoise);
+    gatherCandidates(8, oreStart, [](tg::pos3 p) {
+        return NoisePos{FN_DECIMAL(5 + 17.3 * p.x), FN_DECIMAL(4 + 23.1 * p.y), FN_DECIMAL(-18 + 15.6 * p.z)};
+    });
+    evalCandidates(goldNoise);
+    gatherCandidates(8, oreStart, [](tg::pos3 p) {
+        return NoisePos{FN_DECIMAL(10.0 * p.z), FN_DECIMAL(9.1 * p.x), FN_DECIMAL(11.0 * p.y)};
+    });
+    evalCandidates(copperNoise);
+
+    if (times)
+        clock.lap(times->noise);
+
+    // TODO: cooler
+
+    for (auto z = 0; z < CHUNK_SIZE; ++z)
+        for (auto y = 0; y < CHUNK_SIZE; ++y)
+            for (auto x = 0; x < CHUNK_SIZE; ++x)
+            {
+                auto rp = tg::ivec3(x, y, z);
+                auto ip = chunkPos + rp;
+                auto p = tg::pos3(ip);
+
+                auto seaLevel = 0;
+
+                // terrain height
+                auto d = column.height[z * CHUNK_SIZE + x];
+
+                // choose material depending on terrain height
+                int8_t mat = matAir;
+                if (p.y <= d)
+                {
+                    if (p.y < 1)
+                        mat = m.sand;
+                    else
+                    {
+                        auto grassDist = column.grassLine[z * CHUNK_SIZE + x];
+                        if (p.y < grassDist)
+                        {
+                            mat = m.grass;
+
+                            // Avoid grass below the surface
+                            if (y > 0)
+                            {
+                                Block& below = blocks.getMutable(blockIdx({x, y - 1, z}));
+                                if (below.mat == m.grass)
+                                    below.mat = m.dirt;
+                            }
+                        }
+                        else
+                        {
+                            auto snowDist = column.snowLine[z * CHUNK_SIZE + x];
+                            if (p.y > snowDist)
+                                mat = m.snow;
+                            else if (p.y > snowDist - 3)
+                            {
+                                mat = m.snowRock;
+                            }
+                            else
+                                mat = m.rock;
+                        }
+
+                        if (mat != matAir)
+                        {
+                            // Avoid snow and gras below surface (except snow below snow)
+                            if (y > 0)
+                            {
+                                Block& below = blocks.getMutable(blockIdx({x, y - 1, z}));
+
+                                if (mat != m.snow && (below.mat == m.snowRock || below.mat == m.snow))
+                                {
+                                    // Snow inconsistency
+                                    below.mat = m.rock;
+                                }
+                                else if (below.mat == m.grass)
+                                {
+                                    // No grass below surface
+                                    below.mat = m.dirt;
+                                }
+                            }
+                        }
+                    }
+
+                    // Not in flat regions or in water
+                    if (p.y >= -20 && d > 3)
+                    {
+                        auto col = z * CHUNK_SIZE + x;
+                        auto cd = crystalNoise[crystalStart[col] + y - yBegin[col]];
+                        // Have some small chance to generate crystal
+                        if (cd > 0.8)
+                            mat = m.crystal;
+                        else
+                        {
+                            // only look inside this chunk:
+                            // other chunks may be generated concurrently by another worker thread
+                            // (and the chunk below is usually not generated yet)
+                            bool belowIsRock = false;
+                            if (y > 0)
+                                belowIsRock = blocks.get(blockIdx({x, y - 1, z})).mat == m.rock;
+
+                            // other minerals lie mainly below hills but only on rock material
+                            if (d > 8 && belowIsRock)
+                            {
+                                cd = goldNoise[oreStart[col] + y - yBegin[col]];
+                                if (cd > 0.9)
+                                    mat = m.gold;
+                                else
+                                {
+                                    cd = copperNoise[oreStart[col] + y - yBegin[col]];
+                                    if (cd > 0.9)
+                                        mat = m.copper;
+                                    else if (-cd > 0.9)
+                                        mat = m.bronze;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                // water plane
+                if (mat == matAir)
+                {
+                    if (p.y <= seaLevel)
+                        mat = m.water;
+                    else if (p.y <= 20 && y > 0)
+                    {
+                        auto below = blocks.get(blockIdx({x, y - 1, z}));
+                        if (!below.isInvalid() && below.isSolid())
+                        {
+                            const float spawnChance = 1 / 4000.0f;
+                            if (getRandFloat01Wang(rp) < spawnChance)
+                                mat = m.lightFountain;
+                        }
+                    }
+                }
+
+                // assign material
+                blocks.getMutable(blockIdx(rp)).mat = mat;
+            }
+
+    if (times)
+        clock.lap(times->blocks);
+
+    // choose the smallest block representation (uniform, palette, or dense)
+    blocks.compact();
+
+    if (times)
+        clock.lap(times->compact);
+}
+
+void TerrainGenerator::generateColumn(tg::ipos3 chunkPos, TerrainColumn& col, StageTimes* times) const
+{
+    GLOW_ACTION("[WORKER] - generate column");
+
+    StageClock clock(times != nullptr);
+
+    // terrain options
+    const auto waterDepthFactor = 3.0;
+    const auto hillHeightFactor = 8.0;
+    const auto flatLandFactor = 0.3;
+
+    // all 2D fractals of the column in batches
+    // (same arguments as the scalar calls, the batch results are identical)
+    auto const count = CHUNK_SIZE * CHUNK_SIZE;
+    FN_DECIMAL nx[count], nz[count];
+    FN_DECIMAL height[count], hill[count], grass[count], snow[count];
+
+    auto eval = [&](double sx, double sz, FN_DECIMAL* out) {
+        for (auto i = 0; i < count; ++i)
+        {
+            auto p = tg::pos3(chunkPos + tg::ivec3(i % CHUNK_SIZE, 0, i / CHUNK_SIZE));
+            nx[i] = FN_DECIMAL(sx * p.x);
+            nz[i] = FN_DECIMAL(sz * p.z);
+        }
+        mNoiseGen.GetPerlinFractal(nx, nz, out, count);
+    };
+    eval(2.0, 2.0, height);
+    eval(.17, .18, hill);
+    eval(15.17, 17.18, grass);
+    eval(5.17, 7.18, snow);
+
+    for (auto idx = 0; idx < count; ++idx)
+    {
+        // generate terrain
+        auto d = 25 * (height[idx] + 0.15);
+        if (d < 0)
+            d *= waterDepthFactor;
+        else
+            d *= tg::mix(flatLandFactor, hillHeightFactor, tg::smoothstep(0.5, 0.7, 0.5 + 0.5 * hill[idx]));
+        col.height[idx] = d;
+
+        col.grassLine[idx] = 6 + 4 * grass[idx];
+        col.snowLine[idx] = 12 + 3 * snow[idx];
+    }
+
+    if (times)
+        clock.lap(times->column);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <typed-geometry/tg.hh>
+
+#include "BlockStorage.hh"
+#include "ColumnCache.hh"
+#include "Material.hh"
+#include "helper/Noise.hh"
+
+/**
+ * @brief Procedural terrain of the world (CPU only, no GL resources)
+ *
+ * Generation of a chunk is split into the 2D terrain of its column (generateColumn, shared by vertically stacked
+ * chunks, see ColumnCache) and the blocks of the chunk itself (generate).
+ *
+ * All functions are const and may be called concurrently from any thread.
+ */
+class TerrainGenerator
+{
+public:
+    /// material indices used by the generator (see Material::index, 0 is air)
+    struct Materials
+    {
+        int8_t grass = 0;
+        int8_t dirt = 0;
+        int8_t rock = 0;
+        int8_t sand = 0;
+        int8_t snow = 0;
+        int8_t snowRock = 0;
+
+        int8_t gold = 0;
+        int8_t copper = 0;
+        int8_t bronze = 0;
+
+        int8_t water = 0;
+        int8_t crystal = 0;
+        int8_t lightFountain = 0;
+    };
+
+    /// accumulated time per generation stage in seconds (see generate)
+    struct StageTimes
+    {
+        double column = 0;  ///< 2D terrain (only measured by generateColumn)
+        double noise = 0;   ///< 3D noise of crystal and ore candidates
+        double blocks = 0;  ///< material selection of every block
+        double compact = 0; ///< choosing the block representation
+
+        StageTimes& operator+=(StageTimes const& rhs)
+        {
+            column += rhs.column;
+            noise += rhs.noise;
+            blocks += rhs.blocks;
+            compact += rhs.compact;
+            return *this;
+        }
+    };
+
+private:
+    FastNoise mNoiseGen;
+    Materials mMats;
+
+public:
+    explicit TerrainGenerator(int seed = 1337);
+
+    /// looks up all required materials by name
+    /// (it is an error if one does not exist)
+    void setMaterials(std::vector<Material> const& opaque, std::vector<Material> const& translucent);
+    Materials const& getMaterials() const { return mMats; }
+
+    /// computes the 2D terrain of the column of a chunk
+    /// (adds the elapsed time to times->column if times is not null)
+    void generateColumn(tg::ipos3 chunkPos, TerrainColumn& col, StageTimes* times = nullptr) const;
+
+    /// generates all blocks of the chunk at chunkPos (and compacts them)
+    /// column must be the column of the chunk
+    /// (adds the elapsed time per stage to times if not null)
+    void generate(tg::ipos3 chunkPos, TerrainColumn const& column, BlockStorage& blocks, StageTimes* times = nullptr) const;
+};
@@ -0,0 +1,209 @@
+#include "TerrainLod.hh"
+
+#include <glow/common/log.hh>
+#include <glow/common/profiling.hh>
+
+#include "Chunk.hh"
+#include "World.hh"
+
+void TerrainLod::update(tg::pos3 camPos, float chunkDistance, float lodDistance)
+{
+    GLOW_ACTION();
+
+    ++mUpdate;
+    mIsActive = true;
+    mVisibleCells.clear();
+    mChunkColumnList.clear();
+    mStreamedColumns.clear();
+
+    // roots: all footprints of the coarsest level within the LOD distance
+    std::unordered_set<tg::ipos3> splitNodes;
+    auto const rootSize = CHUNK_SIZE << LOD_LEVELS;
+    auto lo = tg::ipos2(tg::floor((tg::pos2(camPos.x, camPos.z) - lodDistance) / float(rootSize)));
+    auto hi = tg::ipos2(tg::floor((tg::pos2(camPos.x, camPos.z) + lodDistance) / float(rootSize)));
+    for (auto z = lo.y; z <= hi.y; ++z)
+        for (auto x = lo.x; x <= hi.x; ++x)
+        {
+            auto origin = tg::ipos3(x * rootSize, 0, z * rootSize);
+            if (lodNearestDistance(camPos, origin, LOD_LEVELS) <= lodDistance)
+                select(LOD_LEVELS, origin, camPos, chunkDistance, splitNodes);
+        }
+    mSplitNodes = std::move(splitNodes);
+
+    mChunkColumns.clear();
+    mChunkColumns.insert(mChunkColumnList.begin(), mChunkColumnList.end());
+
+    mStreamDistance = 0.0f;
+    for (auto const& c : mStreamedColumns)
+        mStreamDistance = tg::max(mStreamDistance, lodNearestDistance(camPos, tg::ipos3(c.x, 0, c.y), 0));
+
+    // drop cells that are neither selected nor needed for a transition
+    for (auto it = mCells.begin(); it != mCells.end();)
+    {
+        if (it->second->lastSelected != mUpdate)
+        {
+            drop(*it->second);
+            it = mCells.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+bool TerrainLod::select(int level, tg::ipos3 origin, tg::pos3 camPos, float chunkDistance, std::unordered_set<tg::ipos3>& splitNodes)
+{
+    // full resolution
+    if (level == 0)
+    {
+        mStreamedColumns.push_back({origin.x, origin.z});
+        mChunkColumnList.push_back({origin.x, origin.z});
+        return isChunkColumnReady(origin);
+    }
+
+    auto const key = keyOf(level, origin);
+    auto const half = CHUNK_SIZE << (level - 1);
+
+    // split while the footprint reaches into the split distance (a bit farther if already split)
+    auto splitDis = lodSplitDistance(level, chunkDistance);
+    if (mSplitNodes.count(key))
+        splitDis *= 1 + hysteresis;
+
+    if (lodNearestDistance(camPos, origin, level) < splitDis)
+    {
+        splitNodes.insert(key);
+
+        auto cellMark = mVisibleCells.size();
+        auto columnMark = mChunkColumnList.size();
+        auto ready = true;
+        for (auto dz : {0, 1})
+            for (auto dx : {0, 1})
+                ready = select(level - 1, origin + tg::ivec3(dx, 0, dz) * half, camPos, chunkDistance, splitNodes) && ready;
+
+        if (ready)
+            return true;
+
+        // the cell of this node stays visible until all finer cells are ready
+        // (if there is none, the finer cells that are ready are drawn)
+        auto it = mCells.find(key);
+        if (it == mCells.end() || !it->second->isBuilt)
+            return false;
+
+        mVisibleCells.resize(cellMark);
+        mChunkColumnList.resize(columnMark);
+        it->second->lastSelected = mUpdate;
+        mVisibleCells.push_back(it->second.get());
+        return true;
+    }
+
+    // leaf: request the cell
+    auto& cell = mCells[key];
+    if (!cell)
+    {
+        cell = std::make_shared<LodCell>();
+        cell->level = level;
+        cell->origin = origin;
+        mWorld->mWorker.enqueueLod(cell);
+    }
+    cell->lastSelected = mUpdate;
+
+    if (cell->isBuilt)
+    {
+        mVisibleCells.push_back(cell.get());
+        return true;
+    }
+
+    // the finer cells stay visible until this one is ready (if there are any)
+    for (auto dz : {0, 1})
+        for (auto dx : {0, 1})
+        {
+            auto child = origin + tg::ivec3(dx, 0, dz) * half;
+            if (level == 1)
+            {
+                if (isChunkColumnReady(child))
+                    mChunkColumnList.push_back({child.x, child.z});
+                continue;
+            }
+
+            auto it = mCells.find(keyOf(level - 1, child));
+            if (it != mCells.end() && it->second->isBuilt)
+            {
+                it->second->lastSelected = mUpdate;
+                mVisibleCells.push_back(it->second.get());
+            }
+        }
+    return false;
+}
+
+bool TerrainLod::isChunkColumnReady(tg::ipos3 origin) const
+{
+    // columns are generated from y = 0 up and down
+    auto c = mWorld->queryChunk(tg::ipos3(origin.x, 0, origin.z));
+    return c && c->isGenerated() && c->isMeshed();
+}
+
+void TerrainLod::clear()
+{
+    for (auto const& cellPair : mCells)
+        drop(*cellPair.second);
+    mCells.clear();
+
+    mSplitNodes.clear();
+    mVisibleCells.clear();
+    mChunkColumnList.clear();
+    mChunkColumns.clear();
+    mStreamedColumns.clear();
+    mStreamDistance = 0.0f;
+    mIsActive = false;
+}
+
+void TerrainLod::drop(LodCell& cell)
+{
+    cell.isDropped = true;
+
+    // pending jobs may still hold the cell, the meshes are released right away
+    mMeshMemory -= cell.meshMemory;
+    cell.meshMemory = 0;
+    cell.cubes.clear();
+}
+
+void TerrainLod::notifyCellBuilt(SharedLodCell const& cell, std::vector<LodCubeData> const& cubes)
+{
+    GLOW_ACTION();
+
+    if (cell->isDropped)
+        return; // no longer needed
+
+    cell->aabbMin = tg::pos3(cell->origin);
+    cell->aabbMax = tg::pos3(cell->origin);
+    for (auto const& cubeData : cubes)
+    {
+        LodCell::Cube cube;
+        cube.origin = cubeData.origin;
+
+        for (auto const& data : cubeData.meshes)
+        {
+            TerrainMesh mesh;
+            mesh.mat = mWorld->getMaterialFromIndex(data.mat)->renderMaterials[renderMaterialIndex(data.dir)];
+            mesh.dir = data.dir;
+            mesh.aabbMin = data.aabbMin;
+            mesh.aabbMax = data.aabbMax;
+            uploadTerrainMesh(mWorld->getTerrainArena(), mesh, data);
+
+            if (cell->cubes.empty() && cube.meshes.empty())
+            {
+                cell->aabbMin = mesh.aabbMin;
+                cell->aabbMax = mesh.aabbMax;
+            }
+            cell->aabbMin = tg::min(cell->aabbMin, mesh.aabbMin);
+            cell->aabbMax = tg::max(cell->aabbMax, mesh.aabbMax);
+            cell->meshMemory += size_t(mesh.indexCount / 6 * 4) * sizeof(TerrainVertex);
+
+            cube.meshes.push_back(mesh);
+        }
+
+        cell->cubes.push_back(std::move(cube));
+    }
+
+    cell->isBuilt = true;
+    mMeshMemory += cell->meshMemory;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <typed-geometry/tg-std.hh>
+#include <typed-geometry/tg.hh>
+
+#include <glow/common/shared.hh>
+
+#include "Constants.hh"
+#include "LodBuilder.hh"
+#include "TerrainMesh.hh"
+
+class World;
+GLOW_SHARED(struct, LodCell);
+
+/// GPU meshes of a LOD cell (see LodBuilder.hh)
+struct LodCell
+{
+    /// CHUNK_SIZE^3 voxels of the cell
+    struct Cube
+    {
+        /// world space position of the first voxel
+        tg::ipos3 origin;
+
+        /// one mesh per (material, direction), positions in voxels
+        PooledVector<TerrainMesh> meshes;
+    };
+
+    int level = 0;
+    /// first block of the footprint (y = 0)
+    tg::ipos3 origin;
+
+    /// all cubes with meshes
+    std::vector<Cube> cubes;
+
+    /// Bounding box of all meshes
+    tg::pos3 aabbMin;
+    tg::pos3 aabbMax;
+
+    /// GPU memory used by the meshes in bytes
+    size_t meshMemory = 0;
+
+    /// true iff the meshes are uploaded
+    bool isBuilt = false;
+
+    /// true iff the cell is no longer used (pending builds are skipped)
+    /// (read by the worker threads)
+    std::atomic<bool> isDropped = {false};
+
+    /// last update (see TerrainLod::update) that selected this cell
+    int lastSelected = 0;
+
+    /// size of a voxel in blocks
+    int voxelSize() const { return 1 << level; }
+};
+
+/**
+ * @brief Level of detail for the terrain beyond the full resolution chunks
+ *
+ * The ground is partitioned by a quadtree that is selected anew in every update:
+ *  - roots are the footprints of the coarsest level (LOD_LEVELS) within the LOD distance
+ *  - a node is split while the nearest point of its footprint is within its split distance (see lodSplitDistance),
+ *    nodes of level 1 are split into chunk columns, whose chunks are drawn at full resolution
+ *    (all columns within the chunk distance and the rest of their level 1 footprints, see getStreamedColumns)
+ *  - hysteresis: a split node has to move a bit farther away before it is merged again
+ *
+ * Cells are built by the worker threads and dropped once they are no longer selected.
+ * When a node switches levels, the old cells stay visible until all new ones are ready,
+ * so level changes never leave holes.
+ *
+ * Render thread only.
+ */
+class TerrainLod
+{
+private:
+    /// Backreference to the world
+    World* mWorld;
+
+    /// all cells, indexed by (x, level, z) of their origin
+    std::unordered_map<tg::ipos3, SharedLodCell> mCells;
+
+    /// split nodes of the last update, indexed like mCells (for the hysteresis)
+    std::unordered_set<tg::ipos3> mSplitNodes;
+
+    /// selection of the last update
+    std::vector<LodCell*> mVisibleCells;
+    std::vector<tg::ipos2> mChunkColumnList;        ///< footprints (x, z) of the chunk columns
+    std::unordered_set<tg::ipos2> mChunkColumns;    ///< same as mChunkColumnList (for lookups)
+
+    /// footprints of all chunk columns of split level 1 nodes (drawn as soon as they are ready)
+    std::vector<tg::ipos2> mStreamedColumns;
+    float mStreamDistance = 0.0f; ///< largest horizontal distance of a streamed column
+
+    /// number of updates so far
+    int mUpdate = 0;
+    /// true iff update was called since the last clear
+    bool mIsActive = false;
+
+    /// GPU memory of all cells in bytes
+    size_t mMeshMemory = 0;
+
+public:
+    /// fraction of the split distance that a split node has to move farther away before it is merged
+    float hysteresis = 0.1f;
+
+    explicit TerrainLod(World* world) : mWorld(world) {}
+
+    /// selects the cells around the camera, requests missing cells from the worker threads
+    /// chunks are drawn up to chunkDistance, cells up to lodDistance
+    void update(tg::pos3 camPos, float chunkDistance, float lodDistance);
+
+    /// drops all cells (LOD is inactive until the next update)
+    void clear();
+
+    /// uploads the meshes of a cell built by a worker thread
+    void notifyCellBuilt(SharedLodCell const& cell, std::vector<LodCubeData> const& cubes);
+
+public: // accessor functions
+    /// true iff the LOD cells (and not the render distance) decide which chunks are drawn
+    bool isActive() const { return mIsActive; }
+
+    /// cells to draw
+    std::vector<LodCell*> const& getVisibleCells() const { return mVisibleCells; }
+
+    /// true iff the chunk at chunkPos belongs to a chunk column that is drawn at full resolution
+    bool isChunkVisible(tg::ipos3 chunkPos) const { return mChunkColumns.count({chunkPos.x, chunkPos.z}) > 0; }
+
+    /// chunk columns (x, z) that must be generated and meshed, the world streams exactly these
+    std::vector<tg::ipos2> const& getStreamedColumns() const { return mStreamedColumns; }
+    /// largest horizontal distance of a streamed column
+    float getStreamDistance() const { return mStreamDistance; }
+
+    /// number of cells (including the ones that are not built yet)
+    int getCellCount() const { return (int)mCells.size(); }
+    /// GPU memory of all cells in bytes
+    size_t getMeshMemory() const { return mMeshMemory; }
+
+private: // helper
+    /// selects the cells of a node (or the node itself), returns false if they are not ready yet
+    bool select(int level, tg::ipos3 origin, tg::pos3 camPos, float chunkDistance, std::unordered_set<tg::ipos3>& splitNodes);
+
+    /// true iff the chunks of the column starting at origin can be drawn
+    bool isChunkColumnReady(tg::ipos3 origin) const;
+
+    /// releases the meshes of a cell and skips its pending build
+    void drop(LodCell& cell);
+
+    static tg::ipos3 keyOf(int level, tg::ipos3 origin) { return {origin.x, level, origin.z}; }
+};
@@ -1,3 +1,46 @@
 #include "TerrainMesh.hh"
 
+#include <glow/objects/ElementArrayBuffer.hh>
 
+#include <typed-geometry/tg.hh>
+
+// quad vertices are addressed with 16 bit indices
+static_assert(4 * maxTerrainMeshQuads <= 65536, "terrain quad indices must fit into uint16_t");
+
+int renderMaterialIndex(tg::ivec3 dir)
+{
+    auto pd = tg::abs(dir);
+    auto s = (dir.x + dir.y + dir.z + 1) / 2;
+    auto pdir = pd.y + pd.z * 2 + s * 3;
+    TG_ASSERT(0 <= pdir && pdir < 6);
+    return pdir;
+}
+
+void uploadTerrainMesh(TerrainArena& arena, TerrainMesh& mesh, TerrainMeshData const& data)
+{
+    auto quads = int(data.vertices.size() / 4);
+    if (!mesh.vertices || mesh.vertices->getQuadCapacity() < quads || mesh.vertices->getQuadCapacity() > 2 * quads)
+        mesh.vertices = arena.allocate(quads);
+
+    arena.upload(*mesh.vertices, data.vertices.data(), quads);
+    mesh.indexCount = quads * 6;
+}
+
+glow::SharedElementArrayBuffer const& getTerrainQuadIndices()
+{
+    static glow::SharedElementArrayBuffer indices;
+    if (!indices)
+    {
+        // vertices of a quad are p00, p01, p10, p11 (see MeshGenerator.cc)
+        std::vector<uint16_t> data;
+        data.reserve(6 * maxTerrainMeshQuads);
+        for (auto q = 0; q < maxTerrainMeshQuads; ++q)
+        {
+            auto v = uint16_t(4 * q);
+            for (auto i : {0, 1, 3, 0, 3, 2})
+                data.push_back(uint16_t(v + i));
+        }
+        indices = glow::ElementArrayBuffer::create(data);
+    }
+    return indices;
+}
@@ -4,12 +4,19 @@
 
 #include <typed-geometry/tg-lean.hh>
 
+#include "Constants.hh"
 #include "Material.hh"
+#include "TerrainArena.hh"
 #include "Vertices.hh"
 
-/// A terrain mesh for a (chunk, material, direction) combination
+#include "helper/MemoryPool.hh"
+
+/// A terrain mesh for a (chunk section, material, direction) combination
 struct TerrainMesh
 {
+    /// Section of the chunk (see CHUNK_SECTION_HEIGHT)
+    int section = 0;
+
     /// The material used for this mesh
     SharedRenderMaterial mat = nullptr;
 
@@ -20,17 +27,18 @@ struct TerrainMesh
     tg::pos3 aabbMin;
     tg::pos3 aabbMax;
 
-    /// configured geometry
-    glow::SharedVertexArray vaoFull;
-    glow::SharedVertexArray vaoPosOnly;
+    /// vertex data in the terrain arena (drawn with the shared quad indices)
+    SharedTerrainAllocation vertices;
 
-    /// vertex data
-    glow::SharedArrayBuffer abPositions;
-    glow::SharedArrayBuffer abData;
+    /// number of indices to draw (6 per quad)
+    int indexCount = 0;
 };
 
 struct TerrainMeshData
 {
+    /// Section of the chunk (see CHUNK_SECTION_HEIGHT)
+    int section = 0;
+
     /// The material used for this mesh
     int8_t mat;
 
@@ -41,7 +49,23 @@ struct TerrainMeshData
     tg::pos3 aabbMin;
     tg::pos3 aabbMax;
 
-    /// Vertices
-    std::vector<tg::pos3> vertexPositions;
-    std::vector<TerrainVertex> vertexData;
+    /// Vertices, 4 per quad (pooled, meshes are created and dropped all the time)
+    PooledVector<TerrainVertex> vertices;
 };
+
+/// maximum number of quads of a single terrain mesh
+/// (a (material, direction) pair has at most one face per two blocks, i.e. every other block is air)
+constexpr int maxTerrainMeshQuads = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE / 2;
+
+/// index of a face direction in Material::renderMaterials
+int renderMaterialIndex(tg::ivec3 dir);
+
+/// uploads the vertices of data into the arena
+/// (re-uses the allocation of the mesh if the vertices fit and do not waste too much space)
+/// render thread only
+void uploadTerrainMesh(TerrainArena& arena, TerrainMesh& mesh, TerrainMeshData const& data);
+
+/// index buffer shared by all terrain meshes: quad q consists of the vertices 4q .. 4q+3
+/// (two triangles per quad, covers maxTerrainMeshQuads quads)
+/// created on first use, render thread only
+glow::SharedElementArrayBuffer const& getTerrainQuadIndices();
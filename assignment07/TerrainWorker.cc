@@ -1,116 +1,424 @@
 #include "TerrainWorker.hh"
 
-#include <chrono>
+#include <algorithm>
+#include <thread>
 
-#include <typed-geometry/tg-lean.hh>
+#include <typed-geometry/tg.hh>
 
 #include <glow/common/log.hh>
 
 #include "Chunk.hh"
 #include "MeshGenerator.hh"
+#include "TerrainLod.hh"
 #include "World.hh"
 
-TerrainWorker::TerrainWorker(World* world) : mWorld(world)
+namespace
 {
-    // launch thread here (after member init)
-    mWorkerThread = std::thread(
-        [](TerrainWorker* w) {
-            w->run(); // execute thread
-        },
-        this);
+// heap order: most urgent (smallest priority) job on top
+template <class JobT>
+bool lessUrgent(JobT const& a, JobT const& b)
+{
+    return a.priority > b.priority;
+}
+} // namespace
+
+TerrainWorker::TerrainWorker(World* world, int threadCount) : mWorld(world), mSubmitted(4096)
+{
+    // leave one hardware thread to the render thread
+    if (threadCount <= 0)
+        threadCount = tg::max(1, (int)std::thread::hardware_concurrency() - 1);
+
+    // create all queues before any thread can steal from them
+    for (auto i = 0; i < threadCount; ++i)
+        mQueues.emplace_back(new WorkerQueue());
+
+    mLastEpochTime = std::chrono::steady_clock::now();
+
+    // launch threads here (after member init)
+    for (auto i = 0; i < threadCount; ++i)
+        mThreads.emplace_back(
+            [](TerrainWorker* w, int idx) {
+                w->run(idx); // execute thread
+            },
+            this, i);
 }
 
 void TerrainWorker::stop()
 {
     mShouldStop = true;
-    mWorkerThread.join();
+
+    // wake up all sleeping threads
+    {
+        std::lock_guard<std::mutex> lock(mMutexPark);
+        mCondPark.notify_all();
+    }
+
+    for (auto& t : mThreads)
+        t.join();
+    mThreads.clear();
 }
 
 void TerrainWorker::update()
 {
-    if (mJobsGenFinished.empty() && mJobsMeshFinished.empty())
-        return; // early out
+    flushOverflow();
 
-    mMutexFinished.lock();
+    // process finished jobs
+    // (mesh jobs run in parallel, so an outdated mesh may finish after a newer one)
+    FinishedJob job;
+    while (mFinished.tryPop(job))
+    {
+        if (job.type == JobType::Lod)
+        {
+            // (cancelled LOD jobs belong to dropped cells)
+            if (!job.cancelled)
+                mWorld->notifyLodCellBuilt(job.cell, job.cubes);
+        }
+        else if (job.cancelled)
+        {
+            if (job.type == JobType::Gen)
+                mWorld->notifyChunkGenCancelled(job.chunk);
+            else if (auto sections = job.chunk->currentSections(job.sections, job.version))
+                mWorld->notifyChunkMeshCancelled(job.chunk, sections);
+        }
+        else if (job.type == JobType::Gen)
+            mWorld->notifyChunkGenerated(job.chunk);
+        else
+        {
+            if (auto sections = job.chunk->currentSections(job.sections, job.version))
+                mWorld->notifyChunkMeshed(job.chunk, sections, job.data, job.version, job.visibility);
 
-    // process generation jobs
-    for (auto c : mJobsGenFinished)
-        mWorld->notifyChunkGenerated(c.chunk);
-    mJobsGenFinished.clear();
+            if (job.blockRevision >= 0)
+                job.chunk->notifyCompactedBlocks(job.blockRevision, std::move(job.blocks));
+        }
+    }
+}
+
+void TerrainWorker::enqueueGen(SharedChunk chunk)
+{
+    Job job;
+    job.type = JobType::Gen;
+    job.chunk = chunk;
+    push(std::move(job));
+}
 
-    // process mesh jobs
-    for (auto c : mJobsMeshFinished)
-        mWorld->notifyChunkMeshed(c.chunk, c.data);
-    mJobsMeshFinished.clear();
+void TerrainWorker::enqueueMesh(
+    SharedChunk chunk, PooledVector<Block> blocks, int version, int sections, bool isEdit, int blockRevision)
+{
+    Job job;
+    job.type = isEdit ? JobType::Remesh : JobType::Mesh;
+    job.chunk = chunk;
+    job.blocks = std::move(blocks);
+    job.version = version;
+    job.sections = sections;
+    job.blockRevision = blockRevision;
+    push(std::move(job));
+}
 
-    mMutexFinished.unlock();
+void TerrainWorker::enqueueLod(SharedLodCell cell)
+{
+    Job job;
+    job.type = JobType::Lod;
+    job.cell = cell;
+    push(std::move(job));
 }
 
-void TerrainWorker::enqueueGen(SharedChunk chunk)
+void TerrainWorker::notifyCamera(tg::pos3 pos, float renderDistance, FrustumCuller const* frustum)
+{
+    std::lock_guard<std::mutex> lock(mMutexCamera);
+
+    auto isFirst = mCamera.renderDistance < 0;
+
+    mCamera.position = pos;
+    mCamera.renderDistance = renderDistance;
+    if (frustum)
+        mCamera.frustum = *frustum;
+    else
+        mCamera.frustum.reset();
+
+    // re-evaluate priorities after noticeable movement
+    // (or from time to time, as rotations also change the frustum)
+    auto now = std::chrono::steady_clock::now();
+    if (isFirst || distance(pos, mLastEpochPos) > 1.0f || now - mLastEpochTime > std::chrono::milliseconds(100))
+    {
+        mLastEpochPos = pos;
+        mLastEpochTime = now;
+        ++mCameraEpoch;
+    }
+}
+
+float TerrainWorker::chunkDistance(tg::ipos3 chunkPos, tg::pos3 pos, bool horizontal)
 {
-    mMutexNew.lock();
-    mJobsGen.push({chunk});
-    mMutexNew.unlock();
+    auto amin = tg::pos3(chunkPos);
+    auto amax = tg::pos3(chunkPos + CHUNK_SIZE);
+    if (horizontal)
+    {
+        amin.y = pos.y;
+        amax.y = pos.y;
+    }
+    return distance(tg::clamp(pos, amin, amax), pos);
 }
 
-void TerrainWorker::enqueueMesh(SharedChunk chunk, std::vector<Block> blocks)
+bool TerrainWorker::prioritize(Job& job, CameraInfo const& cam)
 {
-    mMutexNew.lock();
-    mJobsMesh.push({chunk, std::move(blocks), chunk->getMeshVersion()});
-    mMutexNew.unlock();
+    if (job.type == JobType::Lod && job.cell->isDropped)
+        return false; // cell is no longer needed
+
+    if (cam.renderDistance < 0)
+        return true; // no camera: all jobs are equally urgent
+
+    float dis;
+    tg::pos3 amin, amax;
+    if (job.type == JobType::Lod)
+    {
+        // footprint of the cell (the height is not known before it is built)
+        auto const& cell = *job.cell;
+        auto size = float(CHUNK_SIZE << cell.level);
+        dis = lodNearestDistance(cam.position, cell.origin, cell.level);
+        amin = tg::pos3(cell.origin);
+        amax = amin + tg::vec3(size, CHUNK_SIZE, size);
+    }
+    else
+    {
+        auto cp = job.chunk->chunkPos;
+        dis = chunkDistance(cp, cam.position, false);
+        amin = tg::pos3(cp);
+        amax = tg::pos3(cp + CHUNK_SIZE);
+
+        // cancel jobs of chunks that left the render distance
+        // (generation only considers x/z because columns are generated downwards from y = 0)
+        auto cancelDis = job.type == JobType::Gen ? chunkDistance(cp, cam.position, true) : dis;
+        if (cancelDis > cam.renderDistance + cancelMargin)
+            return false;
+    }
+
+    auto prio = dis;
+
+    // invisible chunks are deferred (but not forever: the camera may turn around)
+    if (cam.frustum.has_value() && !cam.frustum->isAabbVisible(amin, amax))
+        prio = 2 * prio + 2 * CHUNK_SIZE;
+
+    // edits should be visible immediately
+    if (job.type == JobType::Remesh)
+        prio -= 1e6f;
+
+    job.priority = prio;
+    return true;
 }
 
-void TerrainWorker::run()
+void TerrainWorker::push(Job job)
 {
-    while (!mShouldStop)
+    // keep submission order
+    flushOverflow();
+
+    if (!mOverflow.empty() || !mSubmitted.tryPush(job))
     {
-        auto doneWork = false;
+        mOverflow.push_back(std::move(job));
+        return;
+    }
+
+    wakeOne();
+}
 
-        // generate
-        if (!mJobsGen.empty())
+void TerrainWorker::flushOverflow()
+{
+    auto submitted = 0u;
+    while (submitted < mOverflow.size())
+    {
+        if (!mSubmitted.tryPush(mOverflow[submitted]))
+            break;
+
+        wakeOne();
+        ++submitted;
+    }
+    mOverflow.erase(mOverflow.begin(), mOverflow.begin() + submitted);
+}
+
+void TerrainWorker::wakeOne()
+{
+    ++mWakeSeq;
+    if (mParkedThreads > 0)
+    {
+        std::lock_guard<std::mutex> lock(mMutexPark);
+        mCondPark.notify_one();
+    }
+}
+
+void TerrainWorker::cancel(Job& job)
+{
+    FinishedJob fin;
+    fin.type = job.type;
+    fin.cancelled = true;
+    fin.chunk = std::move(job.chunk);
+    fin.cell = std::move(job.cell);
+    fin.version = job.version;
+    fin.sections = job.sections;
+    mFinished.push(std::move(fin));
+}
+
+void TerrainWorker::refresh(WorkerQueue& q)
+{
+    int epoch = mCameraEpoch;
+    if (q.epoch == epoch)
+        return; // up to date
+
+    {
+        std::lock_guard<std::mutex> lock(mMutexCamera);
+        q.camera = mCamera;
+    }
+
+    // re-prioritize and remove cancelled jobs
+    auto keep = 0u;
+    for (auto i = 0u; i < q.jobs.size(); ++i)
+    {
+        auto& job = q.jobs[i];
+        if (!prioritize(job, q.camera))
+            cancel(job);
+        else if (keep++ != i)
+            q.jobs[keep - 1] = std::move(job);
+    }
+    q.jobs.resize(keep);
+
+    std::make_heap(q.jobs.begin(), q.jobs.end(), lessUrgent<Job>);
+    q.epoch = epoch;
+}
+
+bool TerrainWorker::pop(int threadIdx, Job& job)
+{
+    // move newly submitted jobs into the own queue
+    // (a few at a time, so that other threads also get some)
+    auto moved = 0;
+    {
+        auto& q = *mQueues[threadIdx];
+        std::lock_guard<std::mutex> lock(q.mutex);
+
+        refresh(q);
+
+        Job newJob;
+        for (auto i = 0; i < 32 && mSubmitted.tryPop(newJob); ++i)
         {
-            // get a job
-            mMutexNew.lock();
-            auto job = std::move(mJobsGen.front());
-            mJobsGen.pop();
-            mMutexNew.unlock();
-
-            // process job
-            mWorld->generate(*job.chunk);
-            doneWork = true;
-
-            // finish job
-            mMutexFinished.lock();
-            mJobsGenFinished.push_back({job.chunk});
-            mMutexFinished.unlock();
+            if (!prioritize(newJob, q.camera))
+            {
+                cancel(newJob);
+                continue;
+            }
+
+            q.jobs.push_back(std::move(newJob));
+            std::push_heap(q.jobs.begin(), q.jobs.end(), lessUrgent<Job>);
+            ++moved;
         }
+    }
+
+    // this thread takes one of them, idle threads can steal the others
+    // (they might have looked for work while the jobs were neither submitted nor queued)
+    if (moved > 1)
+        wakeOne();
 
-        // mesh
-        if (!mJobsMesh.empty())
+    // own queue first, then try to steal from the others
+    auto queueCount = (int)mQueues.size();
+    for (auto i = 0; i < queueCount; ++i)
+    {
+        auto& q = *mQueues[(threadIdx + i) % queueCount];
+        std::lock_guard<std::mutex> lock(q.mutex);
+
+        refresh(q);
+
+        if (!q.jobs.empty())
+        {
+            std::pop_heap(q.jobs.begin(), q.jobs.end(), lessUrgent<Job>);
+            job = std::move(q.jobs.back());
+            q.jobs.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TerrainWorker::process(Job& job)
+{
+    FinishedJob fin;
+    fin.type = job.type;
+    fin.version = job.version;
+    fin.sections = job.sections;
+
+    switch (job.type)
+    {
+    case JobType::Gen:
+        // process job
+        mWorld->loadOrGenerate(*job.chunk);
+        break;
+
+    case JobType::Mesh:
+    case JobType::Remesh:
+        // only sections without a newer update
+        fin.sections = job.chunk->currentSections(job.sections, job.version);
+        if (fin.sections == 0)
+            return;
+
+        // process job
+        fin.data = generateMesh(job.blocks, job.chunk->chunkPos, mMeshingMode, fin.sections);
+        fin.visibility = computeChunkVisibility(job.blocks);
+
+        // edited chunks stay dense on the render thread, the compaction is done here
+        if (job.blockRevision >= 0)
         {
-            mMutexNew.lock();
-            auto job = std::move(mJobsMesh.front());
-            mJobsMesh.pop();
-            mMutexNew.unlock();
+            auto constexpr cs = CHUNK_SIZE + 2;
+            PooledVector<Block> blocks(BlockStorage::blockCount);
+            for (auto z = 0; z < CHUNK_SIZE; ++z)
+                for (auto y = 0; y < CHUNK_SIZE; ++y)
+                {
+                    auto src = job.blocks.begin() + (((z + 1) * cs + y + 1) * cs + 1);
+                    std::copy(src, src + CHUNK_SIZE, blocks.begin() + (z * CHUNK_SIZE + y) * CHUNK_SIZE);
+                }
 
-            // only if current mesh version
-            if (job.chunk->getMeshVersion() == job.version)
+            BlockStorage storage;
+            storage.assign(blocks.data());
+            if (storage.getKind() != BlockStorage::Kind::Dense) // too many different blocks otherwise
             {
-                // process job
-                auto meshes = generateMesh(job.blocks, job.chunk->chunkPos);
-                doneWork = true;
-
-                // finish job
-                mMutexFinished.lock();
-                mJobsMeshFinished.push_back({ job.chunk, std::move(meshes) });
-                mMutexFinished.unlock();
+                fin.blocks = std::move(storage);
+                fin.blockRevision = job.blockRevision;
             }
         }
+        break;
+
+    case JobType::Lod:
+        if (job.cell->isDropped)
+            return; // no longer needed
+
+        fin.cubes = mWorld->buildLod(*job.cell, mMeshingMode);
+        break;
+    }
+
+    // finish job
+    fin.chunk = std::move(job.chunk);
+    fin.cell = std::move(job.cell);
+    mFinished.push(std::move(fin));
+}
+
+void TerrainWorker::run(int threadIdx)
+{
+    Job job;
+    while (!mShouldStop)
+    {
+        // read before looking for work: jobs that become visible afterwards change it
+        unsigned seq = mWakeSeq;
+
+        if (pop(threadIdx, job))
+        {
+            process(job);
+
+            // release chunk and blocks early
+            job = Job();
+            continue;
+        }
 
-        // sleep if no work done
-        if (!doneWork)
+        // park until new jobs are visible
+        // (wakeOne only notifies registered threads, the predicate catches wakes before the registration)
+        ++mParkedThreads;
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::unique_lock<std::mutex> lock(mMutexPark);
+            mCondPark.wait(lock, [&] { return mWakeSeq != seq || mShouldStop; });
         }
+        --mParkedThreads;
     }
 }
@@ -1,66 +1,153 @@
 #pragma once
 
-#include <queue>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <thread>
+#include <vector>
 
 #include <glow/common/shared.hh>
 
 #include "Block.hh"
+#include "BlockStorage.hh"
+#include "ChunkVisibility.hh"
+#include "Constants.hh"
+#include "FrustumCuller.hh"
+#include "LodBuilder.hh"
+#include "MeshGenerator.hh"
 #include "TerrainMesh.hh"
 
+#include "helper/MemoryPool.hh"
+#include "helper/MpmcQueue.hh"
+#include "helper/MpscQueue.hh"
+
 class World;
 GLOW_SHARED(class, Chunk);
+GLOW_SHARED(struct, LodCell);
 
 /**
- * @brief Separate thread for generating and creating chunks
+ * @brief Pool of worker threads for generating and meshing chunks (and building LOD cells)
+ *
+ * New jobs are submitted through a bounded lock-free queue.
+ * Every thread moves submitted jobs into its own job queue,
+ * takes the most urgent job of its own queue and, if that is empty,
+ * steals the most urgent job of another thread's queue.
+ * Threads without work sleep on a condition variable until new jobs are submitted
+ * (or moved into a queue they can steal from).
+ *
+ * Finished jobs are sent back through a lock-free queue and processed in update() on the render thread.
+ *
+ * Urgency depends on the camera (see notifyCamera):
+ *  - remeshing of edited chunks comes first
+ *  - then closer chunks before distant ones
+ *  - chunks outside the view frustum are deferred
+ * Jobs of chunks that left the render distance are cancelled and reported back to the world.
+ * LOD cells are far beyond the render distance, their jobs are only cancelled once the cell is dropped.
  */
 class TerrainWorker
 {
 private:
-    struct GenJob
+    enum class JobType
     {
-        SharedChunk chunk;
+        Gen,
+        Mesh,
+        Remesh, // mesh of an edited chunk
+        Lod
     };
-    struct GenJobFin
+
+    struct Job
     {
+        JobType type;
         SharedChunk chunk;
+        SharedLodCell cell; ///< only for JobType::Lod (instead of chunk)
+
+        // only for JobType::Mesh and JobType::Remesh
+        PooledVector<Block> blocks;
+        int version = 0;
+        int sections = 0; ///< bit mask of the sections to mesh
+        int blockRevision = -1; ///< >= 0: also compact a copy of the (dense) chunk blocks, see Chunk::notifyCompactedBlocks
+
+        /// smaller is more urgent
+        float priority = 0.0f;
     };
 
-    struct MeshJob
+    struct FinishedJob
     {
+        JobType type;
+        bool cancelled = false;
         SharedChunk chunk;
-        std::vector<Block> blocks;
-        int version;
+        PooledVector<TerrainMeshData> data; ///< only for finished mesh jobs
+        ChunkVisibility visibility;         ///< only for finished mesh jobs
+        BlockStorage blocks;                ///< compacted chunk blocks (only if blockRevision >= 0)
+        int blockRevision = -1;             ///< block revision of the compacted copy
+        int version = 0;
+        int sections = 0;
+
+        SharedLodCell cell;
+        std::vector<LodCubeData> cubes; ///< only for finished LOD jobs
     };
-    struct MeshJobFin
+
+    /// everything the priorities depend on
+    struct CameraInfo
     {
-        SharedChunk chunk;
-        std::vector<TerrainMeshData> data;
+        tg::pos3 position;
+        float renderDistance = -1; ///< < 0 means "no camera yet"
+        std::optional<FrustumCuller> frustum;
+    };
+
+    /// job queue of a single worker thread
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::vector<Job> jobs; ///< binary heap, most urgent job first
+        int epoch = 0;         ///< camera epoch of the current priorities
+        CameraInfo camera;     ///< camera of the current priorities
     };
 
 private:
     /// true iff the worker should stop
-    volatile bool mShouldStop = false;
+    std::atomic<bool> mShouldStop = {false};
 
-    /// separate worker thread
-    std::thread mWorkerThread;
+    /// worker threads
+    std::vector<std::thread> mThreads;
 
     /// backref to the world
     World* mWorld;
 
-    // queues
-    std::mutex mMutexNew;
-    std::mutex mMutexFinished;
+    /// jobs submitted by the render thread (taken by any worker)
+    MpmcQueue<Job> mSubmitted;
+    /// jobs that did not fit into mSubmitted (render thread only, resubmitted in update)
+    std::vector<Job> mOverflow;
 
-    std::queue<GenJob> mJobsGen;
-    std::vector<GenJobFin> mJobsGenFinished;
+    // queues (one per thread)
+    std::vector<std::unique_ptr<WorkerQueue>> mQueues;
 
-    std::queue<MeshJob> mJobsMesh;
-    std::vector<MeshJobFin> mJobsMeshFinished;
+    // idle threads
+    std::mutex mMutexPark;
+    std::condition_variable mCondPark;
+    std::atomic<int> mParkedThreads = {0};
+    std::atomic<unsigned> mWakeSeq = {0}; ///< incremented whenever new jobs become visible to idle threads
+
+    // camera
+    std::mutex mMutexCamera;
+    CameraInfo mCamera;                ///< guarded by mMutexCamera (written by render thread only)
+    std::atomic<int> mCameraEpoch = {0}; ///< incremented whenever priorities must be re-evaluated
+    std::chrono::steady_clock::time_point mLastEpochTime;
+    tg::pos3 mLastEpochPos;
+
+    /// finished and cancelled jobs (consumed by the render thread)
+    /// (nodes from std::allocator: the pool mutex would be shared by the render thread and all workers)
+    MpscQueue<FinishedJob> mFinished;
+
+    /// mesher used for new mesh jobs
+    std::atomic<MeshingMode> mMeshingMode = {MeshingMode::Greedy};
 
 public:
-    TerrainWorker(World* world);
+    /// threadCount <= 0 means "one thread per hardware thread minus the render thread"
+    TerrainWorker(World* world, int threadCount = 0);
 
     /// stops this worker
     void stop();
@@ -70,9 +157,61 @@ public:
 
     // enqueue a new job
     void enqueueGen(SharedChunk chunk);
-    void enqueueMesh(SharedChunk chunk, std::vector<Block> blocks);
+    /// meshes the given sections (bit mask), the version is the one returned by Chunk::beginMeshUpdate
+    /// (blockRevision >= 0: the chunk blocks are dense and a compacted copy is handed back, see Chunk::notifyCompactedBlocks)
+    void enqueueMesh(SharedChunk chunk,
+                     PooledVector<Block> blocks,
+                     int version,
+                     int sections,
+                     bool isEdit = false,
+                     int blockRevision = -1);
+    /// downsamples and meshes a LOD cell
+    void enqueueLod(SharedLodCell cell);
+
+    /// updates the camera that all priorities are based on
+    /// (re-evaluates the priorities of queued jobs if the camera moved)
+    void notifyCamera(tg::pos3 pos, float renderDistance, FrustumCuller const* frustum);
+
+    /// number of worker threads
+    int getThreadCount() const { return (int)mThreads.size(); }
+
+    /// mesher used for all following mesh jobs
+    void setMeshingMode(MeshingMode mode) { mMeshingMode = mode; }
+    MeshingMode getMeshingMode() const { return mMeshingMode; }
+
+    /// distance between a position and the chunk starting at chunkPos
+    /// if horizontal is true, only x and z are considered
+    static float chunkDistance(tg::ipos3 chunkPos, tg::pos3 pos, bool horizontal);
+
+    /// extra distance beyond the render distance before jobs are cancelled
+    static constexpr float cancelMargin = 2.0f * CHUNK_SIZE;
 
 private:
-    /// thread executio
-    void run();
+    /// computes the priority of a job
+    /// returns false if the job should be cancelled
+    static bool prioritize(Job& job, CameraInfo const& cam);
+
+    /// submits a job to the workers (render thread)
+    void push(Job job);
+    /// submits jobs that did not fit into the submit queue before (render thread)
+    void flushOverflow();
+    /// wakes up a sleeping thread (if any)
+    void wakeOne();
+
+    /// reports a cancelled job
+    void cancel(Job& job);
+
+    /// re-evaluates the priorities of a queue if the camera changed
+    /// CAUTION: queue must be locked
+    void refresh(WorkerQueue& q);
+
+    /// gets a job from the own queue or steals one from another thread
+    /// returns false if no job is available
+    bool pop(int threadIdx, Job& job);
+
+    /// executes a single job
+    void process(Job& job);
+
+    /// thread execution
+    void run(int threadIdx);
 };
@@ -6,15 +6,23 @@
 
 #include <glow/objects/ArrayBufferAttribute.hh>
 
-/// Position is stored separately
+/// Compact terrain vertex (8 bytes, 4 per quad, drawn with the shared quad indices, see TerrainMesh.hh)
 struct TerrainVertex
 {
+    /// chunk-local position (x | y << 6 | z << 12), each coordinate in 0..CHUNK_SIZE
+    /// (the chunk position is passed as uniform uChunkPos)
+    int position;
+    /// vertex idx, direction, AO, edges, and quad size (see MeshGenerator.cc and terrain.vsh)
     int flags;
 
+    static int packPosition(int x, int y, int z) { return x | y << 6 | z << 12; }
+    static tg::ipos3 unpackPosition(int position) { return {position & 63, (position >> 6) & 63, (position >> 12) & 63}; }
+
     static std::vector<glow::ArrayBufferAttribute> attributes()
     {
         return {
-            {&TerrainVertex::flags, "aFlags"}, //
+            {&TerrainVertex::position, "aPosition"}, //
+            {&TerrainVertex::flags, "aFlags"},       //
         };
     }
 };
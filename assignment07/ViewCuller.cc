@@ -0,0 +1,145 @@
+#include "ViewCuller.hh"
+
+#include <limits>
+
+#include <typed-geometry/tg.hh>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VIEW_CULLER_SSE 1
+#include <emmintrin.h>
+#endif
+
+void ViewCuller::clear()
+{
+    mViewCount = 0;
+    for (auto v = 0; v < maxViews; ++v)
+    {
+        // unused lanes accept everything (they are masked out anyway)
+        for (auto k = 0; k < 6; ++k)
+        {
+            mPlaneX[k][v] = 0;
+            mPlaneY[k][v] = 0;
+            mPlaneZ[k][v] = 0;
+            mPlaneW[k][v] = 1;
+        }
+        mPosX[v] = 0;
+        mPosY[v] = 0;
+        mPosZ[v] = 0;
+        mRangeSqr[v] = std::numeric_limits<float>::infinity();
+    }
+}
+
+int ViewCuller::addView(tg::mat4 const& viewProj, tg::pos3 pos, float range, bool frustum)
+{
+    TG_ASSERT(mViewCount < maxViews && "too many views");
+    auto v = mViewCount++;
+
+    // clip space: -w <= x, y, z <= w, i.e. (row3 +- row_i) . p >= 0
+    if (frustum)
+    {
+        auto row = [&](int r) { return tg::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]); };
+        for (auto i = 0; i < 3; ++i)
+            for (auto s : {0, 1})
+            {
+                auto p = s == 0 ? row(3) + row(i) : row(3) - row(i);
+                auto k = i * 2 + s;
+                mPlaneX[k][v] = -p.x;
+                mPlaneY[k][v] = -p.y;
+                mPlaneZ[k][v] = -p.z;
+                mPlaneW[k][v] = p.w;
+            }
+    }
+
+    mPosX[v] = pos.x;
+    mPosY[v] = pos.y;
+    mPosZ[v] = pos.z;
+    setRange(v, range);
+    return v;
+}
+
+void ViewCuller::setRange(int view, float range)
+{
+    mRangeSqr[view] = range < 0 ? std::numeric_limits<float>::infinity() : range * range;
+}
+
+ViewMask ViewCuller::test(tg::pos3 amin, tg::pos3 amax, ViewMask views, ViewMask& inside) const
+{
+    auto c = (amin + amax) * 0.5f;
+    auto e = (amax - amin) * 0.5f;
+
+#ifdef VIEW_CULLER_SSE
+    auto const absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    auto const zero = _mm_setzero_ps();
+    auto abs = [&](__m128 v) { return _mm_and_ps(v, absMask); };
+
+    auto cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+    auto ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+
+    // frustum: distance of the center to the plane vs. projected extent of the box
+    auto out = zero;
+    auto in = _mm_cmpeq_ps(zero, zero);
+    for (auto k = 0; k < 6; ++k)
+    {
+        auto nx = _mm_load_ps(mPlaneX[k]), ny = _mm_load_ps(mPlaneY[k]), nz = _mm_load_ps(mPlaneZ[k]);
+        auto w = _mm_load_ps(mPlaneW[k]);
+
+        auto d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, nx), _mm_mul_ps(cy, ny)), _mm_mul_ps(cz, nz));
+        auto r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, abs(nx)), _mm_mul_ps(ey, abs(ny))), _mm_mul_ps(ez, abs(nz)));
+
+        out = _mm_or_ps(out, _mm_cmpgt_ps(_mm_sub_ps(d, r), w));
+        in = _mm_and_ps(in, _mm_cmple_ps(_mm_add_ps(d, r), w));
+    }
+
+    // render distance: nearest and farthest point of the box
+    auto dx = _mm_sub_ps(_mm_load_ps(mPosX), cx);
+    auto dy = _mm_sub_ps(_mm_load_ps(mPosY), cy);
+    auto dz = _mm_sub_ps(_mm_load_ps(mPosZ), cz);
+    auto nearX = _mm_max_ps(_mm_sub_ps(abs(dx), ex), zero);
+    auto nearY = _mm_max_ps(_mm_sub_ps(abs(dy), ey), zero);
+    auto nearZ = _mm_max_ps(_mm_sub_ps(abs(dz), ez), zero);
+    auto farX = _mm_add_ps(abs(dx), ex);
+    auto farY = _mm_add_ps(abs(dy), ey);
+    auto farZ = _mm_add_ps(abs(dz), ez);
+    auto nearSqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nearX, nearX), _mm_mul_ps(nearY, nearY)), _mm_mul_ps(nearZ, nearZ));
+    auto farSqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(farX, farX), _mm_mul_ps(farY, farY)), _mm_mul_ps(farZ, farZ));
+    auto rangeSqr = _mm_load_ps(mRangeSqr);
+
+    out = _mm_or_ps(out, _mm_cmpgt_ps(nearSqr, rangeSqr));
+    in = _mm_and_ps(in, _mm_cmple_ps(farSqr, rangeSqr));
+
+    auto visible = ViewMask(~_mm_movemask_ps(out) & views);
+    inside = ViewMask(_mm_movemask_ps(in) & visible);
+    return visible;
+#else
+    ViewMask visible = 0;
+    inside = 0;
+    for (auto v = 0; v < mViewCount; ++v)
+    {
+        if (!(views >> v & 1))
+            continue;
+
+        auto isOut = false;
+        auto isIn = true;
+        for (auto k = 0; k < 6; ++k)
+        {
+            auto d = c.x * mPlaneX[k][v] + c.y * mPlaneY[k][v] + c.z * mPlaneZ[k][v];
+            auto r = e.x * tg::abs(mPlaneX[k][v]) + e.y * tg::abs(mPlaneY[k][v]) + e.z * tg::abs(mPlaneZ[k][v]);
+            isOut = isOut || d - r > mPlaneW[k][v];
+            isIn = isIn && d + r <= mPlaneW[k][v];
+        }
+
+        auto d = tg::abs(tg::vec3(mPosX[v] - c.x, mPosY[v] - c.y, mPosZ[v] - c.z));
+        auto nearest = tg::max(d - e, tg::vec3::zero);
+        auto farthest = d + e;
+        isOut = isOut || dot(nearest, nearest) > mRangeSqr[v];
+        isIn = isIn && dot(farthest, farthest) <= mRangeSqr[v];
+
+        if (isOut)
+            continue;
+        visible |= ViewMask(1 << v);
+        if (isIn)
+            inside |= ViewMask(1 << v);
+    }
+    return visible;
+#endif
+}
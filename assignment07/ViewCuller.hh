@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#include <typed-geometry/tg-lean.hh>
+
+/// set of views of a ViewCuller (bit i is view i)
+using ViewMask = uint8_t;
+
+/**
+ * @brief Tests bounding boxes against several views at once (e.g. the camera and all shadow cascades)
+ *
+ * Every view has a frustum (the planes of its view-projection matrix)
+ * and optionally a render distance around its position.
+ * The planes are stored as structure of arrays with one lane per view,
+ * so a box is tested against all views in one pass over the 6 planes (SSE on x86, scalar otherwise).
+ *
+ * Unlike FrustumCuller, boxes are tested exactly against the planes (not their bounding spheres).
+ * The tests are therefore monotone: a box is rejected by every view that rejects a larger box containing it,
+ * as required by BoundsGrid::queryWithState.
+ */
+class ViewCuller
+{
+public:
+    static constexpr int maxViews = 4;
+
+private:
+    /// planes of all views, dot(n, p) <= w inside (unnormalized)
+    alignas(16) float mPlaneX[6][maxViews];
+    alignas(16) float mPlaneY[6][maxViews];
+    alignas(16) float mPlaneZ[6][maxViews];
+    alignas(16) float mPlaneW[6][maxViews];
+
+    /// position and squared render distance of all views
+    alignas(16) float mPosX[maxViews];
+    alignas(16) float mPosY[maxViews];
+    alignas(16) float mPosZ[maxViews];
+    alignas(16) float mRangeSqr[maxViews];
+
+    int mViewCount = 0;
+
+public:
+    ViewCuller() { clear(); }
+
+    /// removes all views
+    void clear();
+
+    /// adds a view, returns its index
+    /// range < 0 means no render distance, without frustum only the render distance is tested
+    int addView(tg::mat4 const& viewProj, tg::pos3 pos, float range, bool frustum = true);
+
+    /// changes the render distance of a view (< 0 means none)
+    void setRange(int view, float range);
+
+    /// returns the subset of the given views that (potentially) see the box
+    /// inside is set to the ones of them that contain the box completely (frustum and render distance)
+    ViewMask test(tg::pos3 amin, tg::pos3 amax, ViewMask views, ViewMask& inside) const;
+
+public: // accessor functions
+    int getViewCount() const { return mViewCount; }
+    ViewMask getAllViews() const { return ViewMask((1 << mViewCount) - 1); }
+};
@@ -1,5 +1,6 @@
 #include "World.hh"
 
+#include <algorithm>
 #include <fstream>
 
 #include <glow-extras/timing/CpuTimer.hh>
@@ -13,16 +14,27 @@
 #include <cstdlib>
 #include <cstring>
 
-#include "helper/Noise.hh"
-
 #include "Chunk.hh"
 #include "Material.hh"
 
-World::World() : mWorker(this) {}
+// 64 x 32 x 64 chunks: covers the maximum render distance horizontally and all columns vertically
+World::World(int workerThreads) : mChunkGrid({64, 32, 64}), mWorker(this, workerThreads), mLod(this) {}
 
 World::~World()
 {
     mWorker.stop();
+
+    // remaining edits (written when the store is destroyed)
+    saveEditedChunks();
+}
+
+void World::enablePersistence(std::string const& directory)
+{
+    if (!chunks.empty())
+        glow::warning() << "Persistence enabled after chunks were created";
+
+    glow::info() << "Storing chunks in " << directory;
+    mStore.reset(new RegionStore(directory));
 }
 
 void World::init()
@@ -31,7 +43,7 @@ void World::init()
     setUpMaterials();
 
     // configure world gen
-    mNoiseGen.SetNoiseType(FastNoise::SimplexFractal);
+    mGenerator.setMaterials(materialsOpaque, materialsTranslucent);
 }
 
 void World::setUpMaterials()
@@ -98,6 +110,14 @@ void World::setUpMaterials()
 
     addTranslucentMat("crystal", all(crystalRM));
     addTranslucentMat("water", all(waterRM));
+
+    // dense ids (copies like dirtRM2 get their own)
+    auto nextId = 0;
+    for (auto mats : {&materialsOpaque, &materialsTranslucent})
+        for (auto const& mat : *mats)
+            for (auto const& rm : mat.renderMaterials)
+                if (rm->id < 0)
+                    rm->id = nextId++;
 }
 
 void World::triggerMeshUpdate(SharedChunk chunk)
@@ -105,25 +125,46 @@ void World::triggerMeshUpdate(SharedChunk chunk)
     if (!chunk->isGenerated())
         return; // not generated -> no mesh
 
+    auto sections = chunk->mDirtySections;
+    if (sections == 0)
+        return; // meshes are up to date
+
     GLOW_ACTION();
 
+    // range of dirty sections
+    auto lo = 0;
+    while (!(sections >> lo & 1))
+        ++lo;
+    auto hi = CHUNK_SECTIONS;
+    while (!(sections >> (hi - 1) & 1))
+        --hi;
+
     // build blocks
+    // (all blocks of the chunk itself for the visibility information,
+    //  of the neighbors only the rows of the dirty sections and their border, the rest stays invalid)
     auto cs = CHUNK_SIZE + 2;
-    std::vector<Block> blocks(cs * cs * cs, Block::invalid());
+    PooledVector<Block> blocks(cs * cs * cs, Block::invalid());
     auto bmin = chunk->chunkPos - 1;
     auto bmax = chunk->chunkPos + CHUNK_SIZE + 1;
+    bmin.y = chunk->chunkPos.y + lo * CHUNK_SECTION_HEIGHT - 1;
+    bmax.y = chunk->chunkPos.y + hi * CHUNK_SECTION_HEIGHT + 1;
     for (auto dz : {-1, 0, 1})
         for (auto dy : {-1, 0, 1})
             for (auto dx : {-1, 0, 1})
             {
                 auto cp = chunk->chunkPos + CHUNK_SIZE * tg::ivec3(dx, dy, dz);
                 auto c = queryChunk(cp);
-                if (!c)
-                    continue;
+                if (!c || !c->isGenerated())
+                    continue; // blocks of non-generated chunks are still written by a worker thread
 
                 // copy blocks
                 auto min = clamp(c->chunkPos, bmin, bmax) - c->chunkPos;
                 auto max = clamp(c->chunkPos + CHUNK_SIZE, bmin, bmax) - c->chunkPos;
+                if (c == chunk.get())
+                {
+                    min.y = 0;
+                    max.y = CHUNK_SIZE;
+                }
 
                 auto xCount = max.x - min.x;
 
@@ -135,15 +176,19 @@ void World::triggerMeshUpdate(SharedChunk chunk)
                         auto tminx = min.x + dx * CHUNK_SIZE + 1;
 
                         // copy line
-                        memcpy(&blocks[(tz * cs + ty) * cs + tminx], &c->block({min.x, y, z}), xCount * sizeof(Block));
+                        c->copyBlockRow({min.x, y, z}, xCount, &blocks[(tz * cs + ty) * cs + tminx]);
                     }
             }
 
     // bump mesh version
-    chunk->mMeshVersion++;
+    auto version = chunk->beginMeshUpdate(sections);
 
     // enqueue job
-    mWorker.enqueueMesh(chunk, std::move(blocks));
+    // (dense chunks are compacted by the worker, see Chunk::notifyCompactedBlocks)
+    auto blockRevision = chunk->mBlocks.getKind() == BlockStorage::Kind::Dense ? chunk->mBlockRevision : -1;
+    mWorker.enqueueMesh(chunk, std::move(blocks), version, sections, chunk->mIsEdited, blockRevision);
+    chunk->mIsEdited = false;
+    chunk->mDirtySections = 0;
 }
 
 void World::ensureChunkAt(tg::ipos3 p)
@@ -154,16 +199,78 @@ void World::ensureChunkAt(tg::ipos3 p)
 
     // create chunk
     auto c = Chunk::create(cp, this);
+    c->mLastUsedTime = mTime;
 
     // register chunk
     chunks[cp] = c;
+    mColumns.retain(cp);
+    if (auto cell = mChunkGrid.find(chunkCoord(cp)))
+        cell->chunk = c.get();
 
     // send to worker
     mWorker.enqueueGen(c);
 }
 
-void World::notifyCameraPosition(tg::pos3 pos, float renderDistance, int maxChunksPerFrame)
+void World::notifyCameraPosition(tg::pos3 pos, float renderDistance, FrustumCuller const* frustum)
 {
+    mCameraPos = pos;
+
+    // move the chunk grid along
+    // (only horizontally, vertically the window covers all columns between -maxHeight and maxHeight)
+    auto center = chunkCoord(chunkPos(tg::ipos3(tg::floor(pos))));
+    center.y = 0;
+    mChunkGrid.recenter(center, [this](tg::ipos3 cell) -> ChunkCell {
+        auto it = chunks.find(cell * CHUNK_SIZE);
+        return {it == chunks.end() ? nullptr : it->second.get()};
+    });
+
+    // distant terrain
+    // (selects the chunk columns drawn at full resolution: all within the render distance and a few beyond)
+    if (lodSettings.enabled)
+        mLod.update(pos, renderDistance, lodSettings.distance);
+    else if (mLod.isActive())
+        mLod.clear();
+    auto streamDistance = mLod.isActive() ? tg::max(renderDistance, mLod.getStreamDistance()) : renderDistance;
+    mRenderDistance = streamDistance;
+
+    // update priorities
+    mWorker.notifyCamera(pos, streamDistance, frustum);
+
+    // re-enqueue cancelled jobs that are back in range
+    // (a bit closer than the cancel distance to avoid thrashing)
+    auto reenqueueDis = streamDistance + CHUNK_SIZE;
+    for (auto i = (int)mParkedGen.size() - 1; i >= 0; --i)
+    {
+        auto c = mParkedGen[i];
+        if (TerrainWorker::chunkDistance(c->chunkPos, pos, true) > reenqueueDis)
+            continue;
+
+        c->mIsParked = false;
+        mWorker.enqueueGen(c);
+        mParkedGen[i] = mParkedGen.back();
+        mParkedGen.pop_back();
+    }
+    for (auto i = (int)mParkedMesh.size() - 1; i >= 0; --i)
+    {
+        auto c = mParkedMesh[i];
+        if (TerrainWorker::chunkDistance(c->chunkPos, pos, false) > reenqueueDis)
+            continue;
+
+        c->mIsParked = false;
+        triggerMeshUpdate(c);
+        mParkedMesh[i] = mParkedMesh.back();
+        mParkedMesh.pop_back();
+    }
+
+    // only the columns selected by the LOD (the others would never be drawn)
+    // (only trigger one chunk per column, rest is done after generation)
+    if (mLod.isActive())
+    {
+        for (auto const& column : mLod.getStreamedColumns())
+            ensureChunkAt(tg::ipos3(column.x, 0, column.y));
+        return;
+    }
+
     // spiral pattern
     for (auto dis = 0; dis < renderDistance + CHUNK_SIZE * 2; dis += CHUNK_SIZE)
         for (auto dx = -dis; dx <= dis; dx += CHUNK_SIZE)
@@ -190,7 +297,41 @@ void World::clearChunks()
 {
     // removes all chunks
     // due to shared_ptr's also clears all associated memory
+    // (pending jobs may still hold some chunks)
+    saveEditedChunks();
+    for (auto const& chunkPair : chunks)
+    {
+        // release the meshes here (see removeChunk), a worker might drop the last reference
+        auto& chunk = *chunkPair.second;
+        chunk.mIsEvicted = true;
+        chunk.beginMeshUpdate(CHUNK_ALL_SECTIONS);
+        chunk.mMeshes.clear();
+        chunk.mMeshMemory = 0;
+    }
     chunks.clear();
+    mChunkGrid.clear({});
+    mChunkBounds.clear();
+    mColumns.clear();
+    mDirtyChunks.clear();
+    mParkedGen.clear();
+    mParkedMesh.clear();
+    mLod.clear();
+}
+
+void World::setMeshingMode(MeshingMode mode)
+{
+    if (mode == mWorker.getMeshingMode())
+        return;
+
+    mWorker.setMeshingMode(mode);
+
+    // LOD cells are built anew on the next update
+    mLod.clear();
+
+    // remesh everything with the new mesher
+    for (auto const& chunkPair : chunks)
+        if (chunkPair.second->isGenerated())
+            chunkPair.second->markDirty();
 }
 
 void World::notifyDirtyChunk(Chunk* chunk)
@@ -201,6 +342,9 @@ void World::notifyDirtyChunk(Chunk* chunk)
 
 void World::notifyChunkGenerated(SharedChunk c)
 {
+    if (c->mIsEvicted)
+        return; // chunk was removed in the meantime
+
     // chunk is now generated
     c->mIsGenerated = true;
 
@@ -217,31 +361,75 @@ void World::notifyChunkGenerated(SharedChunk c)
     // do CPU update
     c->update();
 
+    // fail safe: no endless columns
+    // (uniform chunks are cheap, but each chunk is still a map entry and a job)
+    auto const maxHeight = 512;
+    auto canGrowUp = c->chunkPos.y + CHUNK_SIZE < maxHeight;
+    auto canGrowDown = c->chunkPos.y - CHUNK_SIZE >= -maxHeight;
+
     // trigger gen up
-    if (!c->isFullyAir())
+    if (!c->isFullyAir() && canGrowUp)
         ensureChunkAt(c->chunkPos + tg::ivec3(0, CHUNK_SIZE, 0));
 
     // trigger gen down
-    if (!c->isFullySolid())
+    if (!c->isFullySolid() && canGrowDown)
         ensureChunkAt(c->chunkPos - tg::ivec3(0, CHUNK_SIZE, 0));
 
-    // fail safe
-    if (c->chunkPos.y < -500 || c->chunkPos.y > 500)
+    if ((!c->isFullyAir() && !canGrowUp) || (!c->isFullySolid() && !canGrowDown))
     {
-        glow::info() << "DEEP OR HIGH CHUNK - memory not optimized for this";
-        glow::info() << " at " << c->chunkPos;
-        glow::info() << " is fully air? " << c->isFullyAir();
-        glow::info() << " is fully solid? " << c->isFullySolid();
+        glow::warning() << "DEEP OR HIGH CHUNK - column is not continued";
+        glow::warning() << " at " << c->chunkPos;
         for (auto m : c->queryMaterials())
-            glow::info() << " - contains " << (m ? m->name : "<air>");
-        glow::info() << " aborting before memory issues arise.";
-        exit(0);
+            glow::warning() << " - contains " << (m ? m->name : "<air>");
     }
 }
 
-void World::notifyChunkMeshed(SharedChunk chunk, std::vector<TerrainMeshData> const& data)
+void World::notifyChunkMeshed(SharedChunk chunk,
+                              int sections,
+                              PooledVector<TerrainMeshData> const& data,
+                              int version,
+                              ChunkVisibility const& visibility)
 {
-    chunk->notifyMeshData(data);
+    chunk->notifyMeshData(sections, data);
+    chunk->notifyVisibility(version, visibility);
+    updateChunkBounds(*chunk);
+}
+
+void World::updateChunkBounds(Chunk& chunk)
+{
+    if (chunk.mIsEvicted)
+        return; // the cell might belong to a new chunk already
+
+    auto cell = chunkCoord(chunk.chunkPos);
+    if (chunk.hasContent())
+        mChunkBounds.set(cell, &chunk, chunk.getContentAabbMin(), chunk.getContentAabbMax());
+    else
+        mChunkBounds.remove(cell);
+}
+
+void World::notifyLodCellBuilt(SharedLodCell const& cell, std::vector<LodCubeData> const& cubes)
+{
+    mLod.notifyCellBuilt(cell, cubes);
+}
+
+void World::notifyChunkGenCancelled(SharedChunk chunk)
+{
+    if (chunk->mIsEvicted)
+        return; // chunk was removed in the meantime
+
+    // chunk stays registered (but not generated) until it is back in range
+    if (!chunk->mIsParked)
+        mParkedGen.push_back(chunk);
+    chunk->mIsParked = true;
+}
+
+void World::notifyChunkMeshCancelled(SharedChunk chunk, int sections)
+{
+    // old mesh stays until the chunk is back in range
+    chunk->mDirtySections |= sections;
+    if (!chunk->mIsParked)
+        mParkedMesh.push_back(chunk);
+    chunk->mIsParked = true;
 }
 
 void World::update(float elapsedSeconds)
@@ -267,6 +455,145 @@ void World::update(float elapsedSeconds)
 
     // update worker
     mWorker.update();
+
+    // write edits in batches
+    mSaveCountdown -= elapsedSeconds;
+    if (mSaveCountdown < 0)
+    {
+        saveEditedChunks();
+        mSaveCountdown = 1.0f;
+    }
+
+    // keep the number of resident chunks bounded
+    mTime += elapsedSeconds;
+    mEvictionCountdown -= elapsedSeconds;
+    if (mEvictionCountdown < 0)
+    {
+        evictChunks();
+        mEvictionCountdown = 0.25f;
+    }
+
+    // bounds of meshed and removed chunks
+    mChunkBounds.refresh();
+
+    // keep the terrain vertices compact (a few MB of GPU copies a few times per second at most)
+    mDefragmentCountdown -= elapsedSeconds;
+    if (mDefragmentCountdown < 0)
+    {
+        mTerrainArena->defragment(4 * 1024 * 1024);
+        mDefragmentCountdown = 0.25f;
+    }
+}
+
+void World::saveEditedChunks()
+{
+    // only queues snapshots, the region store writes them on its own thread
+    for (auto const& c : mUnsavedChunks)
+    {
+        if (mStore && !c->mIsEvicted)
+            mStore->save(c->chunkPos, c->mBlocks);
+        c->mNeedsSave = false;
+    }
+    mUnsavedChunks.clear();
+}
+
+void World::evictChunks()
+{
+    if (mRenderDistance < 0)
+        return; // no camera yet
+
+    GLOW_ACTION();
+
+    // columns are generated as a whole, so only x/z are considered
+    auto evictDis = mRenderDistance + chunkBudget.evictionMargin;
+
+    // gather candidates and memory
+    struct Candidate
+    {
+        SharedChunk chunk;
+        float distance;
+    };
+    std::vector<Candidate> candidates;
+    size_t memory = 0;
+    size_t blockMemory = 0;
+    for (auto const& chunkPair : chunks)
+    {
+        auto const& c = chunkPair.second;
+        memory += c->getMemoryUsage();
+        blockMemory += c->getBlockMemory();
+
+        auto dis = TerrainWorker::chunkDistance(c->chunkPos, mCameraPos, true);
+        if (dis <= evictDis)
+            c->mLastUsedTime = mTime;
+        else if (!c->mHasEdits || mStore) // edits are saved on eviction
+            candidates.push_back({c, dis});
+    }
+    mResidentMemory = memory;
+    mResidentBlockMemory = blockMemory;
+
+    auto maxMemory = size_t(chunkBudget.maxMemoryMB) << 20;
+    auto withinBudget = [&] { return (int)chunks.size() <= chunkBudget.maxChunks && memory <= maxMemory; };
+    if (withinBudget())
+        return;
+
+    // least recently used first, then most distant
+    std::sort(candidates.begin(), candidates.end(), [](Candidate const& a, Candidate const& b) {
+        if (a.chunk->mLastUsedTime != b.chunk->mLastUsedTime)
+            return a.chunk->mLastUsedTime < b.chunk->mLastUsedTime;
+        return a.distance > b.distance;
+    });
+
+    for (auto const& cand : candidates)
+    {
+        if (withinBudget())
+            break;
+
+        memory -= cand.chunk->getMemoryUsage();
+        blockMemory -= cand.chunk->getBlockMemory();
+        removeChunk(cand.chunk);
+    }
+    mResidentMemory = memory;
+    mResidentBlockMemory = blockMemory;
+
+    if (!withinBudget())
+        glow::warning() << "Chunk budget exceeded by chunks within the render distance (" << chunks.size() << " chunks, "
+                        << (memory >> 20) << " MB)";
+}
+
+void World::removeChunk(SharedChunk const& chunk)
+{
+    // keep edits
+    if (chunk->mNeedsSave)
+    {
+        if (mStore)
+            mStore->save(chunk->chunkPos, chunk->mBlocks);
+        chunk->mNeedsSave = false;
+        mUnsavedChunks.erase(std::remove(mUnsavedChunks.begin(), mUnsavedChunks.end(), chunk), mUnsavedChunks.end());
+    }
+
+    // discard results of pending jobs
+    // (mesh results are already dropped by the worker because of the version)
+    chunk->mIsEvicted = true;
+    chunk->beginMeshUpdate(CHUNK_ALL_SECTIONS);
+
+    // release GPU buffers now, pending jobs might keep the chunk alive for a while
+    chunk->mMeshes.clear();
+    chunk->mMeshMemory = 0;
+    mChunkBounds.remove(chunkCoord(chunk->chunkPos));
+
+    // remove all references
+    if (chunk->mIsDirty)
+        mDirtyChunks.erase(std::remove(mDirtyChunks.begin(), mDirtyChunks.end(), chunk.get()), mDirtyChunks.end());
+    if (chunk->mIsParked)
+    {
+        mParkedGen.erase(std::remove(mParkedGen.begin(), mParkedGen.end(), chunk), mParkedGen.end());
+        mParkedMesh.erase(std::remove(mParkedMesh.begin(), mParkedMesh.end(), chunk), mParkedMesh.end());
+    }
+
+    if (auto cell = mChunkGrid.find(chunkCoord(chunk->chunkPos)))
+        cell->chunk = nullptr;
+    mColumns.release(chunk->chunkPos);
+    chunks.erase(chunk->chunkPos);
 }
 
 Material& World::addOpaqueMat(std::string const& name, std::vector<SharedRenderMaterial> renderMats)
@@ -327,191 +654,103 @@ void World::copyRenderMaterials(Material& mat, const std::vector<SharedRenderMat
     }
 }
 
-namespace
-{
-uint32_t wang_hash(uint32_t seed)
+void World::generate(Chunk& c)
 {
-    seed = (seed ^ 61u) ^ (seed >> 16u);
-    seed *= 9u;
-    seed = seed ^ (seed >> 4u);
-    seed *= 0x27D4EB2Du;
-    seed = seed ^ (seed >> 15u);
-    return seed;
+    // 2D terrain (shared by all chunks of the column)
+    auto column = mColumns.acquire(c.chunkPos, [&](TerrainColumn& col) { mGenerator.generateColumn(c.chunkPos, col); });
+
+    mGenerator.generate(c.chunkPos, *column, c.mBlocks);
+
+    // we changed everything!
+    // (the chunk is marked dirty in notifyChunkGenerated, the dirty list must only be touched by the render thread)
 }
 
-float getRandFloat01Wang(tg::ivec3 relPos)
+void World::loadOrGenerate(Chunk& c)
 {
-    uint32_t seed = ((relPos.x * 123) + relPos.y) * 5 + relPos.z;
-    return float(wang_hash(seed)) / std::numeric_limits<uint32_t>::max();
+    // stored chunks skip generation entirely
+    if (!mStore || !mStore->load(c.chunkPos, c.mBlocks))
+    {
+        generate(c);
+
+        if (mStore)
+            mStore->save(c.chunkPos, c.mBlocks);
+    }
+
+    // once per chunk, edits update the statistics incrementally
+    c.computeStats();
 }
-} // namespace
-void World::generate(Chunk& c)
-{
-    GLOW_ACTION("[WORKER] - generate chunk");
 
-    auto matAir = nullptr;
-    auto matGrass = getMaterialFromName("grass");
-    auto matDirt = getMaterialFromName("dirt");
-    auto matRock = getMaterialFromName("rock");
-    auto matSand = getMaterialFromName("sand");
-    auto matSnow = getMaterialFromName("snow");
-    auto matSnowRock = getMaterialFromName("snowrock");
+void World::updateVisibility(tg::pos3 camPos, float distance)
+{
+    GLOW_ACTION();
 
-    auto matGold = getMaterialFromName("gold");
-    auto matCopper = getMaterialFromName("copper");
-    auto matBronze = getMaterialFromName("bronze");
+    ++mVisibilityUpdate;
+    mVisibilityCenter = camPos;
+    mVisibilityDistance = distance;
+    mPotentiallyVisibleChunks = 0;
 
-    auto matWater = getMaterialFromName("water");
-    auto matCrystal = getMaterialFromName("crystal");
-    auto matLightFountain = getMaterialFromName("lightfountain");
+    // reached cells are stamped with mVisibilityUpdate in the chunk grid
+    // (cells outside the grid window are not searched, isChunkPotentiallyVisible keeps their chunks)
+    auto& queue = mVisibilitySteps;
+    queue.clear();
 
+    auto start = chunkPos(tg::ipos3(tg::floor(camPos)));
+    if (auto cell = mChunkGrid.find(chunkCoord(start)))
+    {
+        cell->visibilityUpdate = mVisibilityUpdate;
+        queue.push_back({start, -1, 0});
+    }
+    for (auto i = 0u; i < queue.size(); ++i)
+    {
+        auto const step = queue[i];
 
-    // TODO: cooler
+        // missing or unmeshed chunks do not block the view
+        auto connectivity = allFacesConnected;
+        if (auto c = mChunkGrid.find(chunkCoord(step.chunkPos))->chunk)
+        {
+            connectivity = c->mVisibility.connectivity;
+            ++mPotentiallyVisibleChunks;
+        }
 
-    for (auto z = 0; z < CHUNK_SIZE; ++z)
-        for (auto y = 0; y < CHUNK_SIZE; ++y)
-            for (auto x = 0; x < CHUNK_SIZE; ++x)
-            {
-                auto rp = tg::ivec3(x, y, z);
-                auto ip = c.chunkPos + rp;
-                auto p = tg::pos3(ip);
-
-                // terrain options
-                const auto waterDepthFactor = 3.0;
-                const auto hillHeightFactor = 8.0;
-                const auto flatLandFactor = 0.3;
-                auto seaLevel = 0;
-
-                // generate terrain
-                auto d = 25 * (mNoiseGen.GetPerlinFractal(2.0 * p.x, 2.0 * p.z) + 0.15);
-                if (d < 0)
-                    d *= waterDepthFactor;
-                else
-                    d *= tg::mix(flatLandFactor, hillHeightFactor,
-                                  tg::smoothstep(0.5, 0.7, 0.5 + 0.5 * mNoiseGen.GetPerlinFractal(.17 * p.x, .18 * p.z)));
-
-                // choose material depending on terrain height
-                Material const* mat = matAir;
-                if (p.y <= d)
-                {
-                    if (p.y < 1)
-                        mat = matSand;
-                    else
-                    {
-                        auto grassDist = 6 + 4 * mNoiseGen.GetPerlinFractal(15.17 * p.x, 17.18 * p.z);
-                        if (p.y < grassDist)
-                        {
-                            mat = matGrass;
-
-                            // Avoid grass below the surface
-                            if (y > 0)
-                            {
-                                Block& below = c.block(tg::ivec3(x, y - 1, z));
-                                if (below.mat == matGrass->index)
-                                    below.mat = matDirt->index;
-                            }
-                        }
-                        else
-                        {
-                            auto snowDist = 12 + 3 * mNoiseGen.GetPerlinFractal(5.17 * p.x, 7.18 * p.z);
-                            if (p.y > snowDist)
-                                mat = matSnow;
-                            else if (p.y > snowDist - 3)
-                            {
-                                mat = matSnowRock;
-                            }
-                            else
-                                mat = matRock;
-                        }
-
-                        if (mat != matAir)
-                        {
-                            // Avoid snow and gras below surface (except snow below snow)
-                            if (y > 0)
-                            {
-                                Block& below = c.block(tg::ivec3(x, y - 1, z));
-
-                                if (mat != matSnow && (below.mat == matSnowRock->index || below.mat == matSnow->index))
-                                {
-                                    // Snow inconsistency
-                                    below.mat = matRock->index;
-                                }
-                                else if (below.mat == matGrass->index)
-                                {
-                                    // No grass below surface
-                                    below.mat = matDirt->index;
-                                }
-                            }
-                        }
-                    }
+        for (auto face = 0; face < 6; ++face)
+        {
+            if (step.faces >> (face ^ 1) & 1)
+                continue; // towards the camera
 
-                    // Not in flat regions or in water
-                    if (p.y >= -20 && d > 3)
-                    {
-                        auto cd = mNoiseGen.GetValue(12.1 * p.x, 5.1 * p.y, 9.6 * p.z);
-                        // Have some small chance to generate crystal
-                        if (cd > 0.8)
-                            mat = matCrystal;
-                        else
-                        {
-                            bool belowIsRock = false;
-                            if (y > 0) // still in this chunk
-                                belowIsRock = c.block(tg::ivec3(x, y - 1, z)).mat == matRock->index;
-                            else // other chunk
-                                belowIsRock = queryBlock(tg::ipos3(ip.x, ip.y - 1, ip.z)).mat == matRock->index;
-
-                            // other minerals lie mainly below hills but only on rock material
-                            if (d > 8 && belowIsRock)
-                            {
-                                cd = mNoiseGen.GetValue(5 + 17.3 * p.x, 4 + 23.1 * p.y, -18 + 15.6 * p.z);
-                                if (cd > 0.9)
-                                    mat = matGold;
-                                else
-                                {
-                                    cd = mNoiseGen.GetValue(10.0 * p.z, 9.1 * p.x, 11.0 * p.y);
-                                    if (cd > 0.9)
-                                        mat = matCopper;
-                                    else if (-cd > 0.9)
-                                        mat = matBronze;
-                                }
-                            }
-                        }
-                    }
-                }
+            if (step.entryFace >= 0 && !facesConnected(connectivity, step.entryFace, face))
+                continue; // no path through the chunk
 
-                // water plane
-                if (mat == matAir)
-                {
-                    if (p.y <= seaLevel)
-                        mat = matWater;
-                    else if (p.y <= 20 && y > 0)
-                    {
-                        Block const& below = c.block(tg::ivec3(x, y - 1, z));
-                        if (!below.isInvalid() && below.isSolid())
-                        {
-                            const float spawnChance = 1 / 4000.0f;
-                            if (getRandFloat01Wang(rp) < spawnChance)
-                                mat = matLightFountain;
-                        }
-                    }
-                }
+            auto next = step.chunkPos + faceDirection(face) * CHUNK_SIZE;
+            if (TerrainWorker::chunkDistance(next, camPos, false) > distance)
+                continue; // out of range
 
-                // assign material
-                c.block(rp).mat = mat ? mat->index : 0;
-            }
+            auto cell = mChunkGrid.find(chunkCoord(next));
+            if (!cell || cell->visibilityUpdate == mVisibilityUpdate)
+                continue; // outside the window or already reached
+            cell->visibilityUpdate = mVisibilityUpdate;
 
-    // we changed everything!
-    c.markDirty();
+            queue.push_back({next, face ^ 1, step.faces | 1 << face});
+        }
+    }
 }
 
-Chunk* World::queryChunk(tg::ipos3 p) const
+bool World::isChunkPotentiallyVisible(Chunk const& chunk) const
 {
-    auto it = chunks.find(chunkPos(p));
+    if (mVisibilityDistance < 0)
+        return true;
+
+    auto cell = mChunkGrid.find(chunkCoord(chunk.chunkPos));
+    if (!cell || cell->visibilityUpdate == mVisibilityUpdate)
+        return true; // not searched or reached
 
-    if (it == chunks.end())
-        return nullptr;
+    // the search only covers its distance
+    return TerrainWorker::chunkDistance(chunk.chunkPos, mVisibilityCenter, false) > mVisibilityDistance;
+}
 
-    return it->second.get();
+std::vector<LodCubeData> World::buildLod(LodCell const& cell, MeshingMode mode)
+{
+    // stored chunks include the edits (pending saves are missing until they are written)
+    return buildLodCell(cell.level, cell.origin, mGenerator, mColumns, mStore.get(), mode);
 }
 
 Chunk& World::queryChunkAlloc(tg::ipos3 p)
@@ -522,40 +761,80 @@ Chunk& World::queryChunkAlloc(tg::ipos3 p)
     return *c;
 }
 
-const Block& World::queryBlock(tg::ipos3 p) const
+Block World::queryBlock(tg::ipos3 p) const
 {
-    static Block invalid = Block::invalid();
-
-    auto cp = chunkPos(p);
-    auto it = chunks.find(cp);
+    auto c = queryChunk(p);
 
-    if (it == chunks.end())
-        return invalid;
+    if (!c || !c->isGenerated())
+        return Block::invalid();
 
-    return it->second->block(p - cp);
+    return c->block(p - c->chunkPos);
 }
 
-Block& World::queryBlockMutable(tg::ipos3 p)
+bool World::setBlock(tg::ipos3 p, Block b)
 {
     auto& c = queryChunkAlloc(p);
-    return c.block(p - c.chunkPos);
+
+    // blocks of non-generated chunks are still written by a worker thread
+    // (and would be overwritten anyway)
+    if (!c.isGenerated())
+        return false;
+
+    c.setBlock(p - c.chunkPos, b);
+    return true;
 }
 
 void World::markDirty(tg::ipos3 p, int rad)
 {
-    while (rad >= 0)
-    {
-        for (auto dx : {-1, 1})
-            for (auto dy : {-1, 1})
-                for (auto dz : {-1, 1})
+    // edited blocks (inclusive)
+    auto emin = p - rad;
+    auto emax = p + rad;
+
+    // the mesh of a section depends on its blocks and a one block border
+    // (so chunks within one block of the edit are affected)
+    auto cmin = chunkPos(emin - 1);
+    auto cmax = chunkPos(emax + 1);
+    for (auto cz = cmin.z; cz <= cmax.z; cz += CHUNK_SIZE)
+        for (auto cy = cmin.y; cy <= cmax.y; cy += CHUNK_SIZE)
+            for (auto cx = cmin.x; cx <= cmax.x; cx += CHUNK_SIZE)
+            {
+                auto cp = tg::ipos3(cx, cy, cz);
+                auto isEdited = emax.x >= cx && emin.x < cx + CHUNK_SIZE && //
+                                emax.y >= cy && emin.y < cy + CHUNK_SIZE && //
+                                emax.z >= cz && emin.z < cz + CHUNK_SIZE;
+
+                Chunk* c;
+                if (isEdited)
                 {
-                    auto np = p + tg::ivec3(dx, dy, dz) * rad;
-                    auto& c = queryChunkAlloc(np);
-                    c.markDirty();
+                    c = &queryChunkAlloc(cp);
+                    c->mHasEdits = true;
+
+                    // edits of non-generated chunks are discarded (see setBlock)
+                    if (mStore && c->isGenerated() && !c->mNeedsSave)
+                    {
+                        c->mNeedsSave = true;
+                        mUnsavedChunks.push_back(chunks[c->chunkPos]);
+                    }
                 }
+                else if (!(c = queryChunk(cp)))
+                    continue; // no mesh that depends on the edit
 
-        rad -= CHUNK_SIZE;
-    }
+                // sections whose dependency box [cp - 1, cp + section end + 1] intersects the edit
+                auto sections = 0;
+                if (emax.x >= cx - 1 && emin.x <= cx + CHUNK_SIZE && emax.z >= cz - 1 && emin.z <= cz + CHUNK_SIZE)
+                    for (auto s = 0; s < CHUNK_SECTIONS; ++s)
+                    {
+                        auto sy = cy + s * CHUNK_SECTION_HEIGHT;
+                        if (emax.y >= sy - 1 && emin.y <= sy + CHUNK_SECTION_HEIGHT)
+                            sections |= 1 << s;
+                    }
+
+                if (sections == 0)
+                    continue;
+
+                c->mIsEdited = true;
+                c->markDirty(sections);
+            }
 }
 
 Material const* World::getMaterialFromIndex(int matIdx) const
@@ -637,6 +916,8 @@ RayHit World::rayCast(tg::pos3 pos, tg::vec3 dir, float maxRange) const
         // update block
         if (chunk == nullptr)
             hit.block = Block::air();
+        else if (!chunk->isGenerated())
+            hit.block = Block::invalid();
         else
             hit.block = chunk->block(ipos - chunk->chunkPos);
     }
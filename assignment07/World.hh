@@ -1,17 +1,24 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
 #include <typed-geometry/tg-std.hh>
 
 #include "Chunk.hh"
+#include "ColumnCache.hh"
 #include "Material.hh"
-#include "helper/Noise.hh"
+#include "helper/BoundsGrid.hh"
+#include "helper/ToroidalGrid.hh"
 
 #include "Constants.hh"
+#include "FrustumCuller.hh"
 
+#include "RegionStore.hh"
+#include "TerrainGenerator.hh"
+#include "TerrainLod.hh"
 #include "TerrainWorker.hh"
 
 struct RayHit
@@ -36,43 +43,180 @@ public: // public members
     /// list of translucent materials
     std::vector<Material> materialsTranslucent;
 
+    /// resident chunk budget
+    /// once a limit is exceeded, chunks beyond the render distance (plus a margin)
+    /// are evicted in least-recently-used order
+    struct ChunkBudget
+    {
+        int maxChunks = 8192;
+        int maxMemoryMB = 1024; ///< blocks, GPU meshes, and chunk objects
+        float evictionMargin = 3.0f * CHUNK_SIZE; ///< hysteresis beyond the render distance
+    };
+    ChunkBudget chunkBudget;
+
+    /// distant terrain as coarse LOD cells (see TerrainLod)
+    /// the chunks are only drawn up to the render distance of notifyCameraPosition
+    struct LodSettings
+    {
+        bool enabled = true;
+        float distance = 512.0f; ///< render distance of the LOD cells
+    };
+    LodSettings lodSettings;
+
 private: // private members
-    /// Noise generator
-    FastNoise mNoiseGen;
+    /// procedural terrain
+    TerrainGenerator mGenerator;
+
+    /// 2D terrain of the columns with resident chunks
+    ColumnCache mColumns;
 
     /// List of chunks that require updating
     std::vector<Chunk*> mDirtyChunks;
 
+    struct ChunkCell
+    {
+        Chunk* chunk = nullptr;
+        int visibilityUpdate = -1; ///< last visibility update (see updateVisibility) that reached the cell
+    };
+
+    /// chunks around the camera, indexed by chunk coordinate (chunkPos / CHUNK_SIZE)
+    /// (secondary index of `chunks` for fast lookups, chunks outside the window are only in `chunks`)
+    ToroidalGrid<ChunkCell> mChunkGrid;
+    bool mUseChunkGrid = true;
+
+    /// vertices of all chunk and LOD meshes (see TerrainArena)
+    /// (shared: meshes keep the arena alive, whatever is destroyed first)
+    SharedTerrainArena mTerrainArena = TerrainArena::create();
+    float mDefragmentCountdown = 0.0f;
+
+    /// content bounds of all chunks with meshes or occluders, indexed by chunk coordinate (for culling)
+    /// (updated when chunks are meshed or removed, refreshed at the end of update)
+    BoundsGrid<Chunk*> mChunkBounds;
+
+    /// Chunks whose generation/mesh job was cancelled because they left the render distance
+    /// (re-enqueued once they are back in range)
+    std::vector<SharedChunk> mParkedGen;
+    std::vector<SharedChunk> mParkedMesh;
+
     /// list of RenderMaterials
     std::vector<SharedRenderMaterial> renderMaterials;
 
     /// worker thread
     TerrainWorker mWorker;
 
+    /// LOD cells beyond the render distance
+    TerrainLod mLod;
+
+    /// on-disk chunks (nullptr if persistence is disabled)
+    std::unique_ptr<RegionStore> mStore;
+    /// edited chunks that are not saved yet
+    std::vector<SharedChunk> mUnsavedChunks;
+    float mSaveCountdown = 0.0f;
+
+    // eviction
+    tg::pos3 mCameraPos;
+    float mRenderDistance = -1.0f; ///< < 0 means "no camera yet"
+    double mTime = 0.0;
+    float mEvictionCountdown = 0.0f;
+    size_t mResidentMemory = 0;
+    size_t mResidentBlockMemory = 0;
+
+    // visibility (see updateVisibility)
+    struct VisibilityStep
+    {
+        tg::ipos3 chunkPos;
+        int entryFace; ///< -1 for the camera chunk
+        int faces;     ///< bit mask of all directions taken so far
+    };
+    std::vector<VisibilityStep> mVisibilitySteps; ///< search queue (kept to reuse the memory)
+    int mVisibilityUpdate = 0;
+    tg::pos3 mVisibilityCenter;
+    float mVisibilityDistance = -1.0f; ///< < 0 means "no culling"
+    int mPotentiallyVisibleChunks = 0;
+
 public:
-    World();
+    /// workerThreads <= 0 picks the number of worker threads automatically
+    World(int workerThreads = 0);
     ~World();
 
     /// initializes the world (materials, chunks, ...)
     void init();
 
+    /// loads and stores chunks in region files in the given directory
+    /// (stored chunks are not generated again, edits are saved periodically)
+    /// CAUTION: must be called before any chunk is generated
+    void enablePersistence(std::string const& directory);
+    /// returns nullptr if persistence is disabled
+    RegionStore const* getRegionStore() const { return mStore.get(); }
+
     /// ensures that a chunk at a given position exists
     void ensureChunkAt(tg::ipos3 p);
 
     /// ensures that all required chunks around the camera are generated
-    void notifyCameraPosition(tg::pos3 pos, float renderDistance, int maxChunksPerFrame = 1);
+    /// also updates the job priorities (distance to pos, optionally visibility in the frustum)
+    /// and selects the LOD cells (see lodSettings)
+    void notifyCameraPosition(tg::pos3 pos, float renderDistance, FrustumCuller const* frustum = nullptr);
 
     /// deletes all chunks
     void clearChunks();
 
+    /// memory of all resident chunks in bytes (updated periodically)
+    size_t getResidentMemory() const { return mResidentMemory; }
+    /// block storage memory of all resident chunks in bytes (updated periodically)
+    size_t getResidentBlockMemory() const { return mResidentBlockMemory; }
+    /// number of cached terrain columns
+    int getCachedColumns() const { return mColumns.size(); }
+
+    /// LOD cells and the chunk columns drawn at full resolution (updated in notifyCameraPosition)
+    TerrainLod const& getLod() const { return mLod; }
+
+    /// vertices of all terrain meshes (render thread only)
+    TerrainArena& getTerrainArena() { return *mTerrainArena; }
+    TerrainArena const& getTerrainArena() const { return *mTerrainArena; }
+
+    /// chunks with meshes or occluders, organized by their content bounds (see Chunk::getContentAabbMin)
+    /// (query the chunks within a frustum without testing every chunk)
+    BoundsGrid<Chunk*> const& getChunkBounds() const { return mChunkBounds; }
+
+    /// finds the chunks that are potentially visible from the camera (see isChunkPotentiallyVisible)
+    /// Breadth-first search from the camera chunk up to the given distance:
+    /// a chunk is left only through faces connected to the one it was entered by (see ChunkVisibility.hh),
+    /// and never towards the camera (no face opposite to one already passed)
+    void updateVisibility(tg::pos3 camPos, float distance);
+    /// disables the visibility culling (every chunk is potentially visible)
+    void clearVisibility() { mVisibilityDistance = -1.0f; }
+    /// true iff the last updateVisibility reached the chunk (or the chunk is beyond its distance)
+    bool isChunkPotentiallyVisible(Chunk const& chunk) const;
+    /// number of chunks reached by the last updateVisibility
+    int getPotentiallyVisibleChunks() const { return mPotentiallyVisibleChunks; }
+
+    /// switches between the naive and the greedy mesher (remeshes all chunks)
+    void setMeshingMode(MeshingMode mode);
+    MeshingMode getMeshingMode() const { return mWorker.getMeshingMode(); }
+
+    /// switches chunk lookups between the camera-centered grid and the hash map only
+    void setUseChunkGrid(bool enabled) { mUseChunkGrid = enabled; }
+    bool getUseChunkGrid() const { return mUseChunkGrid; }
+
     /// adds a chunk to the update list
     /// also triggers mesh update
     void notifyDirtyChunk(Chunk* chunk);
 
     /// notifies that a chunk was generated
     void notifyChunkGenerated(SharedChunk chunk);
-    /// notifies that a chunk mesh was updated
-    void notifyChunkMeshed(SharedChunk chunk, std::vector<TerrainMeshData> const& data);
+    /// notifies that the meshes of some chunk sections (bit mask) were updated
+    /// (with the visibility information of the whole chunk as of the given mesh version)
+    void notifyChunkMeshed(SharedChunk chunk,
+                           int sections,
+                           PooledVector<TerrainMeshData> const& data,
+                           int version,
+                           ChunkVisibility const& visibility);
+    /// notifies that the generation of a chunk was cancelled (out of range)
+    void notifyChunkGenCancelled(SharedChunk chunk);
+    /// notifies that the mesh update of some chunk sections (bit mask) was cancelled (out of range)
+    void notifyChunkMeshCancelled(SharedChunk chunk, int sections);
+    /// notifies that a LOD cell was built
+    void notifyLodCellBuilt(SharedLodCell const& cell, std::vector<LodCubeData> const& cubes);
 
     /// Update step
     void update(float elapsedSeconds);
@@ -81,9 +225,20 @@ private: // helper
     /// creates all materials
     void setUpMaterials();
 
-    /// triggers a mesh update for a given chunk
+    /// triggers a mesh update for the dirty sections of a given chunk
     void triggerMeshUpdate(SharedChunk chunk);
 
+    /// queues all edited chunks for writing
+    void saveEditedChunks();
+
+    /// evicts least-recently-used chunks out of range until the budget is met
+    void evictChunks();
+    /// removes a chunk from the world and releases its GPU buffers
+    /// (pending jobs may still hold the chunk, their results are discarded)
+    void removeChunk(SharedChunk const& chunk);
+    /// updates the entry of a chunk in mChunkBounds
+    void updateChunkBounds(Chunk& chunk);
+
     /// Adds an opaque material, automatically searches textures
     /// CAREFUL: return value only valid until next mat is added
     Material& addOpaqueMat(std::string const& name, std::vector<SharedRenderMaterial> materials);
@@ -98,6 +253,12 @@ private: // helper
 
     /// Performs procedural generation of a chunk
     void generate(Chunk& c);
+    /// Loads a chunk from the region store, generates (and stores) it if not found
+    /// (called by the worker threads)
+    void loadOrGenerate(Chunk& c);
+    /// Downsamples and meshes a LOD cell from the stored or generated chunks
+    /// (called by the worker threads)
+    std::vector<LodCubeData> buildLod(LodCell const& cell, MeshingMode mode);
 
 public: // accessor functions
     /// for a given world space position, returns the starting position of the associated chunk
@@ -108,24 +269,42 @@ public: // accessor functions
         p.z -= (p.z % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
         return p;
     }
+    /// chunk coordinate (index in chunks) of a chunk starting position
+    static tg::ipos3 chunkCoord(tg::ipos3 chunkPos)
+    {
+        return {chunkPos.x / CHUNK_SIZE, chunkPos.y / CHUNK_SIZE, chunkPos.z / CHUNK_SIZE};
+    }
 
     /// Returns the chunk that contains the given position
     /// Returns nullptr if it doesn't exist
-    Chunk* queryChunk(tg::ipos3 p) const;
+    Chunk* queryChunk(tg::ipos3 p) const
+    {
+        auto cp = chunkPos(p);
+
+        // inside the grid window, the grid is authoritative
+        if (mUseChunkGrid)
+            if (auto cell = mChunkGrid.find(chunkCoord(cp)))
+                return cell->chunk;
+
+        auto it = chunks.find(cp);
+        return it == chunks.end() ? nullptr : it->second.get();
+    }
     /// Returns the chunk that contains the given position
     /// Allocates chunk if not existent
     Chunk& queryChunkAlloc(tg::ipos3 p);
 
     /// queries a block at a given position
-    /// returns an INVALID block if not found
+    /// returns an INVALID block if not found or not generated yet
     /// (does not allocate new chunks dynamically)
-    Block const& queryBlock(tg::ipos3 p) const;
-    /// queries a block at a given position
-    /// returns a MUTABLE reference to the block
+    Block queryBlock(tg::ipos3 p) const;
+    /// replaces the block at a given position
     /// allocates chunks dynamically
-    Block& queryBlockMutable(tg::ipos3 p);
+    /// returns false if the chunk is not generated yet (the edit is discarded)
+    /// (call markDirty afterwards to remesh)
+    bool setBlock(tg::ipos3 p, Block b);
 
-    /// Marks all blocks in a given radius as dirty
+    /// Marks all blocks in a given radius as edited
+    /// (remeshes all chunk sections whose mesh depends on them, the remeshing is prioritized)
     void markDirty(tg::ipos3 p, int rad);
 
     /// Returns the material of that idx
@@ -140,4 +319,5 @@ public: // accessor functions
     RayHit rayCast(tg::pos3 pos, tg::vec3 dir, float maxRange = 100.0f) const;
 
     friend class TerrainWorker;
+    friend class TerrainLod;
 };
@@ -0,0 +1,28 @@
+#pragma once
+
+// Material table shared by the headless benchmarks
+
+#include <vector>
+
+#include "../Material.hh"
+
+/// material table of World::setUpMaterials (same names, order, and indices) without render materials
+inline void setUpBenchMaterials(std::vector<Material>& opaque, std::vector<Material>& translucent)
+{
+    for (auto name : {"grass", "dirt", "lightfountain", "sand", "rock", "snow", "snowrock", "gold", "copper", "bronze"})
+    {
+        Material m;
+        m.name = name;
+        m.index = int8_t(opaque.size() + 1);
+        m.spawnsLightSources = m.name == "lightfountain";
+        opaque.push_back(m);
+    }
+
+    for (auto name : {"crystal", "water"})
+    {
+        Material m;
+        m.name = name;
+        m.index = int8_t(-(translucent.size() + 1));
+        translucent.push_back(m);
+    }
+}
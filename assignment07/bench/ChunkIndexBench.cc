@@ -0,0 +1,166 @@
+// Microbenchmark: random block queries through the chunk hash map vs. the camera-centered chunk grid
+//
+// Mirrors World::queryChunk/queryBlock without the rest of the world (no GL, no worker threads).
+// Usage: rtg_chunk_index_bench [queries]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <typed-geometry/tg-std.hh>
+#include <typed-geometry/tg.hh>
+
+#include "../BlockStorage.hh"
+#include "../Constants.hh"
+#include "../helper/ToroidalGrid.hh"
+
+namespace
+{
+struct BenchChunk
+{
+    tg::ipos3 chunkPos;
+    BlockStorage blocks;
+
+    Block block(tg::ivec3 rel) const { return blocks.get((rel.z * CHUNK_SIZE + rel.y) * CHUNK_SIZE + rel.x); }
+};
+
+tg::ipos3 chunkPos(tg::ipos3 p)
+{
+    p.x -= (p.x % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
+    p.y -= (p.y % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
+    p.z -= (p.z % CHUNK_SIZE + CHUNK_SIZE) % CHUNK_SIZE;
+    return p;
+}
+
+tg::ipos3 chunkCoord(tg::ipos3 cp) { return {cp.x / CHUNK_SIZE, cp.y / CHUNK_SIZE, cp.z / CHUNK_SIZE}; }
+
+struct Index
+{
+    std::unordered_map<tg::ipos3, std::shared_ptr<BenchChunk>> chunks;
+    ToroidalGrid<BenchChunk*> grid = {{64, 32, 64}, nullptr};
+    bool useGrid = false;
+
+    BenchChunk* queryChunk(tg::ipos3 p) const
+    {
+        auto cp = chunkPos(p);
+
+        if (useGrid)
+            if (auto c = grid.find(chunkCoord(cp)))
+                return *c;
+
+        auto it = chunks.find(cp);
+        return it == chunks.end() ? nullptr : it->second.get();
+    }
+
+    Block queryBlock(tg::ipos3 p) const
+    {
+        auto c = queryChunk(p);
+        if (!c)
+            return Block::invalid();
+        return c->block(p - c->chunkPos);
+    }
+};
+
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <class F>
+void run(char const* name, Index& index, std::vector<tg::ipos3> const& queries, F&& query)
+{
+    for (auto useGrid : {false, true})
+    {
+        index.useGrid = useGrid;
+
+        // warm-up
+        long sum = 0;
+        for (auto i = 0u; i < queries.size() / 10; ++i)
+            sum += query(index, queries[i]);
+
+        auto t0 = now();
+        sum = 0;
+        for (auto const& q : queries)
+            sum += query(index, q);
+        auto dt = now() - t0;
+
+        std::printf("%-28s %-9s %8.1f Mqueries/s  (checksum %ld)\n", name, useGrid ? "grid" : "hash map",
+                    queries.size() / dt * 1e-6, sum);
+    }
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    auto queryCount = argc > 1 ? std::atol(argv[1]) : 20000000L;
+
+    // 48 x 8 x 48 chunks around the origin (roughly a render distance of 750)
+    auto const radius = 24;
+    auto const height = 8;
+
+    Index index;
+    std::mt19937 rng(1234);
+    for (auto z = -radius; z < radius; ++z)
+        for (auto y = -height / 2; y < height / 2; ++y)
+            for (auto x = -radius; x < radius; ++x)
+            {
+                auto c = std::make_shared<BenchChunk>();
+                c->chunkPos = tg::ipos3(x, y, z) * CHUNK_SIZE;
+
+                // some terrain-like content: uniform air/rock and palette chunks
+                if (y > 0)
+                    c->blocks.fill(Block::air());
+                else if (y < -1)
+                    c->blocks.fill(Block(1));
+                else
+                {
+                    std::vector<Block> blocks(BlockStorage::blockCount);
+                    for (auto& b : blocks)
+                        b = Block(int8_t(rng() % 4));
+                    c->blocks.assign(blocks.data());
+                }
+
+                // register chunk (grid is centered at the origin)
+                index.chunks[c->chunkPos] = c;
+                index.grid.set(chunkCoord(c->chunkPos), c.get());
+            }
+
+    std::printf("%d chunks, %ld queries per run\n\n", (int)index.chunks.size(), queryCount);
+
+    auto const extentXZ = radius * CHUNK_SIZE;
+    auto const extentY = height / 2 * CHUNK_SIZE;
+
+    // uniformly random positions (cache-unfriendly worst case)
+    std::vector<tg::ipos3> randomQueries(queryCount);
+    {
+        std::uniform_int_distribution<int> dxz(-extentXZ, extentXZ - 1);
+        std::uniform_int_distribution<int> dy(-extentY, extentY - 1);
+        for (auto& q : randomQueries)
+            q = {dxz(rng), dy(rng), dxz(rng)};
+    }
+
+    // random walk (similar to ray casts and neighborhood gathering)
+    std::vector<tg::ipos3> walkQueries(queryCount);
+    {
+        tg::ipos3 p = {0, 0, 0};
+        for (auto& q : walkQueries)
+        {
+            p[rng() % 3] += int(rng() % 3) - 1;
+            p = tg::clamp(p, tg::ipos3(-extentXZ, -extentY, -extentXZ), tg::ipos3(extentXZ - 1, extentY - 1, extentXZ - 1));
+            q = p;
+        }
+    }
+
+    auto queryBlock = [](Index const& idx, tg::ipos3 p) -> long { return idx.queryBlock(p).mat; };
+    auto queryChunk = [](Index const& idx, tg::ipos3 p) -> long { return idx.queryChunk(p) != nullptr; };
+
+    run("queryBlock (random)", index, randomQueries, queryBlock);
+    run("queryBlock (random walk)", index, walkQueries, queryBlock);
+    run("queryChunk (random)", index, randomQueries, queryChunk);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,414 @@
+// Microbenchmark: chunk culling by a linear scan vs. the multi-level bounds grid (see helper/BoundsGrid.hh)
+//
+// Mirrors the chunk culling of Assignment07 (view frustum + render distance) without GL:
+// terrain-like content boxes around the origin, cameras looking in random horizontal directions.
+// Both methods must select the same visible chunks, also after random incremental updates.
+// Then the camera and three shadow cascades: one query per view vs. a single query for all views (see ViewCuller).
+// Usage: rtg_culling_bench [radius in chunks] [queries]
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <typed-geometry/tg-std.hh>
+#include <typed-geometry/tg.hh>
+
+#include "../Constants.hh"
+#include "../ViewCuller.hh"
+#include "../helper/BoundsGrid.hh"
+
+namespace
+{
+struct BenchChunk
+{
+    tg::ipos3 chunkPos;
+    tg::pos3 aabbMin;
+    tg::pos3 aabbMax;
+    bool hasContent = false;
+    /// boxes (min, max) of the meshes, within the content box
+    std::vector<std::array<tg::pos3, 2>> meshes;
+};
+
+constexpr int meshesPerChunk = 6;
+
+/// same tests as FrustumCuller (bounding spheres against the planes), planes from a view-projection matrix
+struct Frustum
+{
+    std::array<tg::vec4, 6> planes; ///< dot(n, p) <= w inside
+    tg::mat4 viewProj;
+    tg::pos3 camPos;
+
+    Frustum(tg::mat4 const& vp, tg::pos3 pos) : viewProj(vp), camPos(pos)
+    {
+        auto row = [&](int r) { return tg::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]); };
+        for (auto i = 0; i < 3; ++i)
+        {
+            planes[i * 2 + 0] = row(3) + row(i);
+            planes[i * 2 + 1] = row(3) - row(i);
+        }
+        for (auto& p : planes)
+        {
+            auto n = tg::vec3(p);
+            auto l = length(n);
+            p = tg::vec4(-n / l, p.w / l);
+        }
+    }
+
+    bool isAabbVisible(tg::pos3 amin, tg::pos3 amax) const
+    {
+        auto center = (amin + amax) / 2.0f;
+        auto radius = distance(amax, center);
+        for (auto const& p : planes)
+            if (dot(center, tg::vec3(p)) - radius > p.w)
+                return false;
+        return true;
+    }
+
+    bool isAabbInside(tg::pos3 amin, tg::pos3 amax) const
+    {
+        auto center = (amin + amax) / 2.0f;
+        auto radius = distance(amax, center);
+        for (auto const& p : planes)
+            if (dot(center, tg::vec3(p)) + radius > p.w)
+                return false;
+        return true;
+    }
+
+    /// exact test: true iff the box is completely outside one of the planes
+    bool isAabbOutsidePlane(tg::pos3 amin, tg::pos3 amax) const
+    {
+        for (auto const& p : planes)
+        {
+            auto n = tg::vec3(p);
+            auto nearest = tg::pos3(n.x > 0 ? amin.x : amax.x, n.y > 0 ? amin.y : amax.y, n.z > 0 ? amin.z : amax.z);
+            if (dot(nearest, n) > p.w)
+                return true;
+        }
+        return false;
+    }
+
+    bool isAabbInRange(tg::pos3 amin, tg::pos3 amax, float range) const
+    {
+        return distance(clamp(camPos, amin, amax), camPos) <= range;
+    }
+
+    bool isAabbFullyInRange(tg::pos3 amin, tg::pos3 amax, float range) const
+    {
+        return length(tg::max(tg::abs(camPos - amin), tg::abs(camPos - amax))) <= range;
+    }
+};
+
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+tg::ipos3 chunkCoord(tg::ipos3 cp) { return {cp.x / CHUNK_SIZE, cp.y / CHUNK_SIZE, cp.z / CHUNK_SIZE}; }
+
+/// random terrain-like content: only chunks around the surface have content, their boxes do not fill the chunk
+void randomContent(BenchChunk& c, std::mt19937& rng)
+{
+    auto y = c.chunkPos.y / CHUNK_SIZE;
+    c.hasContent = y >= -2 && y <= 1 && rng() % 8 != 0;
+    auto lo = tg::ivec3(int(rng() % 4), int(rng() % (CHUNK_SIZE / 2)), int(rng() % 4));
+    auto hi = tg::ivec3(CHUNK_SIZE - int(rng() % 4), CHUNK_SIZE - int(rng() % (CHUNK_SIZE / 2)), CHUNK_SIZE - int(rng() % 4));
+    c.aabbMin = tg::pos3(c.chunkPos + lo);
+    c.aabbMax = tg::pos3(c.chunkPos + hi);
+
+    // one mesh per direction: a slab at a random position
+    c.meshes.clear();
+    for (auto i = 0; i < meshesPerChunk; ++i)
+    {
+        auto a = i / 2;
+        auto t = std::uniform_real_distribution<float>(c.aabbMin[a], c.aabbMax[a])(rng);
+        auto m = std::array<tg::pos3, 2>{{c.aabbMin, c.aabbMax}};
+        m[0][a] = t;
+        m[1][a] = t;
+        c.meshes.push_back(m);
+    }
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    auto radius = argc > 1 ? std::atoi(argv[1]) : 24;
+    auto queryCount = argc > 2 ? std::atoi(argv[2]) : 200;
+    auto const height = 8;
+    auto const range = 512.0f;
+
+    std::mt19937 rng(1234);
+    std::vector<BenchChunk> chunks;
+    chunks.reserve(size_t(4 * radius * radius * height));
+    for (auto z = -radius; z < radius; ++z)
+        for (auto y = -height / 2; y < height / 2; ++y)
+            for (auto x = -radius; x < radius; ++x)
+            {
+                BenchChunk c;
+                c.chunkPos = tg::ipos3(x, y, z) * CHUNK_SIZE;
+                randomContent(c, rng);
+                chunks.push_back(c);
+            }
+
+    BoundsGrid<BenchChunk*> grid;
+    auto t0 = now();
+    for (auto& c : chunks)
+        if (c.hasContent)
+            grid.set(chunkCoord(c.chunkPos), &c, c.aabbMin, c.aabbMax);
+    grid.refresh();
+    auto buildMs = (now() - t0) * 1000;
+
+    std::printf("%d chunks, %d with content, %d nodes, build %.2f ms\n\n", (int)chunks.size(), grid.size(),
+                grid.getNodeCount(), buildMs);
+
+    // random cameras near the ground
+    std::vector<Frustum> frusta;
+    {
+        std::uniform_real_distribution<float> dpos(-radius * CHUNK_SIZE * 0.5f, radius * CHUNK_SIZE * 0.5f);
+        std::uniform_real_distribution<float> dangle(0, 360);
+        auto proj = tg::perspective_opengl(tg::degree(90), 16 / 9.0f, 0.1f, range);
+        for (auto i = 0; i < queryCount; ++i)
+        {
+            auto pos = tg::pos3(dpos(rng), 20, dpos(rng));
+            auto a = tg::degree(dangle(rng));
+            auto target = pos + tg::vec3(tg::cos(a), -0.2f, tg::sin(a));
+            frusta.emplace_back(proj * tg::look_at(pos, target, tg::vec3(0, 1, 0)), pos);
+        }
+    }
+
+    auto scan = [&](Frustum const& f, std::vector<BenchChunk*>& result) {
+        for (auto& c : chunks)
+            if (c.hasContent && f.isAabbVisible(c.aabbMin, c.aabbMax) && f.isAabbInRange(c.aabbMin, c.aabbMax, range))
+                result.push_back(&c);
+        return (int)chunks.size();
+    };
+
+    auto query = [&](Frustum const& f, std::vector<BenchChunk*>& result) {
+        auto test = [&](tg::pos3 amin, tg::pos3 amax) {
+            if (!f.isAabbVisible(amin, amax) || !f.isAabbInRange(amin, amax, range))
+                return BoundsTest::Outside;
+            if (f.isAabbInside(amin, amax) && f.isAabbFullyInRange(amin, amax, range))
+                return BoundsTest::Inside;
+            return BoundsTest::Partial;
+        };
+        return grid.query(test, [&](BenchChunk* c) { result.push_back(c); });
+    };
+
+    // the grid rejects whole nodes, so it may drop chunks that the sphere test of the scan keeps
+    // (a child sphere is not contained in the parent sphere), but only if their box is outside the frustum
+    auto verify = [&](char const* when) {
+        auto dropped = 0;
+        for (auto const& f : frusta)
+        {
+            std::vector<BenchChunk*> a, b;
+            scan(f, a);
+            query(f, b);
+            std::sort(a.begin(), a.end());
+            std::sort(b.begin(), b.end());
+            if (!std::includes(a.begin(), a.end(), b.begin(), b.end()))
+            {
+                std::printf("MISMATCH (%s): the grid selects chunks that the linear scan rejects\n", when);
+                return false;
+            }
+
+            std::vector<BenchChunk*> missing;
+            std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(missing));
+            for (auto c : missing)
+                if (!f.isAabbOutsidePlane(c->aabbMin, c->aabbMax))
+                {
+                    std::printf("MISMATCH (%s): the grid misses a visible chunk\n", when);
+                    return false;
+                }
+            dropped += int(missing.size());
+        }
+        std::printf("verified %s: %d invisible chunks dropped by the grid only (%d queries)\n", when, dropped,
+                    (int)frusta.size());
+        return true;
+    };
+
+    auto run = [&](char const* name, auto&& method) {
+        std::vector<BenchChunk*> result;
+        long tests = 0, selected = 0;
+        auto t0 = now();
+        for (auto const& f : frusta)
+        {
+            result.clear();
+            tests += method(f, result);
+            selected += long(result.size());
+        }
+        auto dt = now() - t0;
+        std::printf("%-12s %8.3f ms/query  %8.1f tests/query  %8.1f chunks/query\n", name, dt * 1000 / frusta.size(),
+                    tests / double(frusta.size()), selected / double(frusta.size()));
+    };
+
+    if (!verify("after build"))
+        return EXIT_FAILURE;
+
+    run("linear scan", scan);
+    run("bounds grid", query);
+
+    // incremental updates: remesh (new boxes, some chunks become empty) and refresh, as World::update does
+    t0 = now();
+    auto updates = (int)chunks.size() / 10;
+    for (auto i = 0; i < updates; ++i)
+    {
+        auto& c = chunks[rng() % chunks.size()];
+        randomContent(c, rng);
+        if (c.hasContent)
+            grid.set(chunkCoord(c.chunkPos), &c, c.aabbMin, c.aabbMax);
+        else
+            grid.remove(chunkCoord(c.chunkPos));
+    }
+    grid.refresh();
+    std::printf("\n%d updates + refresh: %.2f ms\n", updates, (now() - t0) * 1000);
+
+    if (!verify("after updates"))
+        return EXIT_FAILURE;
+
+    // multiple views: the camera and orthographic shadow cascades (like Assignment07::cullViews)
+    // per view: one query per view (as every pass did), single pass: one query narrowing the set of views
+    auto const lightDir = normalize(tg::vec3(0.3f, 1.0f, 0.2f));
+    auto const lightView = tg::look_at(tg::pos3::zero + lightDir, tg::pos3::zero, tg::vec3::unit_y);
+    std::vector<std::vector<Frustum>> viewSets;
+    std::vector<ViewCuller> viewCullers;
+    for (auto const& f : frusta)
+    {
+        std::vector<Frustum> views = {f};
+        ViewCuller vc;
+        vc.addView(f.viewProj, f.camPos, range);
+        for (auto c = 0; c < 3; ++c)
+        {
+            // cascade c covers the camera range [c, c + 1] / 3, centered around the camera
+            auto size = range * (c + 1) / 3.0f;
+            auto center = tg::pos3(lightView * tg::vec4(f.camPos, 1));
+            auto proj = tg::scaling(tg::size3(1 / size, 1 / size, -1 / (2 * size))) * tg::translation(tg::pos3::zero - center);
+            views.emplace_back(proj * lightView, f.camPos);
+            vc.addView(proj * lightView, f.camPos, -1.0f);
+        }
+        viewSets.push_back(views);
+        viewCullers.push_back(vc);
+    }
+    auto viewRange = [&](int v) { return v == 0 ? range : std::numeric_limits<float>::infinity(); };
+
+    // per view: chunks, then their meshes (as every pass did before)
+    struct VisibleMesh
+    {
+        std::array<tg::pos3, 2> const* box;
+        ViewMask views;
+    };
+    auto queryPerView = [&](int i, std::vector<VisibleMesh>& result) {
+        auto tests = 0;
+        for (auto v = 0; v < (int)viewSets[i].size(); ++v)
+        {
+            auto const& f = viewSets[i][v];
+            auto test = [&](tg::pos3 amin, tg::pos3 amax) {
+                if (!f.isAabbVisible(amin, amax) || !f.isAabbInRange(amin, amax, viewRange(v)))
+                    return BoundsTest::Outside;
+                if (f.isAabbInside(amin, amax) && f.isAabbFullyInRange(amin, amax, viewRange(v)))
+                    return BoundsTest::Inside;
+                return BoundsTest::Partial;
+            };
+            tests += grid.query(test, [&](BenchChunk* c) {
+                for (auto const& m : c->meshes)
+                {
+                    ++tests;
+                    if (f.isAabbVisible(m[0], m[1]) && f.isAabbInRange(m[0], m[1], viewRange(v)))
+                        result.push_back({&m, ViewMask(1 << v)});
+                }
+            });
+        }
+        return tests;
+    };
+
+    // single pass: chunks and meshes narrow a set of views, views that contain a node are not tested again
+    struct CullState
+    {
+        ViewMask views;
+        ViewMask inside;
+    };
+    auto querySinglePass = [&](int i, std::vector<VisibleMesh>& result) {
+        auto const& vc = viewCullers[i];
+        auto test = [&](tg::pos3 amin, tg::pos3 amax, CullState& s) {
+            ViewMask inside;
+            s.views = s.inside | vc.test(amin, amax, s.views & ~s.inside, inside);
+            s.inside |= inside;
+            if (!s.views)
+                return BoundsTest::Outside;
+            return s.inside == s.views ? BoundsTest::Inside : BoundsTest::Partial;
+        };
+        auto tests = 0;
+        tests += grid.queryWithState(CullState{vc.getAllViews(), 0}, test, [&](BenchChunk* c, CullState const& s) {
+            for (auto const& m : c->meshes)
+            {
+                ViewMask inside;
+                auto views = s.inside;
+                if (s.views & ~s.inside)
+                {
+                    ++tests;
+                    views |= vc.test(m[0], m[1], s.views & ~s.inside, inside);
+                }
+                if (views)
+                    result.push_back({&m, views});
+            }
+        });
+        return tests;
+    };
+
+    // the box tests of the single pass are exact, so it selects a subset of the sphere tests
+    for (auto i = 0; i < (int)frusta.size(); ++i)
+    {
+        std::vector<VisibleMesh> ra, rb;
+        queryPerView(i, ra);
+        querySinglePass(i, rb);
+        for (auto v = 0; v < 4; ++v)
+        {
+            std::vector<std::array<tg::pos3, 2> const*> a, b;
+            for (auto const& m : ra)
+                if (m.views >> v & 1)
+                    a.push_back(m.box);
+            for (auto const& m : rb)
+                if (m.views >> v & 1)
+                    b.push_back(m.box);
+            std::sort(a.begin(), a.end());
+            std::sort(b.begin(), b.end());
+            std::vector<std::array<tg::pos3, 2> const*> missing;
+            std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(missing));
+            for (auto m : missing)
+                if (!viewSets[i][v].isAabbOutsidePlane((*m)[0], (*m)[1]))
+                {
+                    std::printf("MISMATCH: the single pass misses a visible mesh of view %d\n", v);
+                    return EXIT_FAILURE;
+                }
+            if (!std::includes(a.begin(), a.end(), b.begin(), b.end()))
+            {
+                std::printf("MISMATCH: the single pass selects a mesh that view %d rejects\n", v);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    std::printf("\nverified single pass against per-view queries (4 views, %d meshes per chunk)\n", meshesPerChunk);
+
+    auto runViews = [&](char const* name, auto&& method) {
+        std::vector<VisibleMesh> result;
+        long tests = 0, selected = 0;
+        auto t0 = now();
+        for (auto i = 0; i < (int)frusta.size(); ++i)
+        {
+            result.clear();
+            tests += method(i, result);
+            selected += long(result.size());
+        }
+        auto dt = now() - t0;
+        std::printf("%-12s %8.3f ms/frame  %8.1f tests/frame  %8.1f entries/frame\n", name, dt * 1000 / frusta.size(),
+                    tests / double(frusta.size()), selected / double(frusta.size()));
+    };
+    runViews("per view", queryPerView);
+    runViews("single pass", querySinglePass);
+
+    return EXIT_SUCCESS;
+}
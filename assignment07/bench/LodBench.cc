@@ -0,0 +1,232 @@
+// Benchmark: vertex count and build time of the LOD terrain (no window, no GL context, no World)
+//
+// Compares the terrain around a camera as drawn with and without LOD cells:
+//  - reference: all chunk columns within the reference distance at full resolution
+//  - LOD: chunk columns up to the chunk distance, LOD cells (see LodBuilder.hh) up to the LOD distance
+//    (same node selection as TerrainLod, without hysteresis)
+// Prints the results as JSON (for tracking across commits).
+//
+// Usage: rtg_lod_bench [options]
+//   --camera X Z            camera position (default 0 0)
+//   --reference R           render distance of the reference (default 128)
+//   --chunk-distance D      full resolution distance with LOD (default 112, like the app)
+//   --lod-distance L        render distance of the LOD cells (default 512)
+//   --threads T             worker threads (default 1)
+//   --seed S                noise seed (default 1337, like World)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <typed-geometry/tg.hh>
+
+#include "../ColumnCache.hh"
+#include "../Constants.hh"
+#include "../LodBuilder.hh"
+#include "../TerrainGenerator.hh"
+#include "../helper/MemoryPool.hh"
+
+#include "BenchMaterials.hh"
+
+namespace
+{
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// runs job(i) for i in [0, count) on the given number of threads
+template <class JobF>
+void parallelFor(int count, int threads, JobF&& job)
+{
+    std::atomic<int> next = {0};
+    auto work = [&] {
+        for (auto i = next++; i < count; i = next++)
+            job(i);
+    };
+
+    std::vector<std::thread> pool;
+    for (auto t = 1; t < threads; ++t)
+        pool.emplace_back(work);
+    work();
+    for (auto& t : pool)
+        t.join();
+}
+
+/// a cell (or chunk column for level 0) to draw
+struct Node
+{
+    int level;
+    tg::ipos3 origin;
+};
+
+/// splits a node while its footprint reaches into its split distance (like TerrainLod, without hysteresis)
+void select(tg::pos3 cam, int level, tg::ipos3 origin, float chunkDistance, std::vector<Node>& nodes)
+{
+    if (level == 0 || lodNearestDistance(cam, origin, level) >= lodSplitDistance(level, chunkDistance))
+    {
+        nodes.push_back({level, origin});
+        return;
+    }
+
+    auto half = CHUNK_SIZE << (level - 1);
+    for (auto dz : {0, 1})
+        for (auto dx : {0, 1})
+            select(cam, level - 1, origin + tg::ivec3(dx, 0, dz) * half, chunkDistance, nodes);
+}
+
+struct Result
+{
+    int nodes = 0;
+    int64_t vertices = 0;
+    int64_t meshes = 0;
+    double cpuSeconds = 0;
+};
+} // namespace
+
+int main(int argc, char** argv)
+{
+    auto camera = tg::pos3(0, 40, 0);
+    auto referenceDistance = 128.0f;
+    auto chunkDistance = 112.0f;
+    auto lodDistance = 512.0f;
+    auto threads = 1;
+    auto seed = 1337;
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        auto arg = std::string(argv[i]);
+        auto hasArgs = [&](int n) { return i + n < argc; };
+
+        if (arg == "--camera" && hasArgs(2))
+        {
+            camera.x = float(std::atof(argv[++i]));
+            camera.z = float(std::atof(argv[++i]));
+        }
+        else if (arg == "--reference" && hasArgs(1))
+            referenceDistance = float(std::atof(argv[++i]));
+        else if (arg == "--chunk-distance" && hasArgs(1))
+            chunkDistance = float(std::atof(argv[++i]));
+        else if (arg == "--lod-distance" && hasArgs(1))
+            lodDistance = float(std::atof(argv[++i]));
+        else if (arg == "--threads" && hasArgs(1))
+            threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--seed" && hasArgs(1))
+            seed = std::atoi(argv[++i]);
+        else
+        {
+            std::fprintf(stderr, "unknown or incomplete option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<Material> materialsOpaque, materialsTranslucent;
+    setUpBenchMaterials(materialsOpaque, materialsTranslucent);
+
+    TerrainGenerator generator(seed);
+    generator.setMaterials(materialsOpaque, materialsTranslucent);
+
+    // nothing is resident, columns are computed per cell
+    ColumnCache columns;
+
+    // nodes of all footprints of the given level within a distance
+    auto nodesInRange = [&](int level, float range) {
+        std::vector<Node> nodes;
+        auto size = CHUNK_SIZE << level;
+        auto lo = tg::ipos2(tg::floor((tg::pos2(camera.x, camera.z) - range) / float(size)));
+        auto hi = tg::ipos2(tg::floor((tg::pos2(camera.x, camera.z) + range) / float(size)));
+        for (auto z = lo.y; z <= hi.y; ++z)
+            for (auto x = lo.x; x <= hi.x; ++x)
+            {
+                auto origin = tg::ipos3(x * size, 0, z * size);
+                if (lodNearestDistance(camera, origin, level) <= range)
+                    nodes.push_back({level, origin});
+            }
+        return nodes;
+    };
+
+    // builds all nodes, results per level
+    auto build = [&](std::vector<Node> const& nodes) {
+        std::vector<Result> results(LOD_LEVELS + 1);
+        std::vector<Result> perNode(nodes.size());
+        parallelFor((int)nodes.size(), threads, [&](int i) {
+            auto const& n = nodes[i];
+            auto t0 = now();
+            // chunk columns without skirts, like the chunk meshes of the world
+            auto cubes = buildLodCell(n.level, n.origin, generator, columns, nullptr, MeshingMode::Greedy,
+                                      n.level == 0 ? 0 : lodSkirtDepth);
+            auto& r = perNode[i];
+            for (auto const& c : cubes)
+                for (auto const& m : c.meshes)
+                {
+                    r.vertices += int64_t(m.vertices.size());
+                    ++r.meshes;
+                }
+            r.cpuSeconds = now() - t0;
+        });
+
+        for (auto i = 0u; i < nodes.size(); ++i)
+        {
+            auto& r = results[nodes[i].level];
+            ++r.nodes;
+            r.vertices += perNode[i].vertices;
+            r.meshes += perNode[i].meshes;
+            r.cpuSeconds += perNode[i].cpuSeconds;
+        }
+        return results;
+    };
+
+    auto printResults = [&](std::vector<Result> const& results, bool last) {
+        Result total;
+        std::printf("    \"levels\": [\n");
+        auto first = true;
+        for (auto l = 0; l <= LOD_LEVELS; ++l)
+        {
+            auto const& r = results[l];
+            total.nodes += r.nodes;
+            total.vertices += r.vertices;
+            total.meshes += r.meshes;
+            total.cpuSeconds += r.cpuSeconds;
+            if (r.nodes == 0)
+                continue;
+
+            std::printf("%s      {\"level\": %d, \"nodes\": %d, \"meshes\": %lld, \"vertices\": %lld, \"cpuSeconds\": %.3f}",
+                        first ? "" : ",\n", l, r.nodes, (long long)r.meshes, (long long)r.vertices, r.cpuSeconds);
+            first = false;
+        }
+        std::printf("\n    ],\n");
+        std::printf("    \"meshes\": %lld,\n", (long long)total.meshes);
+        std::printf("    \"vertices\": %lld,\n", (long long)total.vertices);
+        std::printf("    \"vertexMB\": %.2f,\n", total.vertices * sizeof(TerrainVertex) / (1024.0 * 1024.0));
+        std::printf("    \"cpuSeconds\": %.3f\n", total.cpuSeconds);
+        std::printf("  }%s\n", last ? "" : ",");
+    };
+
+    // reference: full resolution only
+    auto reference = build(nodesInRange(0, referenceDistance));
+
+    // LOD: coarsest nodes in range, split by distance
+    std::vector<Node> lodNodes;
+    for (auto const& root : nodesInRange(LOD_LEVELS, lodDistance))
+        select(camera, root.level, root.origin, chunkDistance, lodNodes);
+    auto lod = build(lodNodes);
+
+    std::printf("{\n");
+    std::printf("  \"camera\": [%.1f, %.1f],\n", camera.x, camera.z);
+    std::printf("  \"threads\": %d,\n", threads);
+    std::printf("  \"reference\": {\n");
+    std::printf("    \"distance\": %.1f,\n", referenceDistance);
+    printResults(reference, false);
+    std::printf("  \"lod\": {\n");
+    std::printf("    \"chunkDistance\": %.1f,\n", chunkDistance);
+    std::printf("    \"distance\": %.1f,\n", lodDistance);
+    printResults(lod, true);
+    std::printf("}\n");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,376 @@
+// Benchmark: generateMesh on a corpus of padded 34^3 neighborhoods (no GL, no World)
+//
+// Corpus categories:
+//   terrain       chunks of the procedural terrain (same generator and materials as World)
+//   checkerboard  alternating rock/air blocks (worst case: six faces per solid block, nothing to merge)
+//   water         water only (no visible faces at all)
+//   caves         rock, dirt, and ores with noise caves
+//
+// Reports chunks/s, vertices, quads, output bytes, and pool allocations per meshing mode and category.
+// --check expands the quads of every mesher into unit faces and requires identical results.
+//
+// Usage: rtg_mesh_bench [options]
+//   --mode M        naive, greedy, or both (default both)
+//   --repeat R      meshing passes over the corpus (default 5)
+//   --save FILE     writes the generated corpus
+//   --load FILE     uses a saved corpus instead of generating one
+//   --check         cross-checks the output of all meshers
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <typed-geometry/tg.hh>
+
+#include "../BlockStorage.hh"
+#include "../Constants.hh"
+#include "../MeshGenerator.hh"
+#include "../TerrainGenerator.hh"
+#include "../helper/MemoryPool.hh"
+#include "../helper/Noise.hh"
+
+#include "BenchMaterials.hh"
+
+namespace
+{
+constexpr int extSize = CHUNK_SIZE + 2;
+constexpr int extCount = extSize * extSize * extSize;
+
+struct CorpusEntry
+{
+    std::string category;
+    tg::ipos3 chunkPos;
+    PooledVector<Block> blocks; ///< padded neighborhood, index (z * 34 + y) * 34 + x, local (1,1,1) is chunkPos
+};
+
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+char const* modeName(MeshingMode mode) { return mode == MeshingMode::Naive ? "naive" : "greedy"; }
+
+/// fills the neighborhood of a chunk from a function of the global block position
+template <class BlockF>
+CorpusEntry makeEntry(std::string const& category, tg::ipos3 chunkPos, BlockF&& blockAt)
+{
+    CorpusEntry e;
+    e.category = category;
+    e.chunkPos = chunkPos;
+    e.blocks.resize(extCount);
+    for (auto z = 0; z < extSize; ++z)
+        for (auto y = 0; y < extSize; ++y)
+            for (auto x = 0; x < extSize; ++x)
+                e.blocks[(z * extSize + y) * extSize + x] = blockAt(chunkPos + tg::ivec3(x, y, z) - 1);
+    return e;
+}
+
+std::vector<CorpusEntry> generateCorpus()
+{
+    std::vector<Material> materialsOpaque, materialsTranslucent;
+    setUpBenchMaterials(materialsOpaque, materialsTranslucent);
+
+    TerrainGenerator generator;
+    generator.setMaterials(materialsOpaque, materialsTranslucent);
+    auto const& mats = generator.getMaterials();
+
+    std::vector<CorpusEntry> corpus;
+
+    // terrain: 6 x 4 x 6 chunks around the origin, neighborhoods outside the region are invalid (like missing chunks)
+    {
+        tg::ivec3 const size = {6, 4, 6};
+        tg::ivec3 const origin = {-3, -2, -3};
+
+        std::vector<BlockStorage> chunks(size.x * size.y * size.z, BlockStorage(Block::invalid()));
+        std::map<tg::ipos2, TerrainColumn> columns;
+        auto chunkIdxOf = [&](tg::ivec3 c) { return (c.z * size.y + c.y) * size.x + c.x; };
+
+        for (auto z = 0; z < size.z; ++z)
+            for (auto x = 0; x < size.x; ++x)
+            {
+                auto cp = tg::ipos3::zero + (origin + tg::ivec3(x, 0, z)) * CHUNK_SIZE;
+                auto& col = columns[{x, z}];
+                generator.generateColumn(cp, col);
+                for (auto y = 0; y < size.y; ++y)
+                    generator.generate(tg::ipos3::zero + (origin + tg::ivec3(x, y, z)) * CHUNK_SIZE, col,
+                                       chunks[chunkIdxOf({x, y, z})]);
+            }
+
+        auto blockAt = [&](tg::ipos3 p) {
+            auto c = tg::ivec3(tg::floor(tg::vec3(p) / float(CHUNK_SIZE))) - origin;
+            if (c.x < 0 || c.y < 0 || c.z < 0 || c.x >= size.x || c.y >= size.y || c.z >= size.z)
+                return Block::invalid();
+            auto rp = p - (tg::ipos3::zero + (c + origin) * CHUNK_SIZE);
+            return chunks[chunkIdxOf(c)].get((rp.z * CHUNK_SIZE + rp.y) * CHUNK_SIZE + rp.x);
+        };
+
+        for (auto z = 0; z < size.z; ++z)
+            for (auto y = 0; y < size.y; ++y)
+                for (auto x = 0; x < size.x; ++x)
+                    corpus.push_back(makeEntry("terrain", tg::ipos3::zero + (origin + tg::ivec3(x, y, z)) * CHUNK_SIZE, blockAt));
+    }
+
+    // synthetic volumes at a few different positions
+    tg::ipos3 const positions[] = {{0, 0, 0}, {32, 0, 0}, {0, -64, 96}, {-320, 32, 160}, {640, -32, -224}, {-96, 0, -96}};
+
+    for (auto cp : positions)
+        corpus.push_back(makeEntry("checkerboard", cp, [&](tg::ipos3 p) {
+            return (p.x + p.y + p.z) & 1 ? Block(mats.rock) : Block::air();
+        }));
+
+    for (auto cp : positions)
+        corpus.push_back(makeEntry("water", cp, [&](tg::ipos3) { return Block(mats.water); }));
+
+    FastNoise caveNoise(4242);
+    caveNoise.SetFractalOctaves(3);
+    for (auto cp : positions)
+        corpus.push_back(makeEntry("caves", cp, [&](tg::ipos3 p) {
+            auto v = caveNoise.GetPerlinFractal(4.1f * p.x, 6.3f * p.y, 4.7f * p.z);
+            if (tg::abs(v) < 0.12f)
+                return Block::air(); // tunnels along the zero set
+            auto ore = caveNoise.GetValue(23.1f * p.x, 23.1f * p.y, 23.1f * p.z);
+            if (ore > 0.8f)
+                return Block(mats.gold);
+            if (ore < -0.8f)
+                return Block(mats.copper);
+            return Block(v > 0 ? mats.rock : mats.dirt);
+        }));
+
+    return corpus;
+}
+
+bool saveCorpus(std::string const& filename, std::vector<CorpusEntry> const& corpus)
+{
+    auto f = std::fopen(filename.c_str(), "wb");
+    if (!f)
+        return false;
+
+    int32_t count = (int32_t)corpus.size();
+    std::fwrite("RTGMESH1", 8, 1, f);
+    std::fwrite(&count, sizeof(count), 1, f);
+    for (auto const& e : corpus)
+    {
+        auto nameLength = uint8_t(e.category.size());
+        int32_t pos[3] = {e.chunkPos.x, e.chunkPos.y, e.chunkPos.z};
+        std::fwrite(&nameLength, 1, 1, f);
+        std::fwrite(e.category.data(), 1, nameLength, f);
+        std::fwrite(pos, sizeof(pos), 1, f);
+        std::fwrite(e.blocks.data(), sizeof(Block), extCount, f);
+    }
+
+    return std::fclose(f) == 0;
+}
+
+bool loadCorpus(std::string const& filename, std::vector<CorpusEntry>& corpus)
+{
+    auto f = std::fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+
+    char magic[8];
+    int32_t count = 0;
+    auto ok = std::fread(magic, 8, 1, f) == 1 && std::memcmp(magic, "RTGMESH1", 8) == 0
+              && std::fread(&count, sizeof(count), 1, f) == 1;
+    for (auto i = 0; ok && i < count; ++i)
+    {
+        CorpusEntry e;
+        uint8_t nameLength = 0;
+        int32_t pos[3];
+        char name[256];
+        e.blocks.resize(extCount);
+        ok = std::fread(&nameLength, 1, 1, f) == 1 && std::fread(name, 1, nameLength, f) == nameLength
+             && std::fread(pos, sizeof(pos), 1, f) == 1 && std::fread(e.blocks.data(), sizeof(Block), extCount, f) == extCount;
+
+        e.category.assign(name, nameLength);
+        e.chunkPos = {pos[0], pos[1], pos[2]};
+        corpus.push_back(std::move(e));
+    }
+
+    std::fclose(f);
+    return ok;
+}
+
+/// a single visible block face
+using UnitFace = std::tuple<int, int, int, int, int, int>; // x, y, z, packed dir, material, face flags
+
+/// expands all quads of a mesh into unit faces
+/// (mirrors the vertex layout of addQuad/addVert in MeshGenerator.cc, face flags as derived by the shaders)
+void expandFaces(TerrainMeshData const& mesh, std::vector<UnitFace>& faces)
+{
+    auto const faceFlagCount = 3 * 3 * 3 * 3 * 4 * 4 * 4 * 4;
+
+    for (auto q = 0u; q + 4 <= mesh.vertices.size(); q += 4)
+    {
+        auto flags = mesh.vertices[q].flags / 4; // vertex idx
+        auto pdir = flags % 6;
+        flags /= 6;
+        auto quadFlags = flags % faceFlagCount;
+        flags /= faceFlagCount;
+        auto sizeT = flags % 32 + 1;
+        auto sizeB = flags / 32 + 1;
+
+        // vertices are p00, p01, p10, p11 (chunk-local)
+        auto position = [&](int i) { return tg::pos3(TerrainVertex::unpackPosition(mesh.vertices[q + i].position)); };
+        auto p00 = position(0);
+        auto dt = (position(2) - p00) / float(sizeT);
+        auto db = (position(1) - p00) / float(sizeB);
+        auto dn = tg::vec3(mesh.dir);
+
+        // block of the first face (see addQuad)
+        auto first = p00 + dt * 0.5f + db * 0.5f - dn * 0.5f - 0.5f;
+        for (auto j = 0; j < sizeB; ++j)
+            for (auto i = 0; i < sizeT; ++i)
+            {
+                auto p = tg::ipos3(tg::round(first + dt * float(i) + db * float(j)));
+                faces.emplace_back(p.x, p.y, p.z, pdir, mesh.mat, quadFaceFlags(quadFlags, i, j, sizeT, sizeB));
+            }
+    }
+}
+
+std::vector<UnitFace> unitFaces(PooledVector<TerrainMeshData> const& meshes)
+{
+    std::vector<UnitFace> faces;
+    for (auto const& m : meshes)
+        expandFaces(m, faces);
+    std::sort(faces.begin(), faces.end());
+    return faces;
+}
+
+struct Result
+{
+    int chunks = 0;
+    double seconds = 0;
+    int64_t vertices = 0;
+    int64_t quads = 0;
+    int64_t bytes = 0;
+    int64_t allocations = 0;
+    int64_t heapAllocations = 0;
+};
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<MeshingMode> modes = {MeshingMode::Naive, MeshingMode::Greedy};
+    auto repeat = 5;
+    std::string saveFile, loadFile;
+    auto check = false;
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        auto arg = std::string(argv[i]);
+        auto hasArg = i + 1 < argc;
+
+        if (arg == "--mode" && hasArg)
+        {
+            auto m = std::string(argv[++i]);
+            if (m == "naive")
+                modes = {MeshingMode::Naive};
+            else if (m == "greedy")
+                modes = {MeshingMode::Greedy};
+        }
+        else if (arg == "--repeat" && hasArg)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--save" && hasArg)
+            saveFile = argv[++i];
+        else if (arg == "--load" && hasArg)
+            loadFile = argv[++i];
+        else if (arg == "--check")
+            check = true;
+        else
+        {
+            std::fprintf(stderr, "unknown or incomplete option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<CorpusEntry> corpus;
+    if (!loadFile.empty())
+    {
+        if (!loadCorpus(loadFile, corpus))
+        {
+            std::fprintf(stderr, "could not load corpus %s\n", loadFile.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    else
+        corpus = generateCorpus();
+
+    if (!saveFile.empty() && !saveCorpus(saveFile, corpus))
+    {
+        std::fprintf(stderr, "could not save corpus %s\n", saveFile.c_str());
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> categories;
+    for (auto const& e : corpus)
+        if (std::find(categories.begin(), categories.end(), e.category) == categories.end())
+            categories.push_back(e.category);
+
+    std::printf("%d chunks, %d passes\n\n", (int)corpus.size(), repeat);
+    std::printf("%-7s %-13s %10s %12s %10s %12s %12s %10s\n", "mode", "category", "chunks/s", "vertices", "quads",
+                "bytes", "allocs/chunk", "heap");
+
+    for (auto mode : modes)
+        for (auto const& category : categories)
+        {
+            Result r;
+            for (auto pass = 0; pass < repeat; ++pass)
+                for (auto const& e : corpus)
+                {
+                    if (e.category != category)
+                        continue;
+
+                    auto stats0 = MemoryPool::global().getStats();
+                    auto t0 = now();
+                    auto meshes = generateMesh(e.blocks, e.chunkPos, mode);
+                    r.seconds += now() - t0;
+                    auto stats1 = MemoryPool::global().getStats();
+
+                    r.allocations += stats1.allocations - stats0.allocations;
+                    r.heapAllocations += stats1.heapAllocations - stats0.heapAllocations;
+                    ++r.chunks;
+
+                    if (pass > 0)
+                        continue; // output is the same in every pass
+
+                    for (auto const& m : meshes)
+                    {
+                        r.vertices += int64_t(m.vertices.size());
+                        r.quads += int64_t(m.vertices.size() / 4);
+                        r.bytes += int64_t(m.vertices.size() * sizeof(m.vertices[0]));
+                    }
+                }
+
+            std::printf("%-7s %-13s %10.1f %12lld %10lld %12lld %12.1f %10lld\n", modeName(mode), category.c_str(),
+                        r.chunks / r.seconds, (long long)r.vertices, (long long)r.quads, (long long)r.bytes,
+                        double(r.allocations) / r.chunks, (long long)r.heapAllocations);
+        }
+
+    if (check)
+    {
+        auto mismatches = 0;
+        for (auto const& e : corpus)
+        {
+            auto reference = unitFaces(generateMesh(e.blocks, e.chunkPos, MeshingMode::Naive));
+            for (auto mode : {MeshingMode::Greedy})
+                if (unitFaces(generateMesh(e.blocks, e.chunkPos, mode)) != reference)
+                {
+                    ++mismatches;
+                    std::printf("MISMATCH: %s mesher, %s chunk at (%d, %d, %d)\n", modeName(mode), e.category.c_str(),
+                                e.chunkPos.x, e.chunkPos.y, e.chunkPos.z);
+                }
+        }
+
+        std::printf("\ncross-check: %d mismatches in %d chunks\n", mismatches, (int)corpus.size());
+        if (mismatches > 0)
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
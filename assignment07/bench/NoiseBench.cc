@@ -0,0 +1,156 @@
+// Microbenchmark: scalar vs. batched FastNoise evaluation (per noise type and kernel)
+//
+// Also compares every batched result against the scalar functions (must be bit-identical).
+// Usage: rtg_noise_bench [points]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../helper/Noise.hh"
+
+namespace
+{
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+char const* kernelName(FastNoise::BatchKernel k)
+{
+    switch (k)
+    {
+    case FastNoise::BatchScalar:
+        return "scalar";
+    case FastNoise::BatchSSE41:
+        return "SSE4.1";
+    case FastNoise::BatchAVX2:
+        return "AVX2";
+    default:
+        return "auto";
+    }
+}
+
+/// prints throughput and mismatches against the reference
+/// returns false if the results differ
+bool report(char const* name, char const* kernel, double seconds, std::vector<float> const& result, std::vector<float> const& reference)
+{
+    auto mismatches = 0;
+    auto maxError = 0.0f;
+    for (auto i = 0u; i < result.size(); ++i)
+        if (std::memcmp(&result[i], &reference[i], sizeof(float)) != 0)
+        {
+            ++mismatches;
+            maxError = std::max(maxError, std::abs(result[i] - reference[i]));
+        }
+
+    std::printf("%-22s %-16s %8.1f Mpoints/s  %d mismatches (max error %g)\n", name, kernel,
+                result.size() / seconds * 1e-6, mismatches, maxError);
+    return mismatches == 0;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    auto count = argc > 1 ? std::atoi(argv[1]) : 1 << 22;
+
+    FastNoise noise; // same settings as World
+
+    std::printf("best supported kernel: %s, %d points\n\n", kernelName(FastNoise::GetBatchKernel()), count);
+
+    // coordinates like in World::generate (integer block positions, scaled)
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(-5000, 5000);
+    std::vector<float> x(count), y(count), z(count);
+    for (auto i = 0; i < count; ++i)
+    {
+        auto px = float(dist(rng));
+        auto py = float(dist(rng) / 50);
+        auto pz = float(dist(rng));
+        x[i] = float(15.17 * px);
+        y[i] = float(5.1 * py);
+        z[i] = float(17.18 * pz);
+    }
+
+    std::vector<float> reference(count), result(count);
+    auto ok = true;
+
+    FastNoise::BatchKernel const kernels[] = {FastNoise::BatchScalar, FastNoise::BatchSSE41, FastNoise::BatchAVX2};
+
+    // Perlin fractal 2D
+    {
+        auto t0 = now();
+        for (auto i = 0; i < count; ++i)
+            reference[i] = noise.GetPerlinFractal(x[i], z[i]);
+        report("PerlinFractal 2D", "scalar calls", now() - t0, reference, reference);
+
+        for (auto k : kernels)
+        {
+            FastNoise::SetBatchKernel(k);
+            if (FastNoise::GetBatchKernel() != k)
+                continue; // not supported
+
+            t0 = now();
+            noise.GetPerlinFractal(x.data(), z.data(), result.data(), count);
+            ok &= report("PerlinFractal 2D", kernelName(k), now() - t0, result, reference);
+        }
+    }
+
+    // Value 3D
+    {
+        FastNoise::SetBatchKernel(FastNoise::BatchAuto);
+
+        auto t0 = now();
+        for (auto i = 0; i < count; ++i)
+            reference[i] = noise.GetValue(x[i], y[i], z[i]);
+        report("Value 3D", "scalar calls", now() - t0, reference, reference);
+
+        for (auto k : kernels)
+        {
+            FastNoise::SetBatchKernel(k);
+            if (FastNoise::GetBatchKernel() != k)
+                continue; // not supported
+
+            t0 = now();
+            noise.GetValue(x.data(), y.data(), z.data(), result.data(), count);
+            ok &= report("Value 3D", kernelName(k), now() - t0, result, reference);
+        }
+    }
+
+    // Value 3D on a regular grid (like a whole chunk)
+    {
+        FastNoise::SetBatchKernel(FastNoise::BatchAuto);
+
+        auto n = 32;
+        auto cells = n * n * n;
+        std::vector<float> gridRef(cells), grid(cells);
+        auto reps = std::max(1, count / cells);
+
+        auto t0 = now();
+        for (auto r = 0; r < reps; ++r)
+            for (auto i = 0; i < cells; ++i)
+                gridRef[i] = noise.GetValue(12.1f * (r + i % n), 5.1f * (i / n % n), 9.6f * (i / (n * n)));
+        auto dtRef = now() - t0;
+
+        t0 = now();
+        for (auto r = 0; r < reps; ++r)
+            noise.GetValueGrid(grid.data(), 12.1f * r, 0.0f, 0.0f, 12.1f, 5.1f, 9.6f, n, n, n);
+        auto dt = now() - t0;
+
+        std::printf("%-22s %-16s %8.1f Mpoints/s\n", "Value 3D grid", "scalar calls", reps * cells / dtRef * 1e-6);
+        std::printf("%-22s %-16s %8.1f Mpoints/s\n", "Value 3D grid", kernelName(FastNoise::GetBatchKernel()),
+                    reps * cells / dt * 1e-6);
+    }
+
+    if (!ok)
+    {
+        std::printf("\nERROR: batched results differ from scalar results\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+// Microbenchmark: sorting draw calls with std::sort on a fresh vector vs. the radix-sorted RenderQueue
+//
+// Mirrors the job collection of Assignment07::renderScene without GL (programs are dummy pointers):
+// random draws with a few programs, terrain-like materials, and random distances.
+// The queue must keep every program and material contiguous, front-to-back within a material.
+// Also counts heap allocations per frame (after the first frame).
+// Usage: rtg_render_queue_bench [draws] [frames]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "../Material.hh"
+#include "../RenderQueue.hh"
+
+namespace
+{
+std::atomic<long> allocations = {0};
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    if (auto p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace
+{
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// input of a draw, as collected from the visible meshes
+struct Input
+{
+    RenderDraw draw;
+    float distance;
+};
+
+/// the job of the old renderScene
+struct RenderJob
+{
+    glow::Program* program;
+    RenderMaterial const* mat;
+    int firstVertex;
+    int indexCount;
+    tg::pos3 chunkPos;
+    float voxelSize;
+    float camDis;
+};
+} // namespace
+
+int main(int argc, char** argv)
+{
+    auto drawCount = argc > 1 ? std::atoi(argv[1]) : 20000;
+    auto frames = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    // 3 programs (opaque, glass, water), 13 materials
+    std::vector<RenderMaterial> materials(13);
+    for (auto i = 0; i < (int)materials.size(); ++i)
+        materials[i].id = i;
+    auto program = [](int i) { return reinterpret_cast<glow::Program*>(uintptr_t(0x1000 + i * 0x100)); };
+    auto programOf = [&](int mat) { return program(mat < 11 ? 0 : mat - 10); };
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dis(0.5f, 600.0f);
+    std::vector<std::vector<Input>> frameInputs(8);
+    for (auto& inputs : frameInputs)
+        for (auto i = 0; i < drawCount; ++i)
+        {
+            auto mat = int(rng() % materials.size());
+            inputs.push_back({{programOf(mat), &materials[mat], 4 * 64 * i, 6 * 64, {}, 1.0f}, dis(rng)});
+        }
+
+    // old: fresh vector, comparator on pointers
+    auto runSort = [&](std::vector<Input> const& inputs) {
+        std::vector<RenderJob> jobs;
+        for (auto const& in : inputs)
+        {
+            auto const& d = in.draw;
+            jobs.push_back({d.program, d.mat, d.firstVertex, d.indexCount, d.chunkPos, d.voxelSize, in.distance});
+        }
+        std::sort(jobs.begin(), jobs.end(), [](RenderJob const& a, RenderJob const& b) {
+            if (a.program != b.program)
+                return a.program < b.program;
+            if (a.mat != b.mat)
+                return a.mat < b.mat;
+            return a.camDis < b.camDis;
+        });
+        return jobs.size();
+    };
+
+    // new: persistent queue
+    RenderQueue queue;
+    auto runQueue = [&](std::vector<Input> const& inputs) {
+        queue.clear();
+        for (auto const& in : inputs)
+            queue.add(in.draw, in.draw.mat->id, in.distance);
+        queue.sort();
+        return size_t(queue.size());
+    };
+
+    // every program and material is one contiguous group, distances ascend within a group, no draw is lost
+    // (the order of the groups differs: std::sort orders by address, the queue by id)
+    {
+        runQueue(frameInputs[0]);
+        auto index = [](int firstVertex) { return firstVertex / (4 * 64); };
+        std::vector<float> distance(drawCount);
+        for (auto const& in : frameInputs[0])
+            distance[index(in.draw.firstVertex)] = in.distance;
+
+        std::vector<bool> seenDraw(drawCount), seenMat(materials.size());
+        std::vector<glow::Program*> seenPrograms;
+        for (auto i = 0; i < queue.size(); ++i)
+        {
+            auto const& d = queue[i];
+            auto const* prev = i > 0 ? &queue[i - 1] : nullptr;
+            if (!prev || prev->program != d.program)
+            {
+                if (std::count(seenPrograms.begin(), seenPrograms.end(), d.program))
+                {
+                    std::printf("MISMATCH: program split at draw %d\n", i);
+                    return EXIT_FAILURE;
+                }
+                seenPrograms.push_back(d.program);
+            }
+            if (!prev || prev->mat != d.mat)
+            {
+                if (seenMat[d.mat->id])
+                {
+                    std::printf("MISMATCH: material split at draw %d\n", i);
+                    return EXIT_FAILURE;
+                }
+                seenMat[d.mat->id] = true;
+            }
+            else if (distance[index(prev->firstVertex)] > distance[index(d.firstVertex)] * 1.001f)
+            {
+                std::printf("MISMATCH: not front-to-back at draw %d\n", i);
+                return EXIT_FAILURE;
+            }
+            seenDraw[index(d.firstVertex)] = true;
+        }
+        if (queue.size() != drawCount || std::count(seenDraw.begin(), seenDraw.end(), false))
+        {
+            std::printf("MISMATCH: draws lost\n");
+            return EXIT_FAILURE;
+        }
+        std::printf("verified order of %d draws\n\n", queue.size());
+    }
+
+    auto run = [&](char const* name, auto&& method) {
+        method(frameInputs[0]); // warm-up (the queue allocates its buffers)
+        size_t checksum = 0;
+        auto allocs0 = allocations.load();
+        auto t0 = now();
+        for (auto f = 0; f < frames; ++f)
+            checksum += method(frameInputs[f % frameInputs.size()]);
+        auto dt = now() - t0;
+        std::printf("%-12s %8.3f ms/frame  %6.1f allocations/frame  (checksum %zu)\n", name, dt * 1000 / frames,
+                    (allocations.load() - allocs0) / double(frames), checksum);
+    };
+
+    run("std::sort", runSort);
+    run("RenderQueue", runQueue);
+
+    return EXIT_SUCCESS;
+}
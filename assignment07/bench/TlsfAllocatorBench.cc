@@ -0,0 +1,173 @@
+// Microbenchmark and self-check of the TLSF sub-allocator of the terrain arena (see helper/TlsfAllocator.hh)
+//
+// Mirrors the mesh streaming of the terrain without GL: meshes of 1 .. 4096 quads (log-uniform sizes),
+// a steady number of live meshes, every frame some of them are replaced (remeshing, chunks streaming in and out).
+// The arena grows by doubling when an allocation fails, like TerrainArena.
+// The churn is timed without any memory access, then replayed with a shadow copy of the arena (one tag per unit)
+// that checks that allocations never overlap and that defragment moves preserve their contents.
+// Usage: rtg_tlsf_bench [live meshes] [frames] [replaced per frame]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../helper/TlsfAllocator.hh"
+
+namespace
+{
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Live
+{
+    TlsfAllocator::Handle handle;
+    uint32_t size;
+    uint32_t tag;
+};
+} // namespace
+
+int main(int argc, char** argv)
+{
+    auto liveCount = argc > 1 ? std::atoi(argv[1]) : 20000;
+    auto frames = argc > 2 ? std::atoi(argv[2]) : 500;
+    auto perFrame = argc > 3 ? std::atoi(argv[3]) : 200;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> logSize(0.0f, std::log2(4096.0f));
+    auto randomSize = [&] { return uint32_t(std::exp2(logSize(rng))); };
+
+    TlsfAllocator alloc;
+    std::vector<uint32_t> shadow;
+    auto useShadow = false;
+    auto nextTag = 1u;
+    auto grows = 0;
+
+    auto allocate = [&](uint32_t size) {
+        auto h = alloc.allocate(size);
+        while (h == TlsfAllocator::invalidHandle)
+        {
+            alloc.grow(alloc.getCapacity() * 2);
+            ++grows;
+            h = alloc.allocate(size);
+        }
+        auto tag = nextTag++;
+        if (useShadow)
+        {
+            shadow.resize(alloc.getCapacity(), 0);
+            std::fill_n(shadow.begin() + alloc.getOffset(h), size, tag);
+        }
+        return Live{h, size, tag};
+    };
+
+    auto check = [&](std::vector<Live> const& live, char const* when) {
+        if (!alloc.isConsistent())
+        {
+            std::printf("INCONSISTENT after %s\n", when);
+            return false;
+        }
+        // (a unit overwritten by an overlapping allocation has the wrong tag)
+        for (auto const& l : live)
+        {
+            auto o = alloc.getOffset(l.handle);
+            if (alloc.getSize(l.handle) != l.size || o + l.size > alloc.getCapacity()
+                || std::count(shadow.begin() + o, shadow.begin() + o + l.size, l.tag) != l.size)
+            {
+                std::printf("MISMATCH: allocation %u after %s\n", l.tag, when);
+                return false;
+            }
+        }
+        return true;
+    };
+
+    auto printStats = [&](char const* name) {
+        auto s = alloc.getStats();
+        auto mb = [](uint32_t units) { return units * 32.0 / 1e6; };
+        std::printf("%-18s capacity %6.1f MB, used %6.1f MB, end %6.1f MB, %6u free blocks, largest free %6.1f MB\n",
+                    name, mb(s.capacity), mb(s.usedUnits), mb(s.end), s.freeBlocks, mb(s.largestFreeBlock));
+    };
+
+    // churn: replace random meshes, every replaced mesh gets a new size
+    std::vector<uint32_t> initialSizes(liveCount);
+    for (auto& s : initialSizes)
+        s = randomSize();
+    std::vector<uint32_t> sizes(size_t(frames) * perFrame);
+    std::vector<size_t> victims(sizes.size());
+    for (auto i = 0u; i < sizes.size(); ++i)
+    {
+        sizes[i] = randomSize();
+        victims[i] = rng() % liveCount;
+    }
+
+    std::vector<Live> live;
+    auto churn = [&] {
+        alloc.reset(1 << 16);
+        shadow.assign(alloc.getCapacity(), 0);
+        grows = 0;
+
+        live.clear();
+        for (auto s : initialSizes)
+            live.push_back(allocate(s));
+
+        auto t0 = now();
+        for (auto i = 0u; i < sizes.size(); ++i)
+        {
+            auto& l = live[victims[i]];
+            alloc.free(l.handle);
+            l = allocate(sizes[i]);
+        }
+        return now() - t0;
+    };
+
+    std::printf("units are quads (32 bytes)\n");
+    auto dt = churn();
+    std::printf("%d x (free + allocate): %.1f ns per pair, %d grows\n", int(sizes.size()), dt * 1e9 / sizes.size(), grows);
+
+    useShadow = true;
+    churn();
+    if (!check(live, "churn"))
+        return EXIT_FAILURE;
+    printStats("after churn");
+
+    // defragment with a budget of 4 MB per frame
+    std::vector<TlsfAllocator::Move> moves;
+    auto defragFrames = 0;
+    auto movedUnits = 0u;
+    auto defragTime = 0.0;
+    while (true)
+    {
+        moves.clear();
+        auto t = now();
+        auto moved = alloc.defragment(4 * 1024 * 1024 / 32, 4096, moves);
+        defragTime += now() - t;
+        if (moved == 0)
+            break;
+
+        for (auto const& m : moves)
+            std::copy_n(shadow.begin() + m.oldOffset, m.size, shadow.begin() + m.newOffset);
+        movedUnits += moved;
+        ++defragFrames;
+    }
+    if (!check(live, "defragment"))
+        return EXIT_FAILURE;
+    std::printf("defragment: %d frames, %.1f MB moved, %.3f ms per frame (without the copies)\n", defragFrames,
+                movedUnits * 32 / 1e6, defragFrames ? defragTime * 1000 / defragFrames : 0.0);
+    printStats("after defragment");
+
+    for (auto const& l : live)
+        alloc.free(l.handle);
+    auto s = alloc.getStats();
+    if (!alloc.isConsistent() || s.allocations != 0 || s.freeBlocks != 1)
+    {
+        std::printf("MISMATCH: not empty after freeing everything\n");
+        return EXIT_FAILURE;
+    }
+    std::printf("verified\n");
+
+    return EXIT_SUCCESS;
+}
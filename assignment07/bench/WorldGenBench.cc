@@ -0,0 +1,291 @@
+// Benchmark: headless terrain generation (no window, no GL context, no World)
+//
+// Generates a block of NX x NY x NZ chunks with the same generator, column cache, and materials as World,
+// optionally meshes them, and prints the results as JSON (for tracking across commits and thread counts).
+//
+// Usage: rtg_worldgen_bench [options]
+//   --chunks NX NY NZ   size of the block in chunks (default 16 4 16)
+//   --origin X Y Z      first chunk coordinate (default -8 -2 -8)
+//   --threads T         worker threads (default 1)
+//   --seed S            noise seed (default 1337, like World)
+//   --kernel K          noise batch kernel: auto, scalar, sse41, avx2 (default auto)
+//   --no-mesh           skip the meshing stage
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include <typed-geometry/tg.hh>
+
+#include "../BlockStorage.hh"
+#include "../ColumnCache.hh"
+#include "../Constants.hh"
+#include "../MeshGenerator.hh"
+#include "../TerrainGenerator.hh"
+#include "../helper/MemoryPool.hh"
+
+#include "BenchMaterials.hh"
+
+namespace
+{
+double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// peak resident set size of the process in bytes
+size_t peakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss); // bytes
+#else
+    return size_t(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+#endif
+}
+
+char const* kernelName(FastNoise::BatchKernel k)
+{
+    switch (k)
+    {
+    case FastNoise::BatchScalar:
+        return "scalar";
+    case FastNoise::BatchSSE41:
+        return "sse41";
+    case FastNoise::BatchAVX2:
+        return "avx2";
+    default:
+        return "auto";
+    }
+}
+
+/// runs job(i, thread) for i in [0, count) on the given number of threads
+template <class JobF>
+void parallelFor(int count, int threads, JobF&& job)
+{
+    std::atomic<int> next = {0};
+    auto work = [&](int thread) {
+        for (auto i = next++; i < count; i = next++)
+            job(i, thread);
+    };
+
+    std::vector<std::thread> pool;
+    for (auto t = 1; t < threads; ++t)
+        pool.emplace_back(work, t);
+    work(0);
+    for (auto& t : pool)
+        t.join();
+}
+
+void printStage(char const* name, double seconds, double voxels, bool last = false)
+{
+    std::printf("    \"%s\": {\"cpuSeconds\": %.6f, \"nsPerVoxel\": %.3f}%s\n", name, seconds, seconds * 1e9 / voxels,
+                last ? "" : ",");
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    tg::ivec3 size = {16, 4, 16};
+    tg::ivec3 origin = {-8, -2, -8};
+    auto threads = 1;
+    auto seed = 1337;
+    auto kernel = FastNoise::BatchAuto;
+    auto mesh = true;
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        auto arg = std::string(argv[i]);
+        auto hasArgs = [&](int n) { return i + n < argc; };
+
+        if (arg == "--chunks" && hasArgs(3))
+        {
+            for (auto d = 0; d < 3; ++d)
+                size[d] = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--origin" && hasArgs(3))
+        {
+            for (auto d = 0; d < 3; ++d)
+                origin[d] = std::atoi(argv[++i]);
+        }
+        else if (arg == "--threads" && hasArgs(1))
+            threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--seed" && hasArgs(1))
+            seed = std::atoi(argv[++i]);
+        else if (arg == "--kernel" && hasArgs(1))
+        {
+            auto k = std::string(argv[++i]);
+            kernel = k == "scalar" ? FastNoise::BatchScalar
+                                   : k == "sse41" ? FastNoise::BatchSSE41
+                                                  : k == "avx2" ? FastNoise::BatchAVX2 : FastNoise::BatchAuto;
+        }
+        else if (arg == "--no-mesh")
+            mesh = false;
+        else
+        {
+            std::fprintf(stderr, "unknown or incomplete option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FastNoise::SetBatchKernel(kernel);
+
+    std::vector<Material> materialsOpaque, materialsTranslucent;
+    setUpBenchMaterials(materialsOpaque, materialsTranslucent);
+
+    TerrainGenerator generator(seed);
+    generator.setMaterials(materialsOpaque, materialsTranslucent);
+
+    // chunks ordered column by column (top to bottom, like the world streams them in)
+    auto const chunkCount = size.x * size.y * size.z;
+    auto chunkPosOf = [&](int i) {
+        auto column = i / size.y;
+        auto y = size.y - 1 - i % size.y;
+        return tg::ipos3::zero + (origin + tg::ivec3(column % size.x, y, column / size.x)) * CHUNK_SIZE;
+    };
+    auto chunkIdxOf = [&](tg::ivec3 c) { return ((c.z * size.x) + c.x) * size.y + (size.y - 1 - c.y); };
+
+    // all chunks are resident, so every column is computed once
+    ColumnCache columns;
+    for (auto i = 0; i < chunkCount; ++i)
+        columns.retain(chunkPosOf(i));
+
+    std::vector<BlockStorage> chunks(chunkCount, BlockStorage(Block::invalid()));
+
+    // generation
+    std::vector<TerrainGenerator::StageTimes> threadTimes(threads);
+    auto t0 = now();
+    parallelFor(chunkCount, threads, [&](int i, int thread) {
+        auto& times = threadTimes[thread];
+        auto cp = chunkPosOf(i);
+        auto column = columns.acquire(cp, [&](TerrainColumn& col) { generator.generateColumn(cp, col, &times); });
+        generator.generate(cp, *column, chunks[i], &times);
+    });
+    auto genSeconds = now() - t0;
+
+    TerrainGenerator::StageTimes times;
+    for (auto const& t : threadTimes)
+        times += t;
+
+    // meshing (greedy, blocks of missing neighbors are invalid like in World::triggerMeshUpdate)
+    auto meshSeconds = 0.0;
+    std::vector<double> threadMeshTimes(threads, 0.0);
+    std::vector<int64_t> threadVertices(threads, 0);
+    if (mesh)
+    {
+        auto const cs = CHUNK_SIZE + 2;
+
+        t0 = now();
+        parallelFor(chunkCount, threads, [&](int i, int thread) {
+            auto ts = now();
+
+            auto cp = chunkPosOf(i);
+            PooledVector<Block> blocks(cs * cs * cs, Block::invalid());
+            auto bmin = cp - 1;
+            auto bmax = cp + CHUNK_SIZE + 1;
+            for (auto dz : {-1, 0, 1})
+                for (auto dy : {-1, 0, 1})
+                    for (auto dx : {-1, 0, 1})
+                    {
+                        auto ncp = cp + CHUNK_SIZE * tg::ivec3(dx, dy, dz);
+                        auto c = (ncp - tg::ipos3::zero) / CHUNK_SIZE - origin;
+                        if (c.x < 0 || c.y < 0 || c.z < 0 || c.x >= size.x || c.y >= size.y || c.z >= size.z)
+                            continue;
+
+                        auto const& nb = chunks[chunkIdxOf(c)];
+                        auto min = tg::clamp(ncp, bmin, bmax) - ncp;
+                        auto max = tg::clamp(ncp + CHUNK_SIZE, bmin, bmax) - ncp;
+                        for (auto z = min.z; z < max.z; ++z)
+                            for (auto y = min.y; y < max.y; ++y)
+                            {
+                                auto ty = y + dy * CHUNK_SIZE + 1;
+                                auto tz = z + dz * CHUNK_SIZE + 1;
+                                auto tminx = min.x + dx * CHUNK_SIZE + 1;
+                                nb.copyTo((z * CHUNK_SIZE + y) * CHUNK_SIZE + min.x, max.x - min.x,
+                                          &blocks[(tz * cs + ty) * cs + tminx]);
+                            }
+                    }
+
+            for (auto const& m : generateMesh(blocks, cp, MeshingMode::Greedy))
+                threadVertices[thread] += int64_t(m.vertices.size());
+
+            threadMeshTimes[thread] += now() - ts;
+        });
+        meshSeconds = now() - t0;
+    }
+
+    // summary
+    int blockKinds[3] = {0, 0, 0};
+    size_t blockBytes = 0;
+    for (auto const& c : chunks)
+    {
+        ++blockKinds[int(c.getKind())];
+        blockBytes += c.getMemoryUsage();
+    }
+
+    auto meshCpuSeconds = 0.0;
+    int64_t vertices = 0;
+    for (auto t = 0; t < threads; ++t)
+    {
+        meshCpuSeconds += threadMeshTimes[t];
+        vertices += threadVertices[t];
+    }
+
+    auto const voxels = double(chunkCount) * CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+    auto pool = MemoryPool::global().getStats();
+
+    std::printf("{\n");
+    std::printf("  \"benchmark\": \"worldgen\",\n");
+    std::printf("  \"config\": {\"chunks\": [%d, %d, %d], \"origin\": [%d, %d, %d], \"chunkSize\": %d, \"threads\": %d, "
+                "\"seed\": %d, \"kernel\": \"%s\", \"mesh\": %s},\n",
+                size.x, size.y, size.z, origin.x, origin.y, origin.z, CHUNK_SIZE, threads, seed,
+                kernelName(FastNoise::GetBatchKernel()), mesh ? "true" : "false");
+    std::printf("  \"chunks\": %d,\n", chunkCount);
+    std::printf("  \"voxels\": %.0f,\n", voxels);
+    std::printf("  \"columns\": %d,\n", columns.size());
+    std::printf("  \"seconds\": %.6f,\n", genSeconds);
+    std::printf("  \"chunksPerSecond\": %.2f,\n", chunkCount / genSeconds);
+    std::printf("  \"nsPerVoxel\": %.3f,\n", genSeconds * 1e9 / voxels);
+    std::printf("  \"stages\": {\n");
+    printStage("column", times.column, voxels);
+    printStage("noise", times.noise, voxels);
+    printStage("blocks", times.blocks, voxels);
+    printStage("compact", times.compact, voxels, !mesh);
+    if (mesh)
+        printStage("mesh", meshCpuSeconds, voxels, true);
+    std::printf("  },\n");
+    if (mesh)
+        std::printf("  \"mesh\": {\"seconds\": %.6f, \"chunksPerSecond\": %.2f, \"vertices\": %lld},\n", meshSeconds,
+                    chunkCount / meshSeconds, (long long)vertices);
+    std::printf("  \"storage\": {\"uniform\": %d, \"palette\": %d, \"dense\": %d, \"bytes\": %zu},\n", blockKinds[0],
+                blockKinds[1], blockKinds[2], blockBytes);
+    std::printf("  \"memory\": {\"peakBytes\": %zu, \"poolReservedBytes\": %zu, \"poolHeapAllocations\": %lld}\n",
+                peakMemory(), pool.reservedBytes, (long long)pool.heapAllocations);
+    std::printf("}\n");
+
+    return EXIT_SUCCESS;
+}
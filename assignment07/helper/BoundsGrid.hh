@@ -0,0 +1,229 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include <typed-geometry/tg-std.hh>
+#include <typed-geometry/tg.hh>
+
+/// result of a bounding box test during BoundsGrid::query
+enum class BoundsTest
+{
+    Outside, ///< the box and everything below it is rejected
+    Partial, ///< the children are tested individually
+    Inside   ///< everything below is accepted without further tests
+};
+
+/**
+ * @brief Multi-level grid of bounding boxes over integer cells
+ *
+ * Every item occupies one cell of level 0 and has a bounding box.
+ * A node of level l covers 2^l x 2^l x 2^l cells and stores the union of the boxes of its (up to 8) children.
+ * Nodes only exist while there is at least one item below them.
+ *
+ * Queries start at the nodes of the top level and reject or accept whole nodes at once,
+ * so their cost depends on the accepted items (and the nodes along their border), not on all items.
+ *
+ * Updates are incremental: set and remove only mark the ancestors of a cell,
+ * refresh recomputes their boxes from their children (must be called before the next query).
+ */
+template <class T, int Levels = 4>
+class BoundsGrid
+{
+private:
+    struct Node
+    {
+        tg::pos3 aabbMin;
+        tg::pos3 aabbMax;
+        /// child i covers the cell (i & 1, i >> 1 & 1, i >> 2 & 1) relative to 2 * cell
+        /// (nullptr if there is none, elements of unordered_map are not moved by rehashing)
+        Node* children[8] = {};
+        bool isDirty = false;
+        T value = T(); ///< level 0 only
+
+        bool hasChildren() const
+        {
+            for (auto c : children)
+                if (c)
+                    return true;
+            return false;
+        }
+    };
+
+    /// nodes per level, indexed by their cell (cell of level 0 >> level)
+    std::unordered_map<tg::ipos3, Node> mNodes[Levels + 1];
+    /// nodes whose box is outdated, per level
+    std::vector<tg::ipos3> mDirty[Levels + 1];
+
+public:
+    /// inserts or updates an item
+    void set(tg::ipos3 cell, T const& value, tg::pos3 aabbMin, tg::pos3 aabbMax)
+    {
+        auto& item = mNodes[0][cell];
+        item.aabbMin = aabbMin;
+        item.aabbMax = aabbMax;
+        item.value = value;
+
+        // create missing ancestors
+        auto c = cell;
+        auto child = &item;
+        for (auto l = 1; l <= Levels; ++l)
+        {
+            auto parent = parentCell(c);
+            auto& node = mNodes[l][parent];
+            auto isNew = !node.hasChildren();
+            node.children[childIndex(c)] = child;
+            if (!isNew)
+                break; // existing nodes already have their ancestors
+            c = parent;
+            child = &node;
+        }
+
+        markDirty(1, parentCell(cell));
+    }
+
+    /// removes an item (if it exists)
+    void remove(tg::ipos3 cell)
+    {
+        if (mNodes[0].erase(cell) == 0)
+            return;
+
+        // remove empty ancestors, the others shrink
+        auto c = cell;
+        for (auto l = 1; l <= Levels; ++l)
+        {
+            auto parent = parentCell(c);
+            auto it = mNodes[l].find(parent);
+            TG_ASSERT(it != mNodes[l].end());
+            it->second.children[childIndex(c)] = nullptr;
+            if (it->second.hasChildren())
+            {
+                markDirty(l, parent);
+                return;
+            }
+
+            mNodes[l].erase(it);
+            c = parent;
+        }
+    }
+
+    /// removes all items
+    void clear()
+    {
+        for (auto l = 0; l <= Levels; ++l)
+        {
+            mNodes[l].clear();
+            mDirty[l].clear();
+        }
+    }
+
+    /// recomputes the boxes of all nodes whose items changed (bottom-up)
+    void refresh()
+    {
+        for (auto l = 1; l <= Levels; ++l)
+        {
+            for (auto c : mDirty[l])
+            {
+                auto it = mNodes[l].find(c);
+                if (it == mNodes[l].end())
+                    continue; // removed in the meantime
+
+                auto& node = it->second;
+                auto first = true;
+                for (auto child : node.children)
+                {
+                    if (!child)
+                        continue;
+
+                    node.aabbMin = first ? child->aabbMin : tg::min(node.aabbMin, child->aabbMin);
+                    node.aabbMax = first ? child->aabbMax : tg::max(node.aabbMax, child->aabbMax);
+                    first = false;
+                }
+                node.isDirty = false;
+            }
+            mDirty[l].clear();
+        }
+    }
+
+    /// calls f(value) for every item whose box and ancestors are not rejected by test(aabbMin, aabbMax)
+    /// returns the number of tests
+    /// CAUTION: requires refresh after the last update
+    template <class TestF, class F>
+    int query(TestF&& test, F&& f) const
+    {
+        struct NoState
+        {
+        };
+        return queryWithState(
+            NoState{}, [&](tg::pos3 amin, tg::pos3 amax, NoState&) { return test(amin, amax); },
+            [&](T const& value, NoState const&) { f(value); });
+    }
+
+    /// like query, but the test may narrow a state (e.g. a set of views) that is passed on to the children:
+    /// test(aabbMin, aabbMax, state&) starts with the state of the parent (root for the top level),
+    /// f(value, state) is called with the final state of an item
+    /// (Inside accepts everything below with the current state)
+    template <class State, class TestF, class F>
+    int queryWithState(State const& root, TestF&& test, F&& f) const
+    {
+        auto tests = 0;
+        for (auto const& nodePair : mNodes[Levels])
+            visit(Levels, nodePair.second, false, root, test, f, tests);
+        return tests;
+    }
+
+    /// number of items
+    int size() const { return (int)mNodes[0].size(); }
+    /// number of nodes of all levels above the items
+    int getNodeCount() const
+    {
+        auto count = 0;
+        for (auto l = 1; l <= Levels; ++l)
+            count += (int)mNodes[l].size();
+        return count;
+    }
+
+private:
+    // >> 1 rounds towards negative infinity (two's complement)
+    static tg::ipos3 parentCell(tg::ipos3 c) { return {c.x >> 1, c.y >> 1, c.z >> 1}; }
+    static int childIndex(tg::ipos3 c) { return (c.x & 1) | (c.y & 1) << 1 | (c.z & 1) << 2; }
+
+    /// marks a node of the given level and all its ancestors as outdated
+    void markDirty(int level, tg::ipos3 cell)
+    {
+        for (auto l = level; l <= Levels; ++l, cell = parentCell(cell))
+        {
+            auto& node = mNodes[l].at(cell);
+            if (node.isDirty)
+                return; // the ancestors are marked as well
+
+            node.isDirty = true;
+            mDirty[l].push_back(cell);
+        }
+    }
+
+    template <class State, class TestF, class F>
+    void visit(int level, Node const& node, bool inside, State state, TestF& test, F& f, int& tests) const
+    {
+        TG_ASSERT(!node.isDirty && "refresh is missing");
+
+        if (!inside)
+        {
+            ++tests;
+            auto r = test(node.aabbMin, node.aabbMax, state);
+            if (r == BoundsTest::Outside)
+                return;
+            inside = r == BoundsTest::Inside;
+        }
+
+        if (level == 0)
+        {
+            f(node.value, state);
+            return;
+        }
+
+        for (auto child : node.children)
+            if (child)
+                visit(level - 1, *child, inside, state, test, f, tests);
+    }
+};
@@ -0,0 +1,121 @@
+#include "MemoryPool.hh"
+
+#include <algorithm>
+#include <new>
+
+#include "../Constants.hh"
+
+namespace
+{
+constexpr size_t minSlabSize = 256 * 1024;
+
+// padded blocks for meshing (chunk plus 1 neighborhood), rounded up so that every element stays aligned
+constexpr size_t neighborhoodSize
+    = ((CHUNK_SIZE + 2) * (CHUNK_SIZE + 2) * (CHUNK_SIZE + 2) + MemoryPool::alignment - 1) / MemoryPool::alignment
+      * MemoryPool::alignment;
+
+void* allocateAligned(size_t size) { return ::operator new(size, std::align_val_t(MemoryPool::alignment)); }
+void freeAligned(void* p) { ::operator delete(p, std::align_val_t(MemoryPool::alignment)); }
+} // namespace
+
+MemoryPool::MemoryPool()
+{
+    // powers of two from 64 B to 1 MB (and the mesh neighborhood)
+    size_t sizes[sizeClassCount];
+    auto count = 0;
+    for (size_t s = 64; s <= 1024 * 1024; s *= 2)
+        sizes[count++] = s;
+    sizes[count++] = neighborhoodSize;
+    std::sort(sizes, sizes + count);
+
+    for (auto i = 0; i < sizeClassCount; ++i)
+        mClasses[i].size = i < count ? sizes[i] : 0;
+}
+
+MemoryPool::~MemoryPool()
+{
+    for (auto& c : mClasses)
+        for (auto s : c.slabs)
+            freeAligned(s);
+}
+
+MemoryPool& MemoryPool::global()
+{
+    static MemoryPool pool;
+    return pool;
+}
+
+int MemoryPool::sizeClassOf(size_t size) const
+{
+    for (auto i = 0; i < sizeClassCount; ++i)
+        if (size <= mClasses[i].size)
+            return i;
+    return -1;
+}
+
+void* MemoryPool::allocate(size_t size)
+{
+    ++mAllocations;
+
+    auto ci = sizeClassOf(size);
+    if (ci < 0)
+    {
+        ++mHeapAllocations;
+        return allocateAligned(size);
+    }
+
+    auto& c = mClasses[ci];
+    std::lock_guard<std::mutex> lock(c.mutex);
+
+    if (!c.freeList)
+    {
+        // new slab
+        auto count = std::max(size_t(1), minSlabSize / c.size);
+        auto slab = static_cast<char*>(allocateAligned(count * c.size));
+
+        ++mHeapAllocations;
+        mReservedBytes += count * c.size;
+        c.slabs.push_back(slab);
+
+        for (auto i = count; i-- > 0;)
+        {
+            auto p = slab + i * c.size;
+            *reinterpret_cast<void**>(p) = c.freeList;
+            c.freeList = p;
+        }
+    }
+
+    auto p = c.freeList;
+    c.freeList = *reinterpret_cast<void**>(p);
+    return p;
+}
+
+void MemoryPool::deallocate(void* p, size_t size)
+{
+    if (!p)
+        return;
+
+    ++mDeallocations;
+
+    auto ci = sizeClassOf(size);
+    if (ci < 0)
+    {
+        freeAligned(p);
+        return;
+    }
+
+    auto& c = mClasses[ci];
+    std::lock_guard<std::mutex> lock(c.mutex);
+    *reinterpret_cast<void**>(p) = c.freeList;
+    c.freeList = p;
+}
+
+MemoryPool::Stats MemoryPool::getStats() const
+{
+    Stats s;
+    s.allocations = mAllocations;
+    s.deallocations = mDeallocations;
+    s.heapAllocations = mHeapAllocations;
+    s.reservedBytes = mReservedBytes;
+    return s;
+}
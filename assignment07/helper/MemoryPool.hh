@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Slab allocator with size classes, shared by all threads
+ *
+ * Requests are rounded up to the next size class (64 B .. 1 MB and the padded 34^3 mesh neighborhood).
+ * All size classes are multiples of 64 B and all memory is 64 B aligned (cache lines, SIMD loads).
+ * Every size class keeps a free list, new memory is allocated in slabs of at least 256 KB.
+ * Freed memory is never returned to the heap but recycled (also across threads, e.g. memory allocated
+ * by a worker and freed by the render thread).
+ * Larger requests go directly to the heap.
+ *
+ * getStats().heapAllocations stays constant once streaming reached a steady state.
+ */
+class MemoryPool
+{
+public:
+    /// alignment of all returned memory
+    static constexpr size_t alignment = 64;
+
+    struct Stats
+    {
+        int64_t allocations = 0;     ///< total number of allocate() calls
+        int64_t deallocations = 0;   ///< total number of deallocate() calls
+        int64_t heapAllocations = 0; ///< slabs and oversized requests
+        size_t reservedBytes = 0;    ///< memory in slabs (used or free)
+    };
+
+private:
+    struct SizeClass
+    {
+        size_t size = 0;
+        std::mutex mutex;
+        void* freeList = nullptr; ///< intrusive singly linked list
+        std::vector<void*> slabs;
+    };
+
+    static constexpr int sizeClassCount = 16;
+    SizeClass mClasses[sizeClassCount];
+
+    std::atomic<int64_t> mAllocations = {0};
+    std::atomic<int64_t> mDeallocations = {0};
+    std::atomic<int64_t> mHeapAllocations = {0};
+    std::atomic<size_t> mReservedBytes = {0};
+
+public:
+    MemoryPool();
+    ~MemoryPool();
+
+    MemoryPool(MemoryPool const&) = delete;
+    MemoryPool& operator=(MemoryPool const&) = delete;
+
+    /// the pool used by PoolAllocator
+    static MemoryPool& global();
+
+    /// thread-safe
+    void* allocate(size_t size);
+    /// thread-safe, size must be the size used for allocate
+    void deallocate(void* p, size_t size);
+
+    Stats getStats() const;
+
+private:
+    /// returns -1 if size is too large for the pool
+    int sizeClassOf(size_t size) const;
+};
+
+/// std allocator that uses MemoryPool::global()
+template <class T>
+struct PoolAllocator
+{
+    using value_type = T;
+
+    static_assert(alignof(T) <= MemoryPool::alignment, "type is over-aligned for the pool");
+
+    PoolAllocator() = default;
+    template <class U>
+    PoolAllocator(PoolAllocator<U> const&)
+    {
+    }
+
+    T* allocate(size_t n) { return static_cast<T*>(MemoryPool::global().allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { MemoryPool::global().deallocate(p, n * sizeof(T)); }
+
+    template <class U>
+    bool operator==(PoolAllocator<U> const&) const
+    {
+        return true;
+    }
+    template <class U>
+    bool operator!=(PoolAllocator<U> const&) const
+    {
+        return false;
+    }
+};
+
+/// vector with pooled storage
+template <class T>
+using PooledVector = std::vector<T, PoolAllocator<T>>;
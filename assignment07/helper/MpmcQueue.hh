@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/**
+ * @brief Bounded multi-producer multi-consumer queue (lock-free)
+ *
+ * Ring buffer where every cell carries a sequence number that tells producers and consumers
+ * whether the cell is ready for them (D. Vyukov's bounded MPMC queue).
+ * Capacity is rounded up to a power of two.
+ */
+template <class T>
+class MpmcQueue
+{
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> mCells;
+    size_t mMask;
+
+    // separate cache lines for producers and consumers
+    alignas(64) std::atomic<size_t> mEnqueuePos = {0};
+    alignas(64) std::atomic<size_t> mDequeuePos = {0};
+
+public:
+    explicit MpmcQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+
+        mCells.reset(new Cell[size]);
+        mMask = size - 1;
+        for (size_t i = 0; i < size; ++i)
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcQueue(MpmcQueue const&) = delete;
+    MpmcQueue& operator=(MpmcQueue const&) = delete;
+
+    size_t capacity() const { return mMask + 1; }
+
+    /// moves value into the queue
+    /// returns false (and leaves value untouched) if the queue is full
+    bool tryPush(T& value)
+    {
+        auto pos = mEnqueuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            auto& cell = mCells[pos & mMask];
+            auto seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+
+            if (diff == 0) // cell is free
+            {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.data = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) // full
+                return false;
+            else // another producer was faster
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    /// moves the oldest element into value
+    /// returns false if the queue is empty
+    bool tryPop(T& value)
+    {
+        auto pos = mDequeuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            auto& cell = mCells[pos & mMask];
+            auto seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+
+            if (diff == 0) // cell is filled
+            {
+                if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.data);
+                    cell.data = T(); // release resources early
+                    cell.sequence.store(pos + mMask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) // empty
+                return false;
+            else // another consumer was faster
+                pos = mDequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    /// approximate (other threads may push or pop concurrently)
+    bool empty() const
+    {
+        return mEnqueuePos.load(std::memory_order_relaxed) == mDequeuePos.load(std::memory_order_relaxed);
+    }
+};
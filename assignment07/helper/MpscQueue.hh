@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief Unbounded multi-producer single-consumer queue
+ *
+ * Linked list of nodes (D. Vyukov's MPSC queue):
+ * producers atomically exchange the head, the single consumer walks from the tail.
+ * The queue itself takes no lock, but push allocates a node and tryPop frees one with Alloc
+ * (rebound to the node type), so both are only as lock-free as the allocator.
+ * CAUTION: MemoryPool (PoolAllocator) locks a mutex per allocation, use the default std::allocator
+ * if the consumer must not wait for other threads.
+ */
+template <class T, class Alloc = std::allocator<T>>
+class MpscQueue
+{
+private:
+    struct Node
+    {
+        std::atomic<Node*> next = {nullptr};
+        T value;
+    };
+
+    using NodeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAlloc>;
+    NodeAlloc mAlloc;
+
+    /// most recently pushed node (producers)
+    std::atomic<Node*> mHead;
+    /// already consumed node, its successor is the oldest element (consumer only)
+    Node* mTail;
+
+public:
+    MpscQueue()
+    {
+        auto stub = createNode();
+        mHead.store(stub, std::memory_order_relaxed);
+        mTail = stub;
+    }
+
+    ~MpscQueue()
+    {
+        T value;
+        while (tryPop(value))
+        {
+        }
+        destroyNode(mTail);
+    }
+
+    MpscQueue(MpscQueue const&) = delete;
+    MpscQueue& operator=(MpscQueue const&) = delete;
+
+    /// may be called from any thread
+    void push(T value)
+    {
+        auto node = createNode();
+        node->value = std::move(value);
+
+        auto prev = mHead.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /// must only be called from the consumer thread
+    /// returns false if the queue is empty (or a push is not yet completed)
+    bool tryPop(T& value)
+    {
+        auto tail = mTail;
+        auto next = tail->next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+
+        // next becomes the new (consumed) tail
+        value = std::move(next->value);
+        next->value = T();
+        mTail = next;
+        destroyNode(tail);
+        return true;
+    }
+
+private:
+    Node* createNode()
+    {
+        auto node = NodeTraits::allocate(mAlloc, 1);
+        NodeTraits::construct(mAlloc, node);
+        return node;
+    }
+
+    void destroyNode(Node* node)
+    {
+        NodeTraits::destroy(mAlloc, node);
+        NodeTraits::deallocate(mAlloc, node, 1);
+    }
+};
@@ -30,10 +30,19 @@
 
 #include <assert.h>
 #include <math.h>
+#include <string.h>
 
 #include <algorithm>
+#include <atomic>
 #include <random>
 
+#include "NoiseBatch.hh"
+
+#if defined(_MSC_VER) && defined(NOISE_BATCH_SIMD)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
 const FN_DECIMAL GRAD_X[] = {1, -1, 1, -1, 1, -1, 1, -1, 0, 0, 0, 0};
 const FN_DECIMAL GRAD_Y[] = {1, 1, -1, -1, 0, 0, 0, 0, 1, -1, 1, -1};
 const FN_DECIMAL GRAD_Z[] = {0, 0, 0, 0, 1, 1, -1, -1, 1, 1, -1, -1};
@@ -642,6 +651,13 @@ static int FastRound(FN_DECIMAL f)
 {
     return (f >= 0) ? (int)(f + FN_DECIMAL(0.5)) : (int)(f - FN_DECIMAL(0.5));
 }
+// (memcpy instead of a type-punned pointer)
+static int FloatHash(FN_DECIMAL f)
+{
+    int i;
+    memcpy(&i, &f, sizeof(i));
+    return i ^ (i >> 16);
+}
 static FN_DECIMAL FastAbs(FN_DECIMAL f)
 {
     return fabs(f);
@@ -682,6 +698,12 @@ void FastNoise::SetSeed(int seed)
         m_perm[k] = l;
         m_perm12[j] = m_perm12[j + 256] = m_perm[j] % 12;
     }
+
+    for (int i = 0; i < 512; i++)
+    {
+        m_permInt[i] = m_perm[i];
+        m_perm12Int[i] = m_perm12[i];
+    }
 }
 
 void FastNoise::CalculateFractalBounding()
@@ -951,23 +973,17 @@ FN_DECIMAL FastNoise::GetNoise(FN_DECIMAL x, FN_DECIMAL y) const
 // White Noise
 FN_DECIMAL FastNoise::GetWhiteNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const
 {
-    return ValCoord4D(m_seed, *reinterpret_cast<int*>(&x) ^ (*reinterpret_cast<int*>(&x) >> 16),
-                      *reinterpret_cast<int*>(&y) ^ (*reinterpret_cast<int*>(&y) >> 16),
-                      *reinterpret_cast<int*>(&z) ^ (*reinterpret_cast<int*>(&z) >> 16),
-                      *reinterpret_cast<int*>(&w) ^ (*reinterpret_cast<int*>(&w) >> 16));
+    return ValCoord4D(m_seed, FloatHash(x), FloatHash(y), FloatHash(z), FloatHash(w));
 }
 
 FN_DECIMAL FastNoise::GetWhiteNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
 {
-    return ValCoord3D(m_seed, *reinterpret_cast<int*>(&x) ^ (*reinterpret_cast<int*>(&x) >> 16),
-                      *reinterpret_cast<int*>(&y) ^ (*reinterpret_cast<int*>(&y) >> 16),
-                      *reinterpret_cast<int*>(&z) ^ (*reinterpret_cast<int*>(&z) >> 16));
+    return ValCoord3D(m_seed, FloatHash(x), FloatHash(y), FloatHash(z));
 }
 
 FN_DECIMAL FastNoise::GetWhiteNoise(FN_DECIMAL x, FN_DECIMAL y) const
 {
-    return ValCoord2D(m_seed, *reinterpret_cast<int*>(&x) ^ (*reinterpret_cast<int*>(&x) >> 16),
-                      *reinterpret_cast<int*>(&y) ^ (*reinterpret_cast<int*>(&y) >> 16));
+    return ValCoord2D(m_seed, FloatHash(x), FloatHash(y));
 }
 
 FN_DECIMAL FastNoise::GetWhiteNoiseInt(int x, int y, int z, int w) const
@@ -2789,3 +2805,202 @@ void FastNoise::SingleGradientPerturb(unsigned char offset, FN_DECIMAL warpAmp,
     x += Lerp(lx0x, lx1x, ys) * warpAmp;
     y += Lerp(ly0x, ly1x, ys) * warpAmp;
 }
+
+// Batch evaluation
+
+static FastNoise::BatchKernel DetectBatchKernel()
+{
+#if defined(FN_USE_DOUBLES) || !defined(NOISE_BATCH_SIMD)
+    return FastNoise::BatchScalar;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osAvx)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    return avx2 ? FastNoise::BatchAVX2 : sse41 ? FastNoise::BatchSSE41 : FastNoise::BatchScalar;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return FastNoise::BatchAVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return FastNoise::BatchSSE41;
+    return FastNoise::BatchScalar;
+#endif
+}
+
+static std::atomic<int> s_batchKernel(FastNoise::BatchAuto);
+
+void FastNoise::SetBatchKernel(BatchKernel kernel)
+{
+    s_batchKernel = kernel;
+}
+
+FastNoise::BatchKernel FastNoise::GetBatchKernel()
+{
+    static const BatchKernel supported = DetectBatchKernel();
+
+    BatchKernel kernel = (BatchKernel)s_batchKernel.load();
+    if (kernel == BatchAuto || kernel > supported)
+        return supported;
+    return kernel;
+}
+
+void FastNoise::GetBatchParams(NoiseBatchParams& params) const
+{
+#ifndef FN_USE_DOUBLES
+    params.perm = m_permInt;
+    params.perm12 = m_perm12Int;
+    params.gradX = GRAD_X;
+    params.gradY = GRAD_Y;
+    params.valLut = VAL_LUT;
+    params.octaveOffset = m_permInt;
+
+    params.frequency = m_frequency;
+    params.lacunarity = m_lacunarity;
+    params.gain = m_gain;
+    params.fractalBounding = m_fractalBounding;
+    params.octaves = m_octaves;
+    params.interp = m_interp;
+#else
+    (void)params;
+#endif
+}
+
+void FastNoise::GetPerlinFractal(const FN_DECIMAL* x, const FN_DECIMAL* y, FN_DECIMAL* out, int count) const
+{
+    int done = 0;
+
+#if defined(NOISE_BATCH_SIMD) && !defined(FN_USE_DOUBLES)
+    if (m_fractalType == FBM)
+    {
+        NoiseBatchParams params;
+        GetBatchParams(params);
+
+        switch (GetBatchKernel())
+        {
+        case BatchAVX2:
+            done = count & ~7;
+            noise_batch::perlinFractalFBM2D_avx2(params, x, y, out, done);
+            break;
+        case BatchSSE41:
+            done = count & ~3;
+            noise_batch::perlinFractalFBM2D_sse41(params, x, y, out, done);
+            break;
+        default:
+            break;
+        }
+    }
+#endif
+
+    // remainder (or everything without kernel)
+    for (int i = done; i < count; i++)
+        out[i] = GetPerlinFractal(x[i], y[i]);
+}
+
+void FastNoise::GetPerlinFractalGrid(FN_DECIMAL* out, FN_DECIMAL x0, FN_DECIMAL y0, FN_DECIMAL dx, FN_DECIMAL dy, int nx, int ny) const
+{
+    // coordinates are generated in small batches (no allocation)
+    const int batchSize = 256;
+    FN_DECIMAL xs[batchSize];
+    FN_DECIMAL ys[batchSize];
+
+    int count = nx * ny;
+    int ix = 0, iy = 0;
+    for (int start = 0; start < count; start += batchSize)
+    {
+        int n = std::min(batchSize, count - start);
+        for (int i = 0; i < n; i++)
+        {
+            xs[i] = x0 + FN_DECIMAL(ix) * dx;
+            ys[i] = y0 + FN_DECIMAL(iy) * dy;
+
+            if (++ix == nx)
+            {
+                ix = 0;
+                ++iy;
+            }
+        }
+        GetPerlinFractal(xs, ys, out + start, n);
+    }
+}
+
+void FastNoise::GetValue(const FN_DECIMAL* x, const FN_DECIMAL* y, const FN_DECIMAL* z, FN_DECIMAL* out, int count) const
+{
+    int done = 0;
+
+#if defined(NOISE_BATCH_SIMD) && !defined(FN_USE_DOUBLES)
+    NoiseBatchParams params;
+    GetBatchParams(params);
+
+    switch (GetBatchKernel())
+    {
+    case BatchAVX2:
+        done = count & ~7;
+        noise_batch::value3D_avx2(params, x, y, z, out, done);
+        break;
+    case BatchSSE41:
+        done = count & ~3;
+        noise_batch::value3D_sse41(params, x, y, z, out, done);
+        break;
+    default:
+        break;
+    }
+#endif
+
+    // remainder (or everything without kernel)
+    for (int i = done; i < count; i++)
+        out[i] = GetValue(x[i], y[i], z[i]);
+}
+
+void FastNoise::GetValueGrid(FN_DECIMAL* out,
+                             FN_DECIMAL x0,
+                             FN_DECIMAL y0,
+                             FN_DECIMAL z0,
+                             FN_DECIMAL dx,
+                             FN_DECIMAL dy,
+                             FN_DECIMAL dz,
+                             int nx,
+                             int ny,
+                             int nz) const
+{
+    // coordinates are generated in small batches (no allocation)
+    const int batchSize = 256;
+    FN_DECIMAL xs[batchSize];
+    FN_DECIMAL ys[batchSize];
+    FN_DECIMAL zs[batchSize];
+
+    int count = nx * ny * nz;
+    int ix = 0, iy = 0, iz = 0;
+    for (int start = 0; start < count; start += batchSize)
+    {
+        int n = std::min(batchSize, count - start);
+        for (int i = 0; i < n; i++)
+        {
+            xs[i] = x0 + FN_DECIMAL(ix) * dx;
+            ys[i] = y0 + FN_DECIMAL(iy) * dy;
+            zs[i] = z0 + FN_DECIMAL(iz) * dz;
+
+            if (++ix == nx)
+            {
+                ix = 0;
+                if (++iy == ny)
+                {
+                    iy = 0;
+                    ++iz;
+                }
+            }
+        }
+        GetValue(xs, ys, zs, out + start, n);
+    }
+}
@@ -42,6 +42,8 @@ typedef double FN_DECIMAL;
 typedef float FN_DECIMAL;
 #endif
 
+struct NoiseBatchParams;
+
 class FastNoise
 {
 public:
@@ -93,6 +95,13 @@ public:
         Distance2Mul,
         Distance2Div
     };
+    enum BatchKernel
+    {
+        BatchAuto,
+        BatchScalar,
+        BatchSSE41,
+        BatchAVX2
+    };
 
     // Sets seed used for all noise types
     // Default: 1337
@@ -266,10 +275,46 @@ public:
     FN_DECIMAL GetWhiteNoise(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z, FN_DECIMAL w) const;
     FN_DECIMAL GetWhiteNoiseInt(int x, int y, int z, int w) const;
 
+    // Batch evaluation
+    // Fills out[i] for arrays of coordinates (SoA) or for a regular grid (x fastest, then y, then z)
+    // Uses SSE4.1 or AVX2 kernels if the CPU supports them (selected at runtime), scalar evaluation otherwise
+    // Results are identical to the scalar functions with the same arguments
+    // (grid coordinates are x0 + i * dx in FN_DECIMAL)
+    // Kernels cover float noise with FBM fractals, other settings are evaluated with the scalar functions
+
+    // Forces a kernel for all FastNoise objects (e.g. for benchmarks)
+    // Kernels that are not supported by the CPU fall back to the best supported one
+    // Default: BatchAuto
+    static void SetBatchKernel(BatchKernel kernel);
+
+    // Returns the kernel that is actually used
+    static BatchKernel GetBatchKernel();
+
+    // 2D
+    void GetPerlinFractal(const FN_DECIMAL* x, const FN_DECIMAL* y, FN_DECIMAL* out, int count) const;
+    void GetPerlinFractalGrid(FN_DECIMAL* out, FN_DECIMAL x0, FN_DECIMAL y0, FN_DECIMAL dx, FN_DECIMAL dy, int nx, int ny) const;
+
+    // 3D
+    void GetValue(const FN_DECIMAL* x, const FN_DECIMAL* y, const FN_DECIMAL* z, FN_DECIMAL* out, int count) const;
+    void GetValueGrid(FN_DECIMAL* out,
+                      FN_DECIMAL x0,
+                      FN_DECIMAL y0,
+                      FN_DECIMAL z0,
+                      FN_DECIMAL dx,
+                      FN_DECIMAL dy,
+                      FN_DECIMAL dz,
+                      int nx,
+                      int ny,
+                      int nz) const;
+
 private:
     unsigned char m_perm[512];
     unsigned char m_perm12[512];
 
+    // int copies of the permutation tables for the batch kernels (gather instructions)
+    int m_permInt[512];
+    int m_perm12Int[512];
+
     int m_seed = 1337;
     FN_DECIMAL m_frequency = FN_DECIMAL(0.01);
     Interp m_interp = Quintic;
@@ -292,6 +337,8 @@ private:
 
     void CalculateFractalBounding();
 
+    void GetBatchParams(NoiseBatchParams& params) const;
+
     // 2D
     FN_DECIMAL SingleValueFractalFBM(FN_DECIMAL x, FN_DECIMAL y) const;
     FN_DECIMAL SingleValueFractalBillow(FN_DECIMAL x, FN_DECIMAL y) const;
@@ -0,0 +1,36 @@
+#pragma once
+
+// Internal interface between FastNoise (Noise.cc) and its SIMD batch kernels (NoiseBatch*.cc)
+// Only float noise (FN_USE_DOUBLES is not defined) and FBM fractals are supported by the kernels.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define NOISE_BATCH_SIMD 1
+#endif
+
+struct NoiseBatchParams
+{
+    const int* perm;         // 512 entries
+    const int* perm12;       // 512 entries
+    const float* gradX;      // 12 entries
+    const float* gradY;      // 12 entries
+    const float* valLut;     // 256 entries
+    const int* octaveOffset; // perm[i] of every octave
+
+    float frequency;
+    float lacunarity;
+    float gain;
+    float fractalBounding;
+    int octaves;
+    int interp; // FastNoise::Interp
+};
+
+namespace noise_batch
+{
+// count must be a multiple of 4 (SSE4.1) or 8 (AVX2)
+// CAUTION: only call these if the CPU supports the instruction set
+void perlinFractalFBM2D_sse41(NoiseBatchParams const& p, const float* x, const float* y, float* out, int count);
+void perlinFractalFBM2D_avx2(NoiseBatchParams const& p, const float* x, const float* y, float* out, int count);
+
+void value3D_sse41(NoiseBatchParams const& p, const float* x, const float* y, const float* z, float* out, int count);
+void value3D_avx2(NoiseBatchParams const& p, const float* x, const float* y, const float* z, float* out, int count);
+} // namespace noise_batch
@@ -0,0 +1,52 @@
+// FastNoise batch kernels for AVX2 (compiled with -mavx2, see CMakeLists.txt)
+
+#include "NoiseBatch.hh"
+
+#ifdef NOISE_BATCH_SIMD
+
+#include <immintrin.h>
+
+namespace
+{
+struct Avx2
+{
+    using F = __m256;
+    using I = __m256i;
+    static constexpr int width = 8;
+
+    static F load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, F v) { _mm256_storeu_ps(p, v); }
+    static F set1(float f) { return _mm256_set1_ps(f); }
+    static I set1i(int i) { return _mm256_set1_epi32(i); }
+
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+    static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+    static F toFloat(I v) { return _mm256_cvtepi32_ps(v); }
+
+    // (int)f - (f < 0), the compare mask is -1 for negative lanes
+    static I fastFloor(F f)
+    {
+        return _mm256_add_epi32(_mm256_cvttps_epi32(f), _mm256_castps_si256(_mm256_cmp_ps(f, _mm256_setzero_ps(), _CMP_LT_OQ)));
+    }
+
+    static I gatherInt(const int* table, I idx) { return _mm256_i32gather_epi32(table, idx, 4); }
+    static F gatherFloat(const float* table, I idx) { return _mm256_i32gather_ps(table, idx, 4); }
+};
+} // namespace
+
+#include "NoiseBatchKernels.hh"
+
+void noise_batch::perlinFractalFBM2D_avx2(NoiseBatchParams const& p, const float* x, const float* y, float* out, int count)
+{
+    batchPerlinFractalFBM2D<Avx2>(p, x, y, out, count);
+}
+
+void noise_batch::value3D_avx2(NoiseBatchParams const& p, const float* x, const float* y, const float* z, float* out, int count)
+{
+    batchValue3D<Avx2>(p, x, y, z, out, count);
+}
+
+#endif
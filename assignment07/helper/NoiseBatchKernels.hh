@@ -0,0 +1,144 @@
+#pragma once
+
+// SIMD kernels of the FastNoise batch API, written against a small vector interface V:
+//   F, I              float and int vector types
+//   width             lanes per vector
+//   load, store, set1, set1i, add, sub, mul, addi, andi, toFloat
+//   fastFloor         same as FastFloor in Noise.cc ((int)f, minus one for negative f)
+//   gatherInt, gatherFloat
+//
+// Included by exactly one translation unit per instruction set (compiled with the matching flags).
+// Everything lives in an anonymous namespace so that instantiations for different instruction sets never merge.
+//
+// The operation order mirrors the scalar FastNoise code, so results are bit-identical (no FMA contraction).
+
+#include "NoiseBatch.hh"
+
+namespace
+{
+template <class V>
+typename V::F batchInterp(int interp, typename V::F t)
+{
+    switch (interp)
+    {
+    case 1: // Hermite: t * t * (3 - 2 * t)
+        return V::mul(V::mul(t, t), V::sub(V::set1(3), V::mul(V::set1(2), t)));
+    case 2: // Quintic: t * t * t * (t * (t * 6 - 15) + 10)
+        return V::mul(V::mul(V::mul(t, t), t),
+                      V::add(V::mul(t, V::sub(V::mul(t, V::set1(6)), V::set1(15))), V::set1(10)));
+    default: // Linear
+        return t;
+    }
+}
+
+template <class V>
+typename V::F batchLerp(typename V::F a, typename V::F b, typename V::F t)
+{
+    return V::add(a, V::mul(t, V::sub(b, a)));
+}
+
+template <class V>
+typename V::F batchPerlin2D(NoiseBatchParams const& p, int offset, typename V::F x, typename V::F y)
+{
+    using F = typename V::F;
+    using I = typename V::I;
+
+    I x0 = V::fastFloor(x);
+    I y0 = V::fastFloor(y);
+    I x1 = V::addi(x0, V::set1i(1));
+    I y1 = V::addi(y0, V::set1i(1));
+
+    F xd0 = V::sub(x, V::toFloat(x0));
+    F yd0 = V::sub(y, V::toFloat(y0));
+    F xs = batchInterp<V>(p.interp, xd0);
+    F ys = batchInterp<V>(p.interp, yd0);
+    F xd1 = V::sub(xd0, V::set1(1));
+    F yd1 = V::sub(yd0, V::set1(1));
+
+    auto mask = V::set1i(0xff);
+    auto off = V::set1i(offset);
+    auto grad = [&](I xi, I yi, F xd, F yd) {
+        // Index2D_12
+        I lut = V::gatherInt(p.perm12, V::addi(V::andi(xi, mask), V::gatherInt(p.perm, V::addi(V::andi(yi, mask), off))));
+        return V::add(V::mul(xd, V::gatherFloat(p.gradX, lut)), V::mul(yd, V::gatherFloat(p.gradY, lut)));
+    };
+
+    F xf0 = batchLerp<V>(grad(x0, y0, xd0, yd0), grad(x1, y0, xd1, yd0), xs);
+    F xf1 = batchLerp<V>(grad(x0, y1, xd0, yd1), grad(x1, y1, xd1, yd1), xs);
+
+    return batchLerp<V>(xf0, xf1, ys);
+}
+
+template <class V>
+void batchPerlinFractalFBM2D(NoiseBatchParams const& p, const float* px, const float* py, float* out, int count)
+{
+    using F = typename V::F;
+
+    auto freq = V::set1(p.frequency);
+    auto lac = V::set1(p.lacunarity);
+    for (auto i = 0; i < count; i += V::width)
+    {
+        F x = V::mul(V::load(px + i), freq);
+        F y = V::mul(V::load(py + i), freq);
+
+        F sum = batchPerlin2D<V>(p, p.octaveOffset[0], x, y);
+        float amp = 1;
+        for (auto o = 1; o < p.octaves; ++o)
+        {
+            x = V::mul(x, lac);
+            y = V::mul(y, lac);
+
+            amp *= p.gain;
+            sum = V::add(sum, V::mul(batchPerlin2D<V>(p, p.octaveOffset[o], x, y), V::set1(amp)));
+        }
+
+        V::store(out + i, V::mul(sum, V::set1(p.fractalBounding)));
+    }
+}
+
+template <class V>
+void batchValue3D(NoiseBatchParams const& p, const float* px, const float* py, const float* pz, float* out, int count)
+{
+    using F = typename V::F;
+    using I = typename V::I;
+
+    auto freq = V::set1(p.frequency);
+    auto mask = V::set1i(0xff);
+    auto one = V::set1i(1);
+    for (auto i = 0; i < count; i += V::width)
+    {
+        F x = V::mul(V::load(px + i), freq);
+        F y = V::mul(V::load(py + i), freq);
+        F z = V::mul(V::load(pz + i), freq);
+
+        I x0 = V::fastFloor(x);
+        I y0 = V::fastFloor(y);
+        I z0 = V::fastFloor(z);
+        I x1 = V::addi(x0, one);
+        I y1 = V::addi(y0, one);
+        I z1 = V::addi(z0, one);
+
+        F xs = batchInterp<V>(p.interp, V::sub(x, V::toFloat(x0)));
+        F ys = batchInterp<V>(p.interp, V::sub(y, V::toFloat(y0)));
+        F zs = batchInterp<V>(p.interp, V::sub(z, V::toFloat(z0)));
+
+        // Index3D_256 with offset 0
+        auto val = [&](I xi, I yi, I zi) {
+            I h = V::gatherInt(p.perm, V::andi(zi, mask));
+            h = V::gatherInt(p.perm, V::addi(V::andi(yi, mask), h));
+            h = V::gatherInt(p.perm, V::addi(V::andi(xi, mask), h));
+            return V::gatherFloat(p.valLut, h);
+        };
+
+        F xf00 = batchLerp<V>(val(x0, y0, z0), val(x1, y0, z0), xs);
+        F xf10 = batchLerp<V>(val(x0, y1, z0), val(x1, y1, z0), xs);
+        F xf01 = batchLerp<V>(val(x0, y0, z1), val(x1, y0, z1), xs);
+        F xf11 = batchLerp<V>(val(x0, y1, z1), val(x1, y1, z1), xs);
+
+        F yf0 = batchLerp<V>(xf00, xf10, ys);
+        F yf1 = batchLerp<V>(xf01, xf11, ys);
+
+        V::store(out + i, batchLerp<V>(yf0, yf1, zs));
+    }
+}
+} // namespace
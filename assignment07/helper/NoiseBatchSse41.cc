@@ -0,0 +1,58 @@
+// FastNoise batch kernels for SSE4.1 (compiled with -msse4.1, see CMakeLists.txt)
+
+#include "NoiseBatch.hh"
+
+#ifdef NOISE_BATCH_SIMD
+
+#include <smmintrin.h>
+
+namespace
+{
+struct Sse41
+{
+    using F = __m128;
+    using I = __m128i;
+    static constexpr int width = 4;
+
+    static F load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, F v) { _mm_storeu_ps(p, v); }
+    static F set1(float f) { return _mm_set1_ps(f); }
+    static I set1i(int i) { return _mm_set1_epi32(i); }
+
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+    static I andi(I a, I b) { return _mm_and_si128(a, b); }
+    static F toFloat(I v) { return _mm_cvtepi32_ps(v); }
+
+    // (int)f - (f < 0), the compare mask is -1 for negative lanes
+    static I fastFloor(F f) { return _mm_add_epi32(_mm_cvttps_epi32(f), _mm_castps_si128(_mm_cmplt_ps(f, _mm_setzero_ps()))); }
+
+    // no gather instructions before AVX2
+    static I gatherInt(const int* table, I idx)
+    {
+        return _mm_setr_epi32(table[_mm_extract_epi32(idx, 0)], table[_mm_extract_epi32(idx, 1)],
+                              table[_mm_extract_epi32(idx, 2)], table[_mm_extract_epi32(idx, 3)]);
+    }
+    static F gatherFloat(const float* table, I idx)
+    {
+        return _mm_setr_ps(table[_mm_extract_epi32(idx, 0)], table[_mm_extract_epi32(idx, 1)],
+                           table[_mm_extract_epi32(idx, 2)], table[_mm_extract_epi32(idx, 3)]);
+    }
+};
+} // namespace
+
+#include "NoiseBatchKernels.hh"
+
+void noise_batch::perlinFractalFBM2D_sse41(NoiseBatchParams const& p, const float* x, const float* y, float* out, int count)
+{
+    batchPerlinFractalFBM2D<Sse41>(p, x, y, out, count);
+}
+
+void noise_batch::value3D_sse41(NoiseBatchParams const& p, const float* x, const float* y, const float* z, float* out, int count)
+{
+    batchValue3D<Sse41>(p, x, y, z, out, count);
+}
+
+#endif
@@ -0,0 +1,469 @@
+#include "TlsfAllocator.hh"
+
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+int findLastSet(uint32_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse(&idx, v);
+    return int(idx);
+#else
+    return 31 - __builtin_clz(v);
+#endif
+}
+
+int findFirstSet(uint32_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, v);
+    return int(idx);
+#else
+    return __builtin_ctz(v);
+#endif
+}
+} // namespace
+
+void TlsfAllocator::reset(uint32_t capacity)
+{
+    mBlocks.clear();
+    mUnusedBlocks.clear();
+    mHandleBlocks.clear();
+    mUnusedHandles.clear();
+
+    for (auto fl = 0; fl < flCount; ++fl)
+    {
+        for (auto sl = 0; sl < slCount; ++sl)
+            mFreeHeads[fl][sl] = none;
+        mSlBitmaps[fl] = 0;
+    }
+    mFlBitmap = 0;
+
+    mCapacity = 0;
+    mLastBlock = none;
+    mUsedUnits = 0;
+    mAllocations = 0;
+
+    grow(capacity);
+}
+
+void TlsfAllocator::grow(uint32_t capacity)
+{
+    assert(capacity >= mCapacity && "cannot shrink");
+    if (capacity == mCapacity)
+        return;
+
+    auto extra = capacity - mCapacity;
+    if (mLastBlock != none && mBlocks[mLastBlock].handle == invalidHandle)
+    {
+        // extend the free block at the end
+        removeFree(mLastBlock);
+        mBlocks[mLastBlock].size += extra;
+        insertFree(mLastBlock);
+    }
+    else
+    {
+        auto b = newBlock();
+        mBlocks[b].offset = mCapacity;
+        mBlocks[b].size = extra;
+        mBlocks[b].prevPhys = mLastBlock;
+        if (mLastBlock != none)
+            mBlocks[mLastBlock].nextPhys = b;
+        mLastBlock = b;
+        insertFree(b);
+    }
+
+    mCapacity = capacity;
+}
+
+TlsfAllocator::Handle TlsfAllocator::allocate(uint32_t size)
+{
+    assert(size > 0 && "empty allocation");
+
+    auto b = findFree(size);
+    if (b == none)
+        return invalidHandle;
+
+    split(b, size);
+
+    Handle h;
+    if (!mUnusedHandles.empty())
+    {
+        h = mUnusedHandles.back();
+        mUnusedHandles.pop_back();
+    }
+    else
+    {
+        h = Handle(mHandleBlocks.size());
+        mHandleBlocks.push_back(none);
+    }
+
+    mHandleBlocks[h] = b;
+    mBlocks[b].handle = h;
+
+    mUsedUnits += size;
+    ++mAllocations;
+    return h;
+}
+
+void TlsfAllocator::free(Handle handle)
+{
+    assert(handle < mHandleBlocks.size() && mHandleBlocks[handle] != none && "invalid handle");
+
+    auto b = mHandleBlocks[handle];
+    mHandleBlocks[handle] = none;
+    mUnusedHandles.push_back(handle);
+
+    mUsedUnits -= mBlocks[b].size;
+    --mAllocations;
+
+    mBlocks[b].handle = invalidHandle;
+    mergeAndInsert(b);
+}
+
+uint32_t TlsfAllocator::defragment(uint32_t maxUnits, int maxTries, std::vector<Move>& moves)
+{
+    auto moved = 0u;
+
+    // walk the allocations from the highest offset downwards
+    auto b = mLastBlock;
+    for (auto tries = 0; b != none && tries < maxTries; ++tries)
+    {
+        // the free space at the end is never a destination
+        auto tail = mLastBlock;
+        if (mBlocks[tail].handle != invalidHandle)
+            tail = none;
+
+        // all free space is above the allocations -> compact
+        auto tailSize = tail != none ? mBlocks[tail].size : 0u;
+        if (mCapacity - mUsedUnits == tailSize)
+            break;
+
+        while (b != none && mBlocks[b].handle == invalidHandle)
+            b = mBlocks[b].prevPhys;
+        if (b == none)
+            break;
+
+        auto size = mBlocks[b].size;
+        auto lower = mBlocks[b].prevPhys;
+        if (moved + size > maxUnits)
+        {
+            b = lower;
+            continue;
+        }
+
+        if (tail != none)
+            removeFree(tail);
+        auto dst = findFree(size);
+        if (tail != none)
+            insertFree(tail);
+
+        if (dst != none && mBlocks[dst].offset > mBlocks[b].offset)
+        {
+            insertFree(dst); // the hole is above (moving there would not compact anything)
+            dst = none;
+        }
+        if (dst == none)
+        {
+            b = lower;
+            continue;
+        }
+
+        split(dst, size);
+
+        auto h = mBlocks[b].handle;
+        mBlocks[dst].handle = h;
+        mHandleBlocks[h] = dst;
+        moves.push_back({h, mBlocks[b].offset, mBlocks[dst].offset, size});
+
+        // (lower is not merged away: it is either used, or b is merged into it)
+        mBlocks[b].handle = invalidHandle;
+        mergeAndInsert(b);
+
+        moved += size;
+        b = lower;
+    }
+    return moved;
+}
+
+bool TlsfAllocator::isConsistent() const
+{
+    // physical order
+    auto first = mLastBlock;
+    while (first != none && mBlocks[first].prevPhys != none)
+        first = mBlocks[first].prevPhys;
+
+    auto offset = 0u;
+    auto used = 0u;
+    auto allocations = 0u;
+    auto freeBlocks = 0u;
+    auto prevFree = false;
+    for (auto b = first; b != none; b = mBlocks[b].nextPhys)
+    {
+        auto const& block = mBlocks[b];
+        if (block.offset != offset || block.size == 0)
+            return false;
+        if (block.nextPhys != none ? mBlocks[block.nextPhys].prevPhys != b : mLastBlock != b)
+            return false;
+
+        auto isFree = block.handle == invalidHandle;
+        if (isFree)
+        {
+            if (prevFree)
+                return false; // not merged
+            ++freeBlocks;
+        }
+        else
+        {
+            if (block.handle >= mHandleBlocks.size() || mHandleBlocks[block.handle] != b)
+                return false;
+            used += block.size;
+            ++allocations;
+        }
+
+        prevFree = isFree;
+        offset += block.size;
+    }
+    if (offset != mCapacity || used != mUsedUnits || allocations != mAllocations)
+        return false;
+
+    // free lists and bitmaps
+    auto listed = 0u;
+    for (auto fl = 0; fl < flCount; ++fl)
+    {
+        if (bool(mFlBitmap >> fl & 1) != (mSlBitmaps[fl] != 0))
+            return false;
+
+        for (auto sl = 0; sl < slCount; ++sl)
+        {
+            if (bool(mSlBitmaps[fl] >> sl & 1) != (mFreeHeads[fl][sl] != none))
+                return false;
+
+            auto prev = none;
+            for (auto b = mFreeHeads[fl][sl]; b != none; b = mBlocks[b].nextFree)
+            {
+                int bfl, bsl;
+                mapInsert(mBlocks[b].size, bfl, bsl);
+                if (mBlocks[b].handle != invalidHandle || mBlocks[b].prevFree != prev || bfl != fl || bsl != sl)
+                    return false;
+                prev = b;
+                ++listed;
+            }
+        }
+    }
+    return listed == freeBlocks;
+}
+
+TlsfAllocator::Stats TlsfAllocator::getStats() const
+{
+    Stats s;
+    s.capacity = mCapacity;
+    s.usedUnits = mUsedUnits;
+    s.freeUnits = mCapacity - mUsedUnits;
+    s.allocations = mAllocations;
+
+    for (auto fl = 0; fl < flCount; ++fl)
+        for (auto sl = 0; sl < slCount; ++sl)
+            for (auto b = mFreeHeads[fl][sl]; b != none; b = mBlocks[b].nextFree)
+            {
+                ++s.freeBlocks;
+                if (mBlocks[b].size > s.largestFreeBlock)
+                    s.largestFreeBlock = mBlocks[b].size;
+            }
+
+    s.end = getEnd();
+    return s;
+}
+
+uint32_t TlsfAllocator::getEnd() const
+{
+    if (mLastBlock != none && mBlocks[mLastBlock].handle == invalidHandle)
+        return mCapacity - mBlocks[mLastBlock].size;
+    return mCapacity;
+}
+
+void TlsfAllocator::mapInsert(uint32_t size, int& fl, int& sl)
+{
+    if (size < slCount)
+    {
+        // small sizes: one list per size
+        fl = 0;
+        sl = int(size);
+    }
+    else
+    {
+        auto f = findLastSet(size);
+        fl = f - slBits + 1;
+        sl = int(size >> (f - slBits)) - slCount;
+    }
+}
+
+void TlsfAllocator::mapSearch(uint32_t size, int& fl, int& sl)
+{
+    // round up to the next list boundary, so every block of the list fits
+    auto rounded = uint64_t(size);
+    if (size >= slCount)
+        rounded += (uint64_t(1) << (findLastSet(size) - slBits)) - 1;
+
+    if (rounded > 0xFFFFFFFFu)
+    {
+        fl = flCount; // no list
+        sl = 0;
+        return;
+    }
+    mapInsert(uint32_t(rounded), fl, sl);
+}
+
+uint32_t TlsfAllocator::newBlock()
+{
+    uint32_t b;
+    if (!mUnusedBlocks.empty())
+    {
+        b = mUnusedBlocks.back();
+        mUnusedBlocks.pop_back();
+        mBlocks[b] = {};
+    }
+    else
+    {
+        b = uint32_t(mBlocks.size());
+        mBlocks.emplace_back();
+    }
+    return b;
+}
+
+void TlsfAllocator::deleteBlock(uint32_t block) { mUnusedBlocks.push_back(block); }
+
+void TlsfAllocator::insertFree(uint32_t block)
+{
+    int fl, sl;
+    mapInsert(mBlocks[block].size, fl, sl);
+
+    auto head = mFreeHeads[fl][sl];
+    mBlocks[block].prevFree = none;
+    mBlocks[block].nextFree = head;
+    if (head != none)
+        mBlocks[head].prevFree = block;
+    mFreeHeads[fl][sl] = block;
+
+    mFlBitmap |= 1u << fl;
+    mSlBitmaps[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(uint32_t block)
+{
+    auto& b = mBlocks[block];
+    if (b.prevFree != none)
+        mBlocks[b.prevFree].nextFree = b.nextFree;
+    if (b.nextFree != none)
+        mBlocks[b.nextFree].prevFree = b.prevFree;
+
+    int fl, sl;
+    mapInsert(b.size, fl, sl);
+    if (mFreeHeads[fl][sl] == block)
+    {
+        mFreeHeads[fl][sl] = b.nextFree;
+        if (b.nextFree == none)
+        {
+            mSlBitmaps[fl] &= ~(1u << sl);
+            if (mSlBitmaps[fl] == 0)
+                mFlBitmap &= ~(1u << fl);
+        }
+    }
+
+    b.prevFree = none;
+    b.nextFree = none;
+}
+
+uint32_t TlsfAllocator::findFree(uint32_t size)
+{
+    int fl, sl;
+    mapSearch(size, fl, sl);
+    if (fl >= flCount)
+        return none;
+
+    // same first level, larger second level
+    auto slMap = mSlBitmaps[fl] & (~0u << sl);
+    if (slMap == 0)
+    {
+        // any larger first level
+        auto flMap = fl + 1 < 32 ? mFlBitmap & (~0u << (fl + 1)) : 0u;
+        if (flMap == 0)
+            return none;
+
+        fl = findFirstSet(flMap);
+        slMap = mSlBitmaps[fl];
+    }
+    sl = findFirstSet(slMap);
+
+    auto b = mFreeHeads[fl][sl];
+    assert(b != none && mBlocks[b].size >= size);
+    removeFree(b);
+    return b;
+}
+
+void TlsfAllocator::split(uint32_t block, uint32_t size)
+{
+    if (mBlocks[block].size == size)
+        return;
+
+    // (newBlock may reallocate mBlocks)
+    auto r = newBlock();
+    auto& b = mBlocks[block];
+    auto& rest = mBlocks[r];
+    rest.offset = b.offset + size;
+    rest.size = b.size - size;
+    rest.prevPhys = block;
+    rest.nextPhys = b.nextPhys;
+    if (b.nextPhys != none)
+        mBlocks[b.nextPhys].prevPhys = r;
+    else
+        mLastBlock = r;
+    b.nextPhys = r;
+    b.size = size;
+
+    // (the neighbors of a free block are never free)
+    insertFree(r);
+}
+
+void TlsfAllocator::mergeAndInsert(uint32_t block)
+{
+    auto absorbNext = [&](uint32_t b) {
+        auto n = mBlocks[b].nextPhys;
+        removeFree(n);
+        mBlocks[b].size += mBlocks[n].size;
+        mBlocks[b].nextPhys = mBlocks[n].nextPhys;
+        if (mBlocks[n].nextPhys != none)
+            mBlocks[mBlocks[n].nextPhys].prevPhys = b;
+        else
+            mLastBlock = b;
+        deleteBlock(n);
+    };
+
+    auto next = mBlocks[block].nextPhys;
+    if (next != none && mBlocks[next].handle == invalidHandle)
+        absorbNext(block);
+
+    auto prev = mBlocks[block].prevPhys;
+    if (prev != none && mBlocks[prev].handle == invalidHandle)
+    {
+        // (block is not in a list yet)
+        removeFree(prev);
+        mBlocks[prev].size += mBlocks[block].size;
+        mBlocks[prev].nextPhys = mBlocks[block].nextPhys;
+        if (mBlocks[block].nextPhys != none)
+            mBlocks[mBlocks[block].nextPhys].prevPhys = prev;
+        else
+            mLastBlock = prev;
+        deleteBlock(block);
+        block = prev;
+    }
+
+    insertFree(block);
+}
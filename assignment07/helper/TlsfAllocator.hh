@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Sub-allocator of ranges in a linear address space (e.g. a GPU buffer), two-level segregated fit (TLSF)
+ *
+ * Manages offsets and sizes in abstract units only, it never touches the memory itself.
+ * Free blocks are kept in segregated lists: the first level is the power of two of the size,
+ * the second level splits every power of two into 16 linear steps.
+ * Two bitmaps find a fitting list in O(1), allocate and free are O(1) (free blocks are merged with their neighbors).
+ *
+ * Allocations are referenced by handles that stay valid when defragment moves them.
+ */
+class TlsfAllocator
+{
+public:
+    using Handle = uint32_t;
+    static constexpr Handle invalidHandle = ~0u;
+
+    struct Stats
+    {
+        uint32_t capacity = 0;         ///< total units
+        uint32_t usedUnits = 0;        ///< in allocations
+        uint32_t freeUnits = 0;        ///< capacity - usedUnits
+        uint32_t allocations = 0;      ///< number of live allocations
+        uint32_t freeBlocks = 0;       ///< number of free ranges
+        uint32_t largestFreeBlock = 0; ///< largest range that can still be allocated
+        uint32_t end = 0;              ///< end of the highest allocation
+    };
+
+    /// a range moved by defragment (copy size units from oldOffset to newOffset, the ranges never overlap)
+    struct Move
+    {
+        Handle handle;
+        uint32_t oldOffset;
+        uint32_t newOffset;
+        uint32_t size;
+    };
+
+private:
+    static constexpr int slBits = 4;
+    static constexpr int slCount = 1 << slBits;
+    static constexpr int flCount = 32 - slBits + 1;
+    static constexpr uint32_t none = ~0u;
+
+    struct Block
+    {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        uint32_t prevPhys = none; ///< neighbor at a lower offset
+        uint32_t nextPhys = none; ///< neighbor at a higher offset
+        uint32_t prevFree = none; ///< free list (free blocks only)
+        uint32_t nextFree = none;
+        Handle handle = invalidHandle; ///< invalidHandle iff free
+    };
+
+    std::vector<Block> mBlocks;
+    std::vector<uint32_t> mUnusedBlocks; ///< slots in mBlocks for reuse
+
+    std::vector<uint32_t> mHandleBlocks; ///< block of every handle
+    std::vector<Handle> mUnusedHandles;
+
+    /// heads of the free lists and their bitmaps
+    uint32_t mFreeHeads[flCount][slCount];
+    uint32_t mFlBitmap = 0;
+    uint32_t mSlBitmaps[flCount];
+
+    uint32_t mCapacity = 0;
+    uint32_t mLastBlock = none; ///< block with the highest offset
+    uint32_t mUsedUnits = 0;
+    uint32_t mAllocations = 0;
+
+public:
+    explicit TlsfAllocator(uint32_t capacity = 0) { reset(capacity); }
+
+    /// frees everything
+    void reset(uint32_t capacity);
+
+    /// increases the capacity (existing allocations stay where they are)
+    void grow(uint32_t capacity);
+
+    /// allocates size units (> 0), returns invalidHandle if no free range is large enough
+    Handle allocate(uint32_t size);
+
+    /// frees an allocation
+    void free(Handle handle);
+
+    /// moves allocations into free ranges at lower offsets, starting with the highest allocation
+    /// (so the used space stays compact, holes merge into the free space at the end)
+    /// stops after maxUnits were moved or maxTries allocations were considered
+    /// the moves are appended to moves and must be applied in order, returns the number of moved units
+    uint32_t defragment(uint32_t maxUnits, int maxTries, std::vector<Move>& moves);
+
+    /// checks all internal invariants (for tests and benchmarks, O(n))
+    bool isConsistent() const;
+
+public: // accessor functions
+    uint32_t getOffset(Handle handle) const { return mBlocks[mHandleBlocks[handle]].offset; }
+    uint32_t getSize(Handle handle) const { return mBlocks[mHandleBlocks[handle]].size; }
+    uint32_t getCapacity() const { return mCapacity; }
+    uint32_t getUsedUnits() const { return mUsedUnits; }
+    /// end of the highest allocation
+    uint32_t getEnd() const;
+
+    /// O(number of blocks)
+    Stats getStats() const;
+
+private:
+    /// first- and second-level list of a free block of the given size
+    static void mapInsert(uint32_t size, int& fl, int& sl);
+    /// first list whose blocks are all at least size large
+    static void mapSearch(uint32_t size, int& fl, int& sl);
+
+    uint32_t newBlock();
+    void deleteBlock(uint32_t block);
+
+    void insertFree(uint32_t block);
+    void removeFree(uint32_t block);
+    /// a free block of at least size units (removed from its list), none if there is none
+    uint32_t findFree(uint32_t size);
+
+    /// splits a block so that it has size units, the rest becomes a free block
+    void split(uint32_t block, uint32_t size);
+    /// merges a free block with its free neighbors (and inserts the result into the free lists)
+    void mergeAndInsert(uint32_t block);
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <typed-geometry/tg.hh>
+
+/**
+ * @brief Fixed-size 3D ring buffer (clipmap) of values around a moving center
+ *
+ * The grid covers a window of size.x * size.y * size.z integer cells.
+ * A cell is stored in slot (cell mod size), so moving the window only touches the slots
+ * of cells that entered or left it (everything else stays where it is).
+ *
+ * Every slot remembers the cell it currently represents.
+ * Thus, a lookup is a single compare: the slot matches iff the cell is inside the window.
+ *
+ * Sizes must be powers of two.
+ */
+template <class T>
+class ToroidalGrid
+{
+private:
+    struct Slot
+    {
+        tg::ipos3 cell;
+        T value;
+    };
+
+    std::vector<Slot> mSlots;
+    tg::ivec3 mSize;
+    tg::ivec3 mMask;
+    int mShiftY = 0; ///< log2(size.x)
+    int mShiftZ = 0; ///< log2(size.x * size.y)
+
+    /// first cell of the window
+    tg::ipos3 mOrigin;
+
+public:
+    /// creates a window around (0,0,0) where every slot is set to empty
+    ToroidalGrid(tg::ivec3 size, T empty = T()) : mSize(size), mMask(size - 1)
+    {
+        TG_ASSERT(size.x > 0 && (size.x & (size.x - 1)) == 0 && "size must be a power of two");
+        TG_ASSERT(size.y > 0 && (size.y & (size.y - 1)) == 0 && "size must be a power of two");
+        TG_ASSERT(size.z > 0 && (size.z & (size.z - 1)) == 0 && "size must be a power of two");
+
+        while ((1 << mShiftY) < size.x)
+            ++mShiftY;
+        mShiftZ = mShiftY;
+        while ((1 << mShiftZ) < size.x * size.y)
+            ++mShiftZ;
+
+        mSlots.resize(size_t(size.x) * size.y * size.z);
+        mOrigin = tg::ipos3::zero - size / 2;
+        clear(empty);
+    }
+
+    tg::ivec3 size() const { return mSize; }
+    tg::ipos3 origin() const { return mOrigin; }
+
+    /// true iff the cell is inside the current window
+    bool contains(tg::ipos3 cell) const { return slotOf(cell).cell == cell; }
+
+    /// returns the value of a cell
+    /// returns nullptr if the cell is outside the window
+    T* find(tg::ipos3 cell)
+    {
+        auto& s = slotOf(cell);
+        return s.cell == cell ? &s.value : nullptr;
+    }
+    T const* find(tg::ipos3 cell) const
+    {
+        auto const& s = slotOf(cell);
+        return s.cell == cell ? &s.value : nullptr;
+    }
+
+    /// sets the value of a cell (ignored if the cell is outside the window)
+    void set(tg::ipos3 cell, T const& value)
+    {
+        auto& s = slotOf(cell);
+        if (s.cell == cell)
+            s.value = value;
+    }
+
+    /// sets all values of the window
+    void clear(T const& empty)
+    {
+        for (auto z = 0; z < mSize.z; ++z)
+            for (auto y = 0; y < mSize.y; ++y)
+                for (auto x = 0; x < mSize.x; ++x)
+                {
+                    auto cell = mOrigin + tg::ivec3(x, y, z);
+                    auto& s = slotOf(cell);
+                    s.cell = cell;
+                    s.value = empty;
+                }
+    }
+
+    /// moves the window so that it is centered at the given cell
+    /// fetch(cell) is called for every cell that entered the window and provides its value
+    template <class FetchF>
+    void recenter(tg::ipos3 center, FetchF&& fetch)
+    {
+        auto origin = center - mSize / 2;
+        if (origin == mOrigin)
+            return;
+
+        mOrigin = origin;
+        for (auto z = 0; z < mSize.z; ++z)
+            for (auto y = 0; y < mSize.y; ++y)
+                for (auto x = 0; x < mSize.x; ++x)
+                {
+                    auto cell = origin + tg::ivec3(x, y, z);
+                    auto& s = slotOf(cell);
+                    if (s.cell == cell)
+                        continue; // still inside the window
+
+                    s.cell = cell;
+                    s.value = fetch(cell);
+                }
+    }
+
+private:
+    // & mask is a proper modulo for negative cells too (two's complement)
+    size_t slotIdx(tg::ipos3 c) const { return (c.x & mMask.x) | (c.y & mMask.y) << mShiftY | (c.z & mMask.z) << mShiftZ; }
+
+    Slot& slotOf(tg::ipos3 c) { return mSlots[slotIdx(c)]; }
+    Slot const& slotOf(tg::ipos3 c) const { return mSlots[slotIdx(c)]; }
+};
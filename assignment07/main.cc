@@ -1,6 +1,6 @@
 #include "Assignment07.hh"
 
-int main(int argc, char *argv[])
+int main()
 {
     Assignment07 app;
     app.run(); // automatically sets up GLOW and GLFW and everything
@@ -15,6 +15,7 @@ uniform sampler2DArray uShadowMaps;
 uniform float uShadowExponent;
 uniform vec3 uShadowPos;
 uniform float uShadowRange;
+uniform float uShadowDistance; // covered by the cascades (the render distance of the chunks)
 
 vec3 hsv2rgb(vec3 c) 
 {
@@ -25,7 +26,12 @@ vec3 hsv2rgb(vec3 c)
 
 float shadowPenDepth(vec3 worldPos)
 {
-    int casc = clamp(int(distance(uCamPos, worldPos) / uRenderDistance * SHADOW_CASCADES), 0, SHADOW_CASCADES - 1);
+    // no shadows beyond the cascades (distant LOD terrain)
+    float dis = distance(uCamPos, worldPos);
+    if (dis >= uShadowDistance)
+        return 0.0;
+
+    int casc = clamp(int(dis / uShadowDistance * SHADOW_CASCADES), 0, SHADOW_CASCADES - 1);
 
     vec4 shadowPos = uShadowViewProjs[casc] * vec4(worldPos, 1.0);
     shadowPos.xyz = shadowPos.xyz * 0.5 + 0.5;
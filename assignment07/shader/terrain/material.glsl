@@ -7,3 +7,26 @@ uniform sampler2D uTexNormal;
 uniform sampler2D uTexRoughness;
 uniform sampler2D uTexHeight;
 uniform sampler2D uTexAO;
+
+// position within a single block face in [0,1]^2
+// (greedy quads span multiple faces: uv goes from 0 to quadSize)
+vec2 faceUV(vec2 uv, vec2 quadSize)
+{
+    return uv - clamp(floor(uv), vec2(0.0), quadSize - 1.0);
+}
+
+// AO (per corner: 00, 01, 10, 11) and edges (per side: +T, -T, +B, -B) of the block face at uv
+// derived from those of its quad (see quadFaceFlags in MeshGenerator.hh):
+// faces inside the quad are flat, faces on a side take its edge and are occluded along it if it is a wall
+void faceFlags(vec2 uv, vec2 quadSize, vec4 quadAOs, vec4 quadEdges, out vec4 aos, out vec4 edges)
+{
+    vec2 face = clamp(floor(uv), vec2(0.0), quadSize - 1.0);
+    bvec4 on = bvec4(face.x == quadSize.x - 1.0, face.x == 0.0, face.y == quadSize.y - 1.0, face.y == 0.0);
+    edges = quadEdges * vec4(on);
+
+    vec4 sideAOs = mix(vec4(1.0), vec4(1.0 / 3.0), greaterThan(edges, vec4(0.5)));
+    aos.x = on.y && on.w ? quadAOs.x : on.y ? sideAOs.y : on.w ? sideAOs.w : 1.0;
+    aos.y = on.y && on.z ? quadAOs.y : on.y ? sideAOs.y : on.z ? sideAOs.z : 1.0;
+    aos.z = on.x && on.w ? quadAOs.z : on.x ? sideAOs.x : on.w ? sideAOs.w : 1.0;
+    aos.w = on.x && on.z ? quadAOs.w : on.x ? sideAOs.x : on.z ? sideAOs.z : 1.0;
+}
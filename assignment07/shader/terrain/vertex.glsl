@@ -0,0 +1,11 @@
+// chunk position of the current terrain mesh (per draw, see TerrainArena)
+in vec3 aChunkPos;
+// size of a voxel in blocks (1 for chunks, 2^level for LOD cells)
+in float aVoxelSize;
+
+// world space position of a packed terrain vertex position
+// (chunk-local x | y << 6 | z << 12 in voxels, see TerrainVertex)
+vec3 terrainPosition(int packedPos)
+{
+    return aChunkPos + vec3(packedPos & 63, (packedPos >> 6) & 63, (packedPos >> 12) & 63) * aVoxelSize;
+}